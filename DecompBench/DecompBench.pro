@@ -0,0 +1,18 @@
+TEMPLATE = app
+TARGET = decompbench
+CONFIG += console std=c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+
+include(../Athena/AthenaCore.pri)
+include(../RetroCommon/RetroCommon.pri)
+
+# The corpus is compressed with zlib and LZO
+win32:INCLUDEPATH += $$PWD/../External/lzo/include
+win32:LIBS += -L$$PWD/../External/lzo/lib
+unix:LIBS += -llzo2 -lz
+
+HEADERS += SyntheticCorpus.hpp
+
+SOURCES += main.cpp \
+    SyntheticCorpus.cpp
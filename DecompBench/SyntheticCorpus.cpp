@@ -0,0 +1,446 @@
+#include "SyntheticCorpus.hpp"
+#include <RetroCommon.hpp>
+#include <algorithm>
+#include <mutex>
+#include <random>
+#include <memory.h>
+#include <zlib.h>
+#include <lzo/lzo1x.h>
+
+namespace
+{
+const atUint32 LZOSegmentSize  = 0x4000;
+const atUint32 CMPDBlockSize   = 0x20000;
+const atUint32 CMPDBlockFlag   = 0xA0000000;
+const atUint32 MREABlockSize   = 0x20000;
+const atUint32 MREAMagic       = 0xDEADBEEF;
+const atUint32 MREAVersionMP2  = 0x19;
+const atUint32 MREAVersionMP3  = 0x1E;
+
+typedef std::vector<atUint8> Bytes;
+
+void writeBig32(Bytes& out, atUint32 v)
+{
+    out.push_back(v >> 24);
+    out.push_back(v >> 16);
+    out.push_back(v >> 8);
+    out.push_back(v);
+}
+
+void writeBig16(Bytes& out, atUint16 v)
+{
+    out.push_back(v >> 8);
+    out.push_back(v);
+}
+
+void writeBigFloat(Bytes& out, float v)
+{
+    atUint32 bits;
+    memcpy(&bits, &v, 4);
+    writeBig32(out, bits);
+}
+
+void align32(Bytes& out)
+{
+    out.resize(ROUND_UP_32(out.size()), 0);
+}
+
+bool looksLikeZlib(const atUint8* data, atUint32 length)
+{
+    return length >= 2 && data[0] == 0x78 && (data[1] == 0xDA || data[1] == 0x01 || data[1] == 0x9C);
+}
+
+Bytes compressZlib(const atUint8* data, atUint32 length)
+{
+    // Retro's streams are all 0x78DA, best compression
+    uLongf packedLength = compressBound(length);
+    Bytes ret(packedLength);
+    if (compress2(ret.data(), &packedLength, data, length, Z_BEST_COMPRESSION) != Z_OK)
+        return Bytes();
+
+    ret.resize(packedLength);
+    return ret;
+}
+
+// lzo1x_1 rather than the much slower lzo1x_999 the games were packed with, the decoder
+// doesn't care and generating a big corpus stays quick
+Bytes compressLZO(const atUint8* data, atUint32 length)
+{
+    static std::once_flag once;
+    static bool ok = false;
+    std::call_once(once, []{ ok = (lzo_init() == LZO_E_OK); });
+    if (!ok)
+        return Bytes();
+
+    Bytes workMem(LZO1X_1_MEM_COMPRESS);
+    Bytes ret(length + length / 16 + 64 + 3);
+    lzo_uint packedLength = 0;
+    if (lzo1x_1_compress(data, length, ret.data(), &packedLength, workMem.data()) != LZO_E_OK)
+        return Bytes();
+
+    ret.resize(packedLength);
+    return ret;
+}
+
+// Size prefixed and CMPD flavour: signed big endian sizes, negative ones mark stored segments
+Bytes compressLZOSegments(const atUint8* data, atUint32 length)
+{
+    Bytes ret;
+    for (atUint32 in = 0; in < length; in += LZOSegmentSize)
+    {
+        atUint32 segmentLength = std::min(LZOSegmentSize, length - in);
+        Bytes packed = compressLZO(data + in, segmentLength);
+        if (packed.empty() || packed.size() >= segmentLength)
+        {
+            writeBig16(ret, (atUint16)-(atInt16)segmentLength);
+            ret.insert(ret.end(), data + in, data + in + segmentLength);
+        }
+        else
+        {
+            writeBig16(ret, packed.size());
+            ret.insert(ret.end(), packed.begin(), packed.end());
+        }
+    }
+
+    return ret;
+}
+
+// MREA flavour: every segment is LZO or zlib, picked by peeking at its first bytes, and
+// stored segments are marked by sizes above 0x4000
+Bytes compressMREASegments(const atUint8* data, atUint32 length, bool zlib)
+{
+    Bytes ret;
+    for (atUint32 in = 0; in < length; in += LZOSegmentSize)
+    {
+        atUint32 segmentLength = std::min(LZOSegmentSize, length - in);
+        Bytes packed = zlib ? compressZlib(data + in, segmentLength) : compressLZO(data + in, segmentLength);
+
+        // An LZO segment that starts like a zlib stream would be mistaken for one
+        if (packed.empty() || packed.size() >= segmentLength || (!zlib && looksLikeZlib(packed.data(), packed.size())))
+        {
+            writeBig16(ret, 0x10000 - segmentLength);
+            ret.insert(ret.end(), data + in, data + in + segmentLength);
+        }
+        else
+        {
+            writeBig16(ret, packed.size());
+            ret.insert(ret.end(), packed.begin(), packed.end());
+        }
+    }
+
+    return ret;
+}
+
+SSyntheticPayload makePrefixed(ESyntheticKind kind, const Bytes& content)
+{
+    SSyntheticPayload ret;
+    ret.kind = kind;
+    Bytes stream = (kind == ESyntheticKind::PrefixedZlib || kind == ESyntheticKind::ZlibStream)
+            ? compressZlib(content.data(), content.size())
+            : compressLZOSegments(content.data(), content.size());
+
+    if (kind == ESyntheticKind::PrefixedZlib || kind == ESyntheticKind::PrefixedLZO)
+        writeBig32(ret.data, content.size());
+    ret.data.insert(ret.data.end(), stream.begin(), stream.end());
+    return ret;
+}
+
+SSyntheticPayload makeCMPD(const Bytes& content)
+{
+    SSyntheticPayload ret;
+    ret.kind = ESyntheticKind::CMPD;
+
+    atUint32 blockCount = (content.size() + CMPDBlockSize - 1) / CMPDBlockSize;
+    Bytes blockData;
+    ret.data.insert(ret.data.end(), {'C', 'M', 'P', 'D'});
+    writeBig32(ret.data, blockCount);
+    for (atUint32 i = 0; i < blockCount; i++)
+    {
+        const atUint8* block = content.data() + i * CMPDBlockSize;
+        atUint32 blockLength = std::min<atUint32>(CMPDBlockSize, content.size() - i * CMPDBlockSize);
+        Bytes packed = compressLZOSegments(block, blockLength);
+
+        // Blocks that don't shrink are stored
+        if (packed.size() >= blockLength)
+        {
+            writeBig32(ret.data, blockLength);
+            blockData.insert(blockData.end(), block, block + blockLength);
+        }
+        else
+        {
+            writeBig32(ret.data, CMPDBlockFlag | packed.size());
+            blockData.insert(blockData.end(), packed.begin(), packed.end());
+        }
+        writeBig32(ret.data, blockLength);
+    }
+
+    ret.data.insert(ret.data.end(), blockData.begin(), blockData.end());
+    return ret;
+}
+
+// Builds the area as stored and, next to it, the header decompressMREA turns it into
+SSyntheticPayload makeMREA(ESyntheticKind kind, atUint32 length, float redundancy, atUint32 seed)
+{
+    std::mt19937 rng(seed);
+    bool isMP3 = (kind == ESyntheticKind::MREAMP3);
+
+    // Sections of 1 to 64 KiB, 32 byte aligned like the real ones
+    std::vector<atUint32> sectionSizes;
+    atUint32 total = 0;
+    while (total < length)
+    {
+        atUint32 size = std::min<atUint32>(ROUND_UP_32(0x400 + rng() % 0xFC00), ROUND_UP_32(length - total));
+        sectionSizes.push_back(size);
+        total += size;
+    }
+
+    Bytes content = syntheticContent(total, redundancy, seed);
+
+    // Blocks hold whole sections, as many as fit
+    std::vector<std::pair<atUint32, atUint32>> blocks; // first section, section count
+    atUint32 blockLength = 0;
+    for (atUint32 i = 0; i < sectionSizes.size(); i++)
+    {
+        if (blocks.empty() || blockLength + sectionSizes[i] > MREABlockSize)
+        {
+            blocks.push_back(std::make_pair(i, 0));
+            blockLength = 0;
+        }
+        blocks.back().second++;
+        blockLength += sectionSizes[i];
+    }
+
+    Bytes in;
+    Bytes out;
+    auto both32 = [&](atUint32 v) { writeBig32(in, v); writeBig32(out, v); };
+    auto bothAlign = [&]() { align32(in); align32(out); };
+
+    both32(MREAMagic);
+    both32(isMP3 ? MREAVersionMP3 : MREAVersionMP2);
+    for (atUint32 i = 0; i < 12; i++) // transform
+    {
+        writeBigFloat(in, (i % 5) == 0 ? 1.f : 0.f);
+        writeBigFloat(out, (i % 5) == 0 ? 1.f : 0.f);
+    }
+    both32(0); // mesh count
+    both32(1); // scly layer count
+    both32(sectionSizes.size());
+
+    if (!isMP3)
+    {
+        // Material, SCLY, SCGN, collision, unknown, lights, VISI, paths, AROT, PTLA, EGMC
+        for (atUint32 i = 0; i < 11; i++)
+            both32(std::min<atUint32>(i, sectionSizes.size() - 1));
+    }
+
+    both32(blocks.size());
+    static const char* sectionTags[] = {"AABB", "COLI", "GPUD", "LITE", "PVS!", "SOBJ", "SGEN", "APTL"};
+    atUint32 sectionNumberCount = isMP3 ? std::min<atUint32>(8, sectionSizes.size()) : 0;
+    if (isMP3)
+        writeBig32(in, sectionNumberCount);
+    writeBig32(out, sectionNumberCount); // decompressMREA always writes this one
+    bothAlign();
+
+    for (atUint32 size : sectionSizes)
+        both32(size);
+    bothAlign();
+
+    std::vector<Bytes> blockData;
+    atUint32 offset = 0;
+    for (atUint32 i = 0; i < blocks.size(); i++)
+    {
+        atUint32 dataSize = 0;
+        for (atUint32 s = blocks[i].first; s < blocks[i].first + blocks[i].second; s++)
+            dataSize += sectionSizes[s];
+
+        // Neither can a stored segment, those are told apart by the same peek
+        for (atUint32 segment = offset; segment + 1 < offset + dataSize; segment += LZOSegmentSize)
+        {
+            if (looksLikeZlib(&content[segment], 2))
+                content[segment + 1] ^= 0xFF;
+        }
+
+        // Every third MP3 block is zlib, decompressBlock handles both
+        bool zlib = isMP3 && (i % 3) == 2;
+        Bytes packed = compressMREASegments(content.data() + offset, dataSize, zlib);
+        Bytes stored;
+        atUint32 compSize = 0;
+        if (packed.size() >= dataSize)
+            stored.assign(content.begin() + offset, content.begin() + offset + dataSize);
+        else
+        {
+            // Compressed blocks are padded at the front
+            compSize = packed.size();
+            stored.assign(ROUND_UP_32(compSize) - compSize, 0);
+            stored.insert(stored.end(), packed.begin(), packed.end());
+        }
+
+        writeBig32(in, stored.size());
+        writeBig32(out, stored.size());
+        both32(dataSize);
+        writeBig32(in, compSize);
+        writeBig32(out, 0);
+        both32(blocks[i].second);
+
+        blockData.push_back(std::move(stored));
+        offset += dataSize;
+    }
+    bothAlign();
+
+    if (isMP3)
+    {
+        for (atUint32 i = 0; i < sectionNumberCount; i++)
+        {
+            const char* tag = sectionTags[i];
+            both32((tag[0] << 24) | (tag[1] << 16) | (tag[2] << 8) | tag[3]);
+            both32(i * sectionSizes.size() / sectionNumberCount);
+        }
+        bothAlign();
+    }
+
+    for (const Bytes& block : blockData)
+        in.insert(in.end(), block.begin(), block.end());
+    out.insert(out.end(), content.begin(), content.end());
+
+    SSyntheticPayload ret;
+    ret.kind      = kind;
+    ret.data      = std::move(in);
+    ret.outLength = out.size();
+    ret.outHash   = contentHash(out.data(), out.size());
+    return ret;
+}
+}
+
+const char* syntheticKindName(ESyntheticKind kind)
+{
+    switch(kind)
+    {
+        case ESyntheticKind::ZlibStream:   return "zlib";
+        case ESyntheticKind::LZOStream:    return "LZO";
+        case ESyntheticKind::PrefixedZlib: return "prefixed-zlib";
+        case ESyntheticKind::PrefixedLZO:  return "prefixed-LZO";
+        case ESyntheticKind::CMPD:         return "CMPD";
+        case ESyntheticKind::MREAMP2:      return "MREA-MP2";
+        case ESyntheticKind::MREAMP3:      return "MREA-MP3";
+    }
+
+    return "";
+}
+
+std::vector<atUint8> syntheticContent(atUint32 length, float redundancy, atUint32 seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    Bytes ret;
+    ret.reserve(length + 0x1000);
+
+    while (ret.size() < length)
+    {
+        atUint32 chunk = 0x100 + rng() % 0x1000;
+        if (unit(rng) >= redundancy)
+        {
+            for (atUint32 i = 0; i < chunk; i++)
+                ret.push_back(rng());
+            continue;
+        }
+
+        switch (rng() % 3)
+        {
+            case 0:
+            {
+                // Vertex positions wandering around, on a 1/64 grid like most level geometry
+                float pos[3] = {(float)(rng() % 256), (float)(rng() % 256), (float)(rng() % 64)};
+                for (atUint32 i = 0; i < chunk / 12; i++)
+                {
+                    for (float& p : pos)
+                    {
+                        p += ((atInt32)(rng() % 33) - 16) / 64.f;
+                        writeBigFloat(ret, p);
+                    }
+                }
+                break;
+            }
+            case 1:
+            {
+                // Triangle strip indices, mostly counting up
+                atUint16 index = rng();
+                for (atUint32 i = 0; i < chunk / 2; i++)
+                {
+                    index += (rng() % 8 == 0) ? (atUint16)(rng() % 64) : 1;
+                    writeBig16(ret, index);
+                }
+                break;
+            }
+            case 2:
+            {
+                // The same record over and over with a counter in it, like script objects or material passes
+                Bytes record(16 + rng() % 48);
+                for (atUint8& b : record)
+                    b = (rng() % 4 == 0) ? rng() : 0;
+
+                for (atUint32 i = 0; i < chunk / record.size(); i++)
+                {
+                    ret.insert(ret.end(), record.begin(), record.end());
+                    memcpy(&ret[ret.size() - 4], &i, 4);
+                }
+                break;
+            }
+        }
+    }
+
+    ret.resize(length);
+    return ret;
+}
+
+SSyntheticPayload makeSyntheticPayload(ESyntheticKind kind, atUint32 length, float redundancy, atUint32 seed)
+{
+    if (kind == ESyntheticKind::MREAMP2 || kind == ESyntheticKind::MREAMP3)
+        return makeMREA(kind, length, redundancy, seed);
+
+    Bytes content = syntheticContent(length, redundancy, seed);
+    SSyntheticPayload ret = (kind == ESyntheticKind::CMPD ? makeCMPD(content) : makePrefixed(kind, content));
+    ret.outLength = content.size();
+    ret.outHash   = contentHash(content.data(), content.size());
+    return ret;
+}
+
+std::vector<SCorruptPayload> makeCorruptPayloads()
+{
+    std::vector<SCorruptPayload> ret;
+
+    // A size prefixed resource of 64 bytes with one damaged LZO stream segment
+    auto prefixed = [&](const char* name, atUint16 segmentSize, atUint32 segmentData)
+    {
+        SCorruptPayload payload{name, Bytes(), false};
+        writeBig32(payload.data, 64);
+        writeBig16(payload.data, segmentSize);
+        payload.data.resize(payload.data.size() + segmentData, 0);
+        ret.push_back(payload);
+    };
+
+    // -0x8000 stays negative when negated as an atInt16
+    prefixed("stored -0x8000", 0x8000, 64);
+    prefixed("stored past end", (atUint16)-64, 10);
+    prefixed("stored past out", (atUint16)-128, 128);
+    prefixed("LZO past end", 64, 5);
+
+    // The same -0x8000 segment inside an MP3 block
+    SCorruptPayload cmpd{"CMPD stored -0x8000", Bytes(), false};
+    cmpd.data.insert(cmpd.data.end(), {'C', 'M', 'P', 'D'});
+    writeBig32(cmpd.data, 1);
+    writeBig32(cmpd.data, CMPDBlockFlag | 4);
+    writeBig32(cmpd.data, 64);
+    writeBig32(cmpd.data, 0x80000000);
+    ret.push_back(cmpd);
+
+    // A block claiming far more than it could decompress to
+    SCorruptPayload huge{"CMPD block too large", Bytes(), true};
+    huge.data.insert(huge.data.end(), {'C', 'M', 'P', 'D'});
+    writeBig32(huge.data, 1);
+    writeBig32(huge.data, CMPDBlockFlag | 16);
+    writeBig32(huge.data, 0xFFFFFFF0);
+    huge.data.resize(huge.data.size() + 16, 0);
+    ret.push_back(huge);
+
+    return ret;
+}
@@ -0,0 +1,49 @@
+#ifndef SYNTHETICCORPUS_HPP
+#define SYNTHETICCORPUS_HPP
+
+#include <Athena/Types.hpp>
+#include <string>
+#include <vector>
+
+// Generates compressed payloads in every layout RetroCommon decompresses, so its throughput
+// can be measured without any game files. Everything is deterministic for a given seed.
+
+enum class ESyntheticKind
+{
+    ZlibStream,   // a bare zlib stream, what decompressData sees of an MP1 resource
+    LZOStream,    // bare LZO segments, what decompressData sees of an MP2 resource
+    PrefixedZlib, // MP1 size prefixed resource
+    PrefixedLZO,  // MP2 size prefixed resource
+    CMPD,         // MP3 block compressed resource, LZO blocks with the odd stored one
+    MREAMP2,      // MP2 area, LZO compressed blocks
+    MREAMP3       // MP3 area, LZO and zlib compressed blocks
+};
+
+struct SSyntheticPayload
+{
+    ESyntheticKind        kind;
+    std::vector<atUint8>  data;
+    atUint32              outLength; // once decompressed
+    atUint64              outHash;   // contentHash of the decompressed payload
+};
+
+const char* syntheticKindName(ESyntheticKind kind);
+
+// Resource like content: big endian float arrays, index runs, repeated records and noise.
+// redundancy goes from 0 (nothing but noise) to 1 (no noise at all)
+std::vector<atUint8> syntheticContent(atUint32 length, float redundancy, atUint32 seed);
+
+// A payload decompressing to (about, areas round their sections) length bytes
+SSyntheticPayload makeSyntheticPayload(ESyntheticKind kind, atUint32 length, float redundancy, atUint32 seed);
+
+// A damaged payload, every entry point has to turn it down without reading or writing out of bounds
+struct SCorruptPayload
+{
+    const char*           name;
+    std::vector<atUint8>  data;
+    bool                  headerDamaged; // CCMPDReader refuses it up front, otherwise its reads throw
+};
+
+std::vector<SCorruptPayload> makeCorruptPayloads();
+
+#endif // SYNTHETICCORPUS_HPP
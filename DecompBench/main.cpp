@@ -0,0 +1,309 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <CInflateBackend.hpp>
+#include <CCMPDReader.hpp>
+#include <RetroCommon.hpp>
+#include <Athena/MemoryWriter.hpp>
+#include <Athena/InvalidDataException.hpp>
+#include <memory.h>
+
+#include "SyntheticCorpus.hpp"
+
+static const ESyntheticKind allKinds[] = {
+    ESyntheticKind::ZlibStream, ESyntheticKind::LZOStream,
+    ESyntheticKind::PrefixedZlib, ESyntheticKind::PrefixedLZO, ESyntheticKind::CMPD,
+    ESyntheticKind::MREAMP2, ESyntheticKind::MREAMP3
+};
+
+// Piece sizes streamed reads cycle through, uneven so reads keep straddling block boundaries
+static const atUint32 streamReadSizes[] = {4096, 12, 65536, 1000, 333, 20000};
+
+// Kinds CCMPDReader can stream as well as decompress in one go
+static bool isStreamable(ESyntheticKind kind)
+{
+    return kind == ESyntheticKind::PrefixedZlib || kind == ESyntheticKind::PrefixedLZO || kind == ESyntheticKind::CMPD;
+}
+
+// The entry point each kind goes through, the way the loaders would call it
+static const char* entryPointName(ESyntheticKind kind, bool streamed)
+{
+    if (streamed)
+        return "CCMPDReader";
+
+    switch(kind)
+    {
+        case ESyntheticKind::ZlibStream:
+        case ESyntheticKind::LZOStream:
+            return "decompressData";
+        case ESyntheticKind::PrefixedZlib:
+        case ESyntheticKind::PrefixedLZO:
+        case ESyntheticKind::CMPD:
+            return "decompressFile";
+        case ESyntheticKind::MREAMP2:
+        case ESyntheticKind::MREAMP3:
+            return "decompressMREA";
+    }
+
+    return "";
+}
+
+// Reads a payload through CCMPDReader a piece at a time, the way a parser walking the resource would
+static bool runStreamed(const SSyntheticPayload& payload, atUint8* out, std::chrono::steady_clock::duration& elapsed)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CCMPDReader reader(payload.data.data(), payload.data.size());
+    if (!reader.isValid() || reader.length() != payload.outLength)
+    {
+        elapsed = std::chrono::steady_clock::now() - start;
+        return false;
+    }
+
+    atUint64 position = 0;
+    for (atUint32 piece = 0; position < payload.outLength; piece++)
+    {
+        atUint64 count = std::min<atUint64>(streamReadSizes[piece % (sizeof(streamReadSizes) / sizeof(*streamReadSizes))],
+                                            payload.outLength - position);
+        reader.readUBytesToBuf(out + position, count);
+        position += count;
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+
+    return contentHash(out, payload.outLength) == payload.outHash;
+}
+
+// Decompresses one payload, returns how long the call itself took and whether the output matched
+static bool runOnce(const SSyntheticPayload& payload, bool streamed, atUint8* out, std::chrono::steady_clock::duration& elapsed)
+{
+    if (streamed)
+        return runStreamed(payload, out, elapsed);
+
+    std::chrono::steady_clock::time_point start;
+    switch(payload.kind)
+    {
+        case ESyntheticKind::ZlibStream:
+        case ESyntheticKind::LZOStream:
+        {
+            Athena::io::MemoryWriter writer(out, payload.outLength);
+            start = std::chrono::steady_clock::now();
+            decompressData(writer, payload.data.data(), payload.data.size(), payload.outLength);
+            elapsed = std::chrono::steady_clock::now() - start;
+            break;
+        }
+        case ESyntheticKind::PrefixedZlib:
+        case ESyntheticKind::PrefixedLZO:
+        case ESyntheticKind::CMPD:
+        {
+            // decompressFile takes its input over, the copy isn't part of what's measured
+            atUint8* data = new atUint8[payload.data.size()];
+            memcpy(data, payload.data.data(), payload.data.size());
+            Athena::io::MemoryWriter writer(out, payload.outLength);
+            start = std::chrono::steady_clock::now();
+            decompressFile(writer, data, payload.data.size());
+            elapsed = std::chrono::steady_clock::now() - start;
+            break;
+        }
+        case ESyntheticKind::MREAMP2:
+        case ESyntheticKind::MREAMP3:
+        {
+            atUint32 length = 0;
+            start = std::chrono::steady_clock::now();
+            atUint8* area = decompressMREA(payload.data.data(), payload.data.size(), length);
+            elapsed = std::chrono::steady_clock::now() - start;
+            if (!area || length != payload.outLength)
+            {
+                delete[] area;
+                return false;
+            }
+
+            memcpy(out, area, length);
+            delete[] area;
+            break;
+        }
+    }
+
+    return contentHash(out, payload.outLength) == payload.outHash;
+}
+
+// Whether every entry point turns a damaged payload down
+static bool rejectsCorrupt(const SCorruptPayload& payload)
+{
+    // None of them claim more than this, larger sizes are left to the size checks
+    const atUint32 maxLength = 0x10000;
+    std::unique_ptr<atUint8[]> out(new atUint8[maxLength]);
+    atUint32 length = decompressedSize(payload.data.data(), payload.data.size());
+    if (length > 0 && length <= maxLength && decompressInto(payload.data.data(), payload.data.size(), out.get(), length))
+        return false;
+
+    CCMPDReader reader(payload.data.data(), payload.data.size());
+    if (payload.headerDamaged || !reader.isValid() || reader.length() > maxLength)
+        return !reader.isValid();
+
+    try
+    {
+        reader.readUBytesToBuf(out.get(), reader.length());
+    }
+    catch(const Athena::error::Exception&)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+
+    return sorted[std::min<size_t>(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+void usage(const std::string& progName)
+{
+    printf("Usage: %s [options]\n", progName.c_str());
+    printf("  -s <KiB>        decompressed payload size, can be given more than once, defaults to 16, 256 and 4096\n");
+    printf("  -c <count>      payloads generated per kind and size, defaults to 8\n");
+    printf("  -r <rounds>     how many times every payload is decompressed, defaults to 5\n");
+    printf("  -x <redundancy> 0 (incompressible) to 1 (no noise at all), defaults to 0.85\n");
+    printf("  -k <kind>       only benchmark this kind, can be given more than once\n");
+    printf("  -b <backend>    inflate backend to use\n");
+    printf("Kinds:");
+    for (ESyntheticKind kind : allKinds)
+        printf(" %s", syntheticKindName(kind));
+    printf("\nAvailable backends:");
+    for (const IInflateBackend* backend : inflateBackends())
+        printf(" %s", backend->name());
+    printf("\n");
+}
+
+int main(int argc, char* argv[])
+{
+    std::string progName = argv[0];
+    progName = progName.substr(progName.find_last_of("/\\") + 1);
+
+    std::vector<atUint32> sizes;
+    atUint32 count = 8;
+    atUint32 rounds = 5;
+    float redundancy = 0.85f;
+    std::vector<std::string> kindNames;
+    std::string backendName;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if ((arg == "-s" || arg == "-c" || arg == "-r" || arg == "-x" || arg == "-k" || arg == "-b") && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (arg == "-s")
+                sizes.push_back(std::max(1, atoi(value.c_str())) * 1024);
+            else if (arg == "-c")
+                count = std::max(1, atoi(value.c_str()));
+            else if (arg == "-r")
+                rounds = std::max(1, atoi(value.c_str()));
+            else if (arg == "-x")
+                redundancy = std::min(1.f, std::max(0.f, (float)atof(value.c_str())));
+            else if (arg == "-k")
+                kindNames.push_back(value);
+            else
+                backendName = value;
+        }
+        else
+        {
+            usage(progName);
+            return 1;
+        }
+    }
+
+    if (sizes.empty())
+        sizes = {16 * 1024, 256 * 1024, 4096 * 1024};
+
+    if (!backendName.empty() && !selectInflateBackend(backendName))
+    {
+        std::cout << "Unknown backend " << backendName << std::endl;
+        usage(progName);
+        return 1;
+    }
+
+    std::cout << "inflate backend " << currentInflateBackend().name() << ", redundancy " << redundancy
+              << ", " << count << " payloads per kind and size, " << rounds << " rounds" << std::endl;
+
+    int ret = 0;
+    try
+    {
+        for (const SCorruptPayload& payload : makeCorruptPayloads())
+        {
+            bool rejected = rejectsCorrupt(payload);
+            printf("%-15s %-25s %s\n", "corrupt input", payload.name, rejected ? "rejected" : "ACCEPTED");
+            if (!rejected)
+                ret = 1;
+        }
+
+        printf("%-15s %-14s %9s %10s %10s %10s %10s %10s\n", "entry point", "kind", "size", "ratio", "MiB/s", "p50 us", "p90 us", "p99 us");
+
+        for (ESyntheticKind kind : allKinds)
+        {
+            if (!kindNames.empty() && std::find(kindNames.begin(), kindNames.end(), syntheticKindName(kind)) == kindNames.end())
+                continue;
+
+            for (atUint32 size : sizes)
+            {
+                std::vector<SSyntheticPayload> payloads;
+                atUint64 inBytes = 0;
+                atUint32 maxOut = 0;
+                for (atUint32 i = 0; i < count; i++)
+                {
+                    payloads.push_back(makeSyntheticPayload(kind, size, redundancy, size + i));
+                    inBytes += payloads.back().data.size();
+                    maxOut = std::max(maxOut, payloads.back().outLength);
+                }
+
+                std::unique_ptr<atUint8[]> out(new atUint8[maxOut]);
+                for (bool streamed : {false, true})
+                {
+                    if (streamed && !isStreamable(kind))
+                        continue;
+
+                    std::vector<double> latencies;
+                    std::chrono::steady_clock::duration total(0);
+                    atUint64 outBytes = 0;
+                    atUint32 mismatches = 0;
+                    for (atUint32 round = 0; round < rounds; round++)
+                    {
+                        for (const SSyntheticPayload& payload : payloads)
+                        {
+                            std::chrono::steady_clock::duration elapsed(0);
+                            if (!runOnce(payload, streamed, out.get(), elapsed))
+                                mismatches++;
+
+                            total += elapsed;
+                            latencies.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+                            outBytes += payload.outLength;
+                        }
+                    }
+
+                    std::sort(latencies.begin(), latencies.end());
+                    double seconds = std::chrono::duration<double>(total).count();
+                    double ratio = (double)inBytes * rounds / outBytes;
+                    printf("%-15s %-14s %6u KiB %10.2f %10.1f %10.1f %10.1f %10.1f",
+                           entryPointName(kind, streamed), syntheticKindName(kind), size / 1024, ratio,
+                           seconds > 0 ? outBytes / (1024.0 * 1024.0) / seconds : 0.0,
+                           percentile(latencies, 0.5), percentile(latencies, 0.9), percentile(latencies, 0.99));
+                    if (mismatches)
+                        printf("  %u MISMATCHED", mismatches);
+                    printf("\n");
+
+                    if (mismatches)
+                        ret = 1;
+                }
+            }
+        }
+    }
+    catch(const Athena::error::Exception& e)
+    {
+        std::cout << e.file() << ": " << e.function() << "(" << e.line() << ")" << e.message() << std::endl;
+        ret = 1;
+    }
+
+    return ret;
+}
@@ -0,0 +1,11 @@
+TEMPLATE = app
+TARGET = inflatebench
+CONFIG += console std=c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+
+include(../Athena/AthenaCore.pri)
+include(../RetroCommon/RetroCommon.pri)
+include(../PakLib/PakLib.pri)
+
+SOURCES += main.cpp
@@ -0,0 +1,383 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <CPakFile.hpp>
+#include <CPakFileReader.hpp>
+#include <CInflateBackend.hpp>
+#include <RetroCommon.hpp>
+#include <Athena/Compression.hpp>
+#include <Athena/InvalidDataException.hpp>
+
+enum class EPayloadKind
+{
+    CMPD,     // MP3 style block compressed resources
+    Prefixed, // MP1/MP2 size prefixed resources
+    MREA      // Areas with their own compressed blocks
+};
+
+struct SPayload
+{
+    EPayloadKind kind;
+    const atUint8* data;
+    atUint32       length;
+    atUint32       outLength;
+    atUint64       outHash; // of the athena backend's output, every other backend has to match it
+    std::unique_ptr<atUint8[]> owned;
+};
+
+static const char* kindName(EPayloadKind kind)
+{
+    switch(kind)
+    {
+        case EPayloadKind::CMPD:     return "CMPD";
+        case EPayloadKind::Prefixed: return "prefixed";
+        case EPayloadKind::MREA:     return "MREA";
+    }
+
+    return "";
+}
+
+static atUint8* decompressPayload(const SPayload& payload, atUint32& length)
+{
+    if (payload.kind == EPayloadKind::MREA)
+        return decompressMREA(payload.data, payload.length, length);
+
+    return decompressResource(payload.data, payload.length, length);
+}
+
+struct SLZOSegment
+{
+    const atUint8* data;
+    atUint32       length;
+    atUint32       outLength;
+    atUint64       outHash;
+};
+
+// Segments are at most 0x4000 bytes either way, leave plenty of room for damaged ones
+static const atUint32 LZOScratchSize = 0x10000;
+
+// Picks the LZO segments out of a CMPD or size prefixed payload
+static void collectLZOSegments(const SPayload& payload, std::vector<SLZOSegment>& segments)
+{
+    std::vector<std::pair<const atUint8*, atUint32>> streams;
+    if (payload.kind == EPayloadKind::CMPD)
+    {
+        atUint32 blockCount = *(atUint32*)(payload.data + 4);
+        Athena::utility::BigUint32(blockCount);
+        const atUint8* blockData = payload.data + 8 + blockCount * 8;
+        for (atUint32 i = 0; i < blockCount; i++)
+        {
+            atUint32 compressedLen   = *(atUint32*)(payload.data + 8 + i * 8);
+            atUint32 uncompressedLen = *(atUint32*)(payload.data + 12 + i * 8);
+            Athena::utility::BigUint32(compressedLen);
+            Athena::utility::BigUint32(uncompressedLen);
+            compressedLen &= 0x00FFFFFF;
+            if (compressedLen != uncompressedLen)
+                streams.push_back(std::make_pair(blockData, compressedLen));
+            blockData += compressedLen;
+        }
+    }
+    else if (payload.kind == EPayloadKind::Prefixed)
+        streams.push_back(std::make_pair(payload.data + 4, payload.length - 4));
+
+    std::unique_ptr<atUint8[]> scratch(new atUint8[LZOScratchSize]);
+    for (const std::pair<const atUint8*, atUint32>& stream : streams)
+    {
+        const atUint8* data = stream.first;
+        const atUint8* end  = stream.first + stream.second;
+        if (stream.second < 2 || (data[0] == 0x78 && (data[1] == 0xDA || data[1] == 0x01 || data[1] == 0x9C)))
+            continue; // zlib
+
+        while (data + 2 <= end)
+        {
+            atInt16 segmentSize = *(atInt16*)data;
+            Athena::utility::BigInt16(segmentSize);
+            data += 2;
+
+            if (segmentSize < 0)
+            {
+                data -= segmentSize;
+                continue;
+            }
+
+            if (data + segmentSize > end)
+                break;
+
+            atInt32 remaining = LZOScratchSize;
+            if (!(Athena::io::Compression::decompressLZO(data, segmentSize, scratch.get(), remaining) & 8))
+            {
+                SLZOSegment segment;
+                segment.data      = data;
+                segment.length    = segmentSize;
+                segment.outLength = LZOScratchSize - remaining;
+                segment.outHash   = contentHash(scratch.get(), segment.outLength);
+                segments.push_back(segment);
+            }
+
+            data += segmentSize;
+        }
+    }
+}
+
+// Athena's decoder against the in tree one, bucketed by segment size
+static bool benchmarkLZO(const std::vector<std::unique_ptr<SPayload>>& payloads, atUint32 rounds)
+{
+    std::vector<SLZOSegment> segments;
+    for (const std::unique_ptr<SPayload>& payload : payloads)
+        collectLZOSegments(*payload, segments);
+
+    if (segments.empty())
+        return true;
+
+    std::cout << segments.size() << " LZO segments" << std::endl;
+
+    static const atUint32 bucketLimits[] = {0x400, 0x1000, 0x2000, 0x4000};
+    std::unique_ptr<atUint8[]> scratch(new atUint8[LZOScratchSize]);
+    bool ok = true;
+    atUint32 bucketStart = 0;
+    for (atUint32 bucketLimit : bucketLimits)
+    {
+        for (int decoder = 0; decoder < 2; decoder++)
+        {
+            atUint64 outBytes = 0;
+            atUint32 count = 0;
+            atUint32 mismatches = 0;
+            std::chrono::steady_clock::duration elapsed(0);
+
+            for (const SLZOSegment& segment : segments)
+            {
+                if (segment.length <= bucketStart || segment.length > bucketLimit)
+                    continue;
+
+                atUint32 length = 0;
+                auto start = std::chrono::steady_clock::now();
+                for (atUint32 i = 0; i < rounds; i++)
+                {
+                    if (decoder == 0)
+                    {
+                        atInt32 remaining = LZOScratchSize;
+                        Athena::io::Compression::decompressLZO(segment.data, segment.length, scratch.get(), remaining);
+                        length = LZOScratchSize - remaining;
+                    }
+                    else
+                        length = std::max(0, decompressLZO1X(segment.data, segment.length, scratch.get(), LZOScratchSize));
+                }
+                elapsed += std::chrono::steady_clock::now() - start;
+
+                if (length != segment.outLength || contentHash(scratch.get(), length) != segment.outHash)
+                    mismatches++;
+
+                outBytes += (atUint64)segment.outLength * rounds;
+                count++;
+            }
+
+            if (count == 0)
+                continue;
+
+            double seconds = std::chrono::duration<double>(elapsed).count();
+            printf("LZO %-8s %5u-%-5u %6u segments %10.1f MiB out %9.1f MiB/s",
+                   decoder == 0 ? "athena" : "in-tree", bucketStart + 1, bucketLimit, count,
+                   outBytes / (1024.0 * 1024.0), seconds > 0 ? outBytes / (1024.0 * 1024.0) / seconds : 0.0);
+            if (mismatches)
+                printf("  %u MISMATCHED", mismatches);
+            printf("\n");
+
+            if (mismatches)
+                ok = false;
+        }
+
+        bucketStart = bucketLimit;
+    }
+
+    return ok;
+}
+
+void usage(const std::string& progName)
+{
+    printf("Usage: %s [options] <in.pak> [in.pak...]\n", progName.c_str());
+    printf("  -r <rounds>     how many times every payload is decompressed per backend, defaults to 5\n");
+    printf("  -b <backend>    only benchmark this backend, can be given more than once\n");
+    printf("Available backends:");
+    for (const IInflateBackend* backend : inflateBackends())
+        printf(" %s", backend->name());
+    printf("\n");
+}
+
+int main(int argc, char* argv[])
+{
+    std::string progName = argv[0];
+    progName = progName.substr(progName.find_last_of("/\\") + 1);
+
+    atUint32 rounds = 5;
+    std::vector<std::string> backendNames;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if ((arg == "-r" || arg == "-b") && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (arg == "-r")
+                rounds = std::max(1, atoi(value.c_str()));
+            else
+                backendNames.push_back(value);
+        }
+        else if (arg[0] == '-')
+        {
+            usage(progName);
+            return 1;
+        }
+        else
+            files.push_back(arg);
+    }
+
+    if (files.empty())
+    {
+        usage(progName);
+        return 1;
+    }
+
+    std::vector<const IInflateBackend*> backends;
+    for (const IInflateBackend* backend : inflateBackends())
+    {
+        if (backendNames.empty() || std::find(backendNames.begin(), backendNames.end(), backend->name()) != backendNames.end())
+            backends.push_back(backend);
+    }
+
+    std::vector<CPakFile*> paks;
+    std::vector<std::unique_ptr<SPayload>> payloads;
+    int ret = 0;
+    try
+    {
+        // The reference output comes from the existing path
+        selectInflateBackend("athena");
+
+        for (const std::string& file : files)
+        {
+            CPakFile* pak = CPakFileReader::load(file);
+            pak->map();
+            paks.push_back(pak);
+
+            for (const SPakResource& res : pak->resources())
+            {
+                bool isMREA = res.tag == "MREA";
+                if (!isMREA && !res.compressed)
+                    continue;
+
+                std::unique_ptr<SPayload> payload(new SPayload);
+                payload->data   = pak->rawData(res);
+                payload->length = res.size;
+                if (!payload->data)
+                {
+                    payload->owned.reset(pak->loadData(res.id, res.tag));
+                    payload->data = payload->owned.get();
+                }
+
+                if (!payload->data)
+                    continue;
+
+                if (isMREA)
+                {
+                    // Get the pak level compression out of the way, only the area's own blocks are timed
+                    if (res.compressed)
+                    {
+                        atUint32 length = 0;
+                        atUint8* area = decompressResource(payload->data, payload->length, length);
+                        if (!area)
+                            continue;
+
+                        payload->owned.reset(area);
+                        payload->data   = area;
+                        payload->length = length;
+                    }
+
+                    payload->kind = EPayloadKind::MREA;
+                }
+                else
+                {
+                    atUint32 magic = *(atUint32*)payload->data;
+                    Athena::utility::BigUint32(magic);
+                    payload->kind = (magic == 0x434D5044 ? EPayloadKind::CMPD : EPayloadKind::Prefixed);
+                }
+
+                atUint8* out = decompressPayload(*payload, payload->outLength);
+                if (!out)
+                    continue; // MP1 areas aren't compressed, anything else is damaged
+
+                payload->outHash = contentHash(out, payload->outLength);
+                delete[] out;
+                payloads.push_back(std::move(payload));
+            }
+        }
+
+        std::cout << payloads.size() << " compressed payloads, " << rounds << " rounds" << std::endl;
+
+        for (const IInflateBackend* backend : backends)
+        {
+            selectInflateBackend(backend->name());
+
+            for (EPayloadKind kind : {EPayloadKind::CMPD, EPayloadKind::Prefixed, EPayloadKind::MREA})
+            {
+                atUint64 inBytes  = 0;
+                atUint64 outBytes = 0;
+                atUint32 count    = 0;
+                atUint32 mismatches = 0;
+                std::chrono::steady_clock::duration elapsed(0);
+
+                for (const std::unique_ptr<SPayload>& payload : payloads)
+                {
+                    if (payload->kind != kind)
+                        continue;
+
+                    for (atUint32 i = 0; i < rounds; i++)
+                    {
+                        atUint32 length = 0;
+                        auto start = std::chrono::steady_clock::now();
+                        atUint8* out = decompressPayload(*payload, length);
+                        elapsed += std::chrono::steady_clock::now() - start;
+
+                        // Only checked once, hashing isn't part of what's measured
+                        if (i == 0 && (!out || length != payload->outLength || contentHash(out, length) != payload->outHash))
+                            mismatches++;
+
+                        delete[] out;
+                    }
+
+                    inBytes  += (atUint64)payload->length * rounds;
+                    outBytes += (atUint64)payload->outLength * rounds;
+                    count++;
+                }
+
+                if (count == 0)
+                    continue;
+
+                double seconds = std::chrono::duration<double>(elapsed).count();
+                printf("%-12s %-9s %6u payloads %10.1f MiB in %10.1f MiB out %9.1f MiB/s",
+                       backend->name(), kindName(kind), count,
+                       inBytes / (1024.0 * 1024.0), outBytes / (1024.0 * 1024.0),
+                       seconds > 0 ? outBytes / (1024.0 * 1024.0) / seconds : 0.0);
+                if (mismatches)
+                    printf("  %u MISMATCHED", mismatches);
+                printf("\n");
+
+                if (mismatches)
+                    ret = 1;
+            }
+        }
+
+        if (!benchmarkLZO(payloads, rounds))
+            ret = 1;
+    }
+    catch(const Athena::error::Exception& e)
+    {
+        std::cout << e.file() << ": " << e.function() << "(" << e.line() << ")" << e.message() << std::endl;
+        ret = 1;
+    }
+
+    payloads.clear();
+    for (CPakFile* pak : paks)
+        delete pak;
+
+    return ret;
+}
@@ -1,14 +1,29 @@
 # Input
 INCLUDEPATH += $$PWD/include
+win32:INCLUDEPATH += $$PWD/../External/lzo/include
+win32:LIBS += -L$$PWD/../External/lzo/lib
+
+# CPakFileWriter compresses with zlib and LZO itself
+unix:LIBS += -llzo2 -lz
 
 HEADERS += \
     $$PWD/include/CPakFile.hpp \
     $$PWD/include/CPakFileReader.hpp \
+    $$PWD/include/CPakFileWriter.hpp \
+    $$PWD/include/CPakTableCache.hpp \
+    $$PWD/include/CDecompressedCache.hpp \
+    $$PWD/include/CMappedFile.hpp \
     $$PWD/include/CFourCC.hpp \
-    $$PWD/include/CUniqueID.hpp
+    $$PWD/include/CUniqueID.hpp \
+    $$PWD/include/CUniqueIDIndex.hpp
 
 SOURCES += \
     $$PWD/src/CPakFile.cpp \
     $$PWD/src/CPakFileReader.cpp \
-    $$PWD/src/CUniqueID.cpp
+    $$PWD/src/CPakFileWriter.cpp \
+    $$PWD/src/CPakTableCache.cpp \
+    $$PWD/src/CDecompressedCache.cpp \
+    $$PWD/src/CMappedFile.cpp \
+    $$PWD/src/CUniqueID.cpp \
+    $$PWD/src/CUniqueIDIndex.cpp
 
@@ -0,0 +1,63 @@
+#ifndef CDECOMPRESSEDCACHE_HPP
+#define CDECOMPRESSEDCACHE_HPP
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <Athena/Types.hpp>
+
+#include "CMappedFile.hpp"
+
+struct SPakResource;
+
+/*!
+ * \brief Size capped on-disk store of decompressed payloads.
+ *
+ * Entries are keyed by the content hash and size of the payload as stored in the pak
+ * (SPakResource::hash), so a payload shipped in several paks or under several IDs is
+ * only stored once. Hits are handed out mapped. Once the store grows past its limit the
+ * least recently used entries are removed, recency survives restarts through the
+ * entries' modification times.
+ * Safe to use from several threads at once.
+ */
+class CDecompressedCache final
+{
+public:
+    static const atUint64 DefaultSizeLimit = 1024ull * 1024 * 1024;
+
+    explicit CDecompressedCache(const std::string& cacheDirectory, atUint64 sizeLimit = DefaultSizeLimit);
+
+    // Whether undoing the pak's compression does anything, i.e whether it's worth caching.
+    // Entries only ever have the pak's compression undone, an MREA's blocks are left to CLazyMREA
+    static bool isCacheable(const SPakResource& resource);
+
+    // The decompressed payload of a resource stored as storedSize bytes hashing to hash, nullptr on a miss
+    std::shared_ptr<CMappedFile> find(atUint64 hash, atUint32 storedSize);
+    bool store(atUint64 hash, atUint32 storedSize, const atUint8* data, atUint32 length);
+
+    atUint64 size() const;
+    atUint64 sizeLimit() const;
+private:
+    struct SEntry
+    {
+        std::string name;
+        atUint64    size;
+    };
+
+    std::string entryName(atUint64 hash, atUint32 storedSize) const;
+    std::string entryPath(const std::string& name) const;
+    void scan();
+    // Expects m_mutex to be held
+    void evict();
+
+    std::string       m_cacheDirectory;
+    atUint64          m_sizeLimit;
+    atUint64          m_size;
+    mutable std::mutex m_mutex;
+    std::list<SEntry> m_lru; // most recently used first
+    std::unordered_map<std::string, std::list<SEntry>::iterator> m_entries;
+};
+
+#endif // CDECOMPRESSEDCACHE_HPP
@@ -4,63 +4,83 @@
 
 #include <Athena/IStreamReader.hpp>
 #include <string>
+#include <cctype>
+#include <functional>
 
 class CFourCC
 {
-    char fourCC[4];
+    atUint32 m_fourCC; // characters packed big endian, "MREA" is 0x4D524541 on every host
+
+    static constexpr atUint32 pack(const char* src)
+    {
+        return ((atUint32)(atUint8)src[0] << 24) | ((atUint32)(atUint8)src[1] << 16) |
+               ((atUint32)(atUint8)src[2] <<  8) |  (atUint32)(atUint8)src[3];
+    }
 public:
-    CFourCC() {*(atUint32*)fourCC = 0;}
-    CFourCC(const char *src) {*this = src;}
-    CFourCC(long src) {*this = src;}
+    constexpr CFourCC() : m_fourCC(0) {}
+    constexpr CFourCC(const char *src) : m_fourCC(pack(src)) {}
+    constexpr CFourCC(long src) : m_fourCC((atUint32)src) {}
     CFourCC(Athena::io::IStreamReader& src)
     {
-        src.readUBytesToBuf(fourCC, 4);
+        char tmp[4];
+        src.readUBytesToBuf(tmp, 4);
+        m_fourCC = pack(tmp);
     }
 
     inline CFourCC& operator=(const char *src)
     {
-        *(atUint32*)fourCC = *(atUint32*)src;
+        m_fourCC = pack(src);
         return *this;
     }
     inline CFourCC& operator=(long src)
     {
-        fourCC[0] = (src >> 24) & 0xFF;
-        fourCC[1] = (src >> 16) & 0xFF;
-        fourCC[2] = (src >>  8) & 0xFF;
-        fourCC[3] = (src >>  0) & 0xFF;
+        m_fourCC = (atUint32)src;
         return *this;
     }
-    inline bool operator==(const CFourCC& other) const
+    constexpr bool operator==(const CFourCC& other) const {return m_fourCC == other.m_fourCC;}
+    constexpr bool operator==(const char *other) const {return (*this == CFourCC(other));}
+    constexpr bool operator==(const long other) const {return (*this == CFourCC(other));}
+    constexpr bool operator!=(const CFourCC& other) const {return !(*this == other);}
+    constexpr bool operator!=(const char *other) const {return !(*this == other);}
+    constexpr bool operator!=(const long other) const {return !(*this == other);}
+
+    constexpr atUint32 toUint32() const {return m_fourCC;}
+    constexpr bool     isEmpty()  const {return m_fourCC == 0;}
+
+    // Same tag with every letter upper cased, for case insensitive matching
+    constexpr CFourCC upper() const
     {
-        return *(atUint32*)fourCC == *(atUint32*)other.fourCC;
+        return CFourCC((long)(m_fourCC & ~(upperMask(m_fourCC >> 24) << 24 | upperMask(m_fourCC >> 16) << 16 |
+                                           upperMask(m_fourCC >>  8) <<  8 | upperMask(m_fourCC))));
     }
-    inline bool operator==(const char *other) const {return (*this == CFourCC(other));}
-    inline bool operator==(const long other) const {return (*this == CFourCC(other));}
-    inline bool operator!=(const CFourCC& other) const {return !(*this == other);}
-    inline bool operator!=(const char *other) const {return !(*this == other);}
-    inline bool operator!=(const long other) const {return !(*this == other);}
-    
-    inline atUint32 toLong()
+
+    inline atUint32 toLong() const
     {
-        atUint32 ret = fourCC[0] << 24 | fourCC[1] << 16 | fourCC[2] << 8 | fourCC[3];
-        Athena::utility::LittleUint32(ret);
-        
-        return ret;
+        return m_fourCC;
     }
-    
+
     inline std::string toString() const
     {
-        return std::string(fourCC, 4);
+        char tmp[4] = {(char)(m_fourCC >> 24), (char)(m_fourCC >> 16), (char)(m_fourCC >> 8), (char)m_fourCC};
+        return std::string(tmp, 4);
     }
 
-    inline bool valid()
+    inline bool valid() const
     {
         for (atUint32 i = 0; i < 4; i++)
-            if (!(isalpha(fourCC[i]) || isdigit(fourCC[i])))
+        {
+            char c = (char)(m_fourCC >> (24 - i * 8));
+            if (!(isalpha(c) || isdigit(c)))
                 return false;
+        }
 
         return true;
     }
+private:
+    static constexpr atUint32 upperMask(atUint32 c)
+    {
+        return ((c & 0xFF) >= 'a' && (c & 0xFF) <= 'z') ? 0x20 : 0;
+    }
 };
 
 class CFourCCHash final
@@ -68,9 +88,7 @@ class CFourCCHash final
 public:
     std::size_t operator()(CFourCC const& fourCC) const
     {
-        std::string tmp = fourCC.toString();
-        std::hash<std::string> hashFn;
-        return hashFn(tmp);
+        return std::hash<atUint32>()(fourCC.toUint32());
     }
 };
 
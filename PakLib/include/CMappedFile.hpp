@@ -0,0 +1,30 @@
+#ifndef CMAPPEDFILE_HPP
+#define CMAPPEDFILE_HPP
+
+#include <string>
+#include <Athena/Types.hpp>
+
+/*!
+ * \brief Read only view of a whole file.
+ *
+ * Mapped (mmap or MapViewOfFile) where possible, otherwise the file is read into memory.
+ * data() is nullptr if the file couldn't be opened or is empty.
+ */
+class CMappedFile final
+{
+public:
+    explicit CMappedFile(const std::string& path);
+    ~CMappedFile();
+
+    const atUint8* data() const { return m_data; }
+    atUint64       size() const { return m_size; }
+private:
+    CMappedFile(const CMappedFile&) = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+    const atUint8* m_data;
+    atUint64       m_size;
+    bool           m_mapped;
+};
+
+#endif // CMAPPEDFILE_HPP
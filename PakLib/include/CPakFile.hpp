@@ -4,13 +4,18 @@
 #include <string>
 #include <Athena/Types.hpp>
 #include <unordered_map>
+#include <memory>
 #include <vector>
 #include <memory.h>
 #include <cstring>
 
 #include "CUniqueID.hpp"
+#include "CUniqueIDIndex.hpp"
 #include "CFourCC.hpp"
 
+class CDecompressedCache;
+class CMappedFile;
+
 struct SPakResource
 {
     atUint32 compressed;
@@ -18,6 +23,7 @@ struct SPakResource
     CUniqueID id;
     atUint32 size;
     atUint32 offset;
+    atUint64 hash; // contentHash of the data as stored, 0 until CPakFile::computeHashes/setHashes or if it couldn't be read
 };
 
 struct SPakNamedResource
@@ -27,6 +33,31 @@ struct SPakNamedResource
     std::string name;
 };
 
+/*!
+ * \brief Non-owning view over a contiguous run of resources.
+ *
+ * Spans handed out by CPakFile point into the pak's own tables and are
+ * invalidated whenever the tables are rebuilt (e.g by removeDuplicates).
+ */
+class CPakResourceSpan final
+{
+public:
+    typedef const SPakResource* const_iterator;
+
+    CPakResourceSpan() : m_begin(nullptr), m_end(nullptr) {}
+    CPakResourceSpan(const SPakResource* begin, const SPakResource* end) : m_begin(begin), m_end(end) {}
+
+    const_iterator begin() const { return m_begin; }
+    const_iterator end()   const { return m_end;   }
+    size_t size()          const { return m_end - m_begin; }
+    bool   empty()         const { return m_begin == m_end; }
+    const SPakResource& operator[](size_t i) const { return m_begin[i]; }
+    const SPakResource& at(size_t i)         const { return m_begin[i]; }
+private:
+    const SPakResource* m_begin;
+    const SPakResource* m_end;
+};
+
 namespace EPakVersion
 {
 enum
@@ -53,33 +84,94 @@ public:
 
     void loadTable();
 
-    atUint8* loadData(CUniqueID assetID, const std::string& type = std::string());
+    // Maps the whole pak read only (mmap or MapViewOfFile), when that fails everything keeps reading through FileReader
+    bool map();
+    void unmap();
+    bool isMapped() const;
 
-    std::vector<SPakResource> resourcesByType(const std::string& type);
-    std::vector<SPakResource> resources() const;
+    atUint8* loadData(const CUniqueID& assetID, const CFourCC& type = CFourCC());
+    std::vector<atUint8*> loadBatch(const std::vector<CUniqueID>& assetIDs);
+    const atUint8* rawData(const SPakResource& resource) const;
+    const atUint8* resourceView(const CUniqueID& assetID, atUint32& size, const CFourCC& type = CFourCC()) const;
+
+    const SPakResource* resource(const CUniqueID& assetID, const CFourCC& type = CFourCC()) const;
+    CPakResourceSpan resourcesByType(const CFourCC& type) const;
+    const std::vector<SPakResource>& resources() const;
 
     std::string resourceName(const atUint64& assetID);
-    void dumpPak(const std::string& path, bool decompress=true);
+    std::string resourceName(const CUniqueID& assetID);
+    // With a cache decompressed payloads are taken from it when possible and added to it otherwise.
+    // Decompresses on the worker pool and waits on it, so it can't be called from a pool job
+    void dumpPak(const std::string& path, bool decompress=true, CDecompressedCache* cache=nullptr);
 
     bool isWorldPak();
 
-    bool resourceExists(const CUniqueID& assetID);
-    bool resourceExists(const SPakResource& resource);
+    bool resourceExists(const CUniqueID& assetID) const;
+    bool resourceExists(const SPakResource& resource) const;
 
     int version() const;
 
     void removeDuplicates();
+    void computeHashes();
+    bool hasHashes() const;
+    // What computeHashes works out, one hash per entry of resources(), without touching the tables. Only reads
+    // the pak, so it can run on a pool job while the pak is in use
+    std::vector<atUint64> contentHashes() const;
+    // Finishes computeHashes with the result of contentHashes. Pointers into the tables (resourcesByType too) stay valid
+    void setHashes(const std::vector<atUint64>& hashes);
+
+    // The resource with the pak's compression undone and, with areaBlocks, an MREA's blocks as well in a new[] buffer,
+    // nullptr if there's nothing to undo or it's damaged
+    static atUint8* decompressPayload(const SPakResource& resource, const atUint8* stored, atUint32& length,
+                                      bool areaBlocks = true);
 private:
     friend class CPakFileReader;
+    friend class CPakTableCache;
+    friend class CPakFileWriter;
+
+    struct STypePartition
+    {
+        atUint32 tag; // case folded
+        atUint32 start;
+        atUint32 count;
+    };
+
+    void buildIndex();
+
+    // One resource travelling through the dumpPak pipeline, data is owned by the job, view points into
+    // the mapping or into cached when the payload came out of the decompressed cache
+    struct SDumpJob
+    {
+        atUint32                     index;
+        const SPakResource*          resource;
+        const atUint8*               view;
+        atUint8*                     data;
+        atUint32                     length;
+        std::shared_ptr<CMappedFile> cached;
+    };
+    void processDumpJob(SDumpJob& job, bool decompress, CDecompressedCache* cache) const;
+    std::vector<atUint8*> loadBatch(const std::vector<const SPakResource*>& resources);
+    void adviseSequential(bool sequential) const;
+    void adviseWillNeed(const SPakResource& resource) const;
 
     bool        m_isWorldPak;
     std::string m_filename;
     atUint32    m_version;
     atUint32    m_dataStart;
     atUint32    m_tableStart;
+    bool        m_hashed;      // computeHashes ran, resources it couldn't read still have hash 0
+    atUint8*    m_mapping;     // whole pak mapped read only, nullptr unless map() succeeded
+    atUint64    m_mappingSize;
 
     std::vector<SPakNamedResource> m_namedResources;
     std::vector<SPakResource>      m_resources;
+
+    // Lookup tables, rebuilt by buildIndex whenever the tables above change
+    CUniqueIDIndex                 m_resourceIndex;
+    CUniqueIDIndex                 m_namedResourceIndex;
+    std::vector<SPakResource>      m_typedResources; // m_resources grouped by tag, offset order within a tag
+    std::vector<atUint32>          m_typedOrder;     // where each m_typedResources entry is in m_resources
+    std::vector<STypePartition>    m_typePartitions;
 };
 
 bool operator ==(const SPakNamedResource& left, const SPakNamedResource& right);
@@ -0,0 +1,75 @@
+#ifndef CPAKFILEWRITER_HPP
+#define CPAKFILEWRITER_HPP
+
+#include <string>
+#include <vector>
+#include <Athena/Types.hpp>
+
+#include "CPakFile.hpp"
+
+/*!
+ * \brief Writes resources taken from one or more paks out as a new pak.
+ *
+ * Supports the MP1/MP2 layout (including the MP3 beta's 64 bit IDs) and the sectioned MP3 layout.
+ * Resources are written in the order given by the order groups (access traces, area dependency
+ * lists, ...), anything not covered by a group follows in the order it was added.
+ * Payloads that were compressed in their source pak are recompressed in parallel with the
+ * requested codec, identical payloads (by content hash) are only stored once.
+ */
+class CPakFileWriter final
+{
+public:
+    enum class ECompression
+    {
+        Keep, //!< Copy compressed payloads as stored when the layouts match, otherwise use the layout's default codec
+        None, //!< Store everything decompressed
+        Zlib, //!< What MP1 uses
+        LZO   //!< What MP2 and MP3 use
+    };
+
+    CPakFileWriter(atUint32 version, ECompression compression = ECompression::Keep);
+
+    void addPak(CPakFile* pak);
+    // The first resource added for an ID and type wins, source has to outlive the writer
+    void addResource(const SPakResource& resource, CPakFile* source);
+    void addNamedResource(const SPakNamedResource& name);
+
+    void addOrderGroup(const std::vector<CUniqueID>& ids);
+    // Reads a trace as written by CResourceManager::setAccessTrace and adds it as an order group
+    bool loadAccessTrace(const std::string& tracePath);
+
+    void save(const std::string& filename);
+
+    atUint32 version() const;
+private:
+    struct SEntry
+    {
+        SPakResource resource; // as found in the source pak
+        CPakFile*    source;
+    };
+
+    // What save actually puts on disk for an entry
+    struct SEncoded
+    {
+        atUint8* data;
+        atUint32 length;     // including padding
+        atUint32 compressed;
+    };
+
+    std::vector<atUint32> writeOrder() const;
+    SEncoded encode(const SEntry& entry, atUint8* stored) const;
+    atUint8* compressStream(const atUint8* data, atUint32 length, atUint32& outLength) const;
+
+    bool        isMP3() const;
+    bool        sameLayout(const CPakFile* source) const;
+    atUint32    alignment() const;
+    CUniqueID::EIDBits idBits() const;
+
+    atUint32                        m_version;
+    ECompression                    m_compression;
+    std::vector<SEntry>             m_entries;
+    std::vector<SPakNamedResource>  m_namedResources;
+    std::vector<std::vector<CUniqueID>> m_orderGroups;
+};
+
+#endif // CPAKFILEWRITER_HPP
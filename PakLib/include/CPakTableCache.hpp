@@ -0,0 +1,32 @@
+#ifndef CPAKTABLECACHE_HPP
+#define CPAKTABLECACHE_HPP
+
+#include <string>
+
+class CPakFile;
+
+/*!
+ * \brief Persistent cache of a pak's parsed name and resource tables.
+ *
+ * Entries are keyed by the pak's path, size and modification time, if any of those
+ * change the entry is ignored and rewritten on the next save.
+ * The resource table is stored as an array of SPakResource in native layout, loading
+ * it is a single copy out of the mapped cache file. It isn't used in place: CPakFile owns
+ * its tables and changes them (removeDuplicates, computeHashes), so load still copies the
+ * records, rebuilds the name strings and runs buildIndex. What's saved is the pak parse.
+ */
+class CPakTableCache final
+{
+public:
+    explicit CPakTableCache(const std::string& cacheDirectory);
+
+    // Returns nullptr when there is no valid entry for the pak
+    CPakFile* load(const std::string& pakPath) const;
+    bool      save(const CPakFile* pak) const;
+
+    std::string entryPath(const std::string& pakPath) const;
+private:
+    std::string m_cacheDirectory;
+};
+
+#endif // CPAKTABLECACHE_HPP
@@ -2,6 +2,7 @@
 #define CUNIQUEID_HPP
 
 #include <Athena/IStreamReader.hpp>
+#include <type_traits>
 
 class CUniqueID
 {
@@ -15,13 +16,12 @@ public:
         E_128Bits
     };
 
-    CUniqueID();
+    constexpr CUniqueID() : m_words{~0ULL, ~0ULL}, m_idLen(E_Invalid) {}
     CUniqueID(Athena::io::IStreamReader& input, EIDBits idLength);
     CUniqueID(const atUint8* assetID, EIDBits idLength);
     CUniqueID(const atUint32& assetID);
     CUniqueID(const atUint64& assetID);
 
-    ~CUniqueID();
     atUint32 toUint32() const;
     atUint64 toUint64() const;
     atUint32 idLength() const;
@@ -36,26 +36,44 @@ public:
     bool operator!=(atUint32 right) const;
     bool operator==(atUint64 right) const;
     bool operator!=(atUint64 right) const;
-    bool operator==(const CUniqueID& right)const;
-    bool operator!=(const CUniqueID& right)const;
+    inline bool operator==(const CUniqueID& right) const
+    {
+        return m_words[0] == right.m_words[0] && m_words[1] == right.m_words[1];
+    }
+    inline bool operator!=(const CUniqueID& right) const
+    {
+        return !(*this == right);
+    }
+
+    // Mixes both halves of the raw ID, 32 and 64 bit IDs leave the upper half zeroed
+    inline atUint64 hash() const
+    {
+        atUint64 h = m_words[0] ^ (m_words[1] * 0x9E3779B97F4A7C15ULL);
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return h;
+    }
     void fromUint32(const atUint32& other);
     void fromUint64(const atUint64& other);
 
 
 private:
+    atUint64 m_words[2]; // the ID's bytes in file order, anything past idLength() is zero
     EIDBits  m_idLen;
-    atUint8  m_idVal[16];
 };
 
+static_assert(std::is_trivially_copyable<CUniqueID>::value, "CUniqueID is copied around by value and stored raw in the table cache");
+
 
 class CUniqueIDHash final
 {
 public:
     std::size_t operator()(CUniqueID const& id) const
     {
-        std::string tmp = id.toString();
-        std::hash<std::string> hashFn;
-        return hashFn(tmp);
+        return (std::size_t)id.hash();
     }
 };
 
@@ -0,0 +1,42 @@
+#ifndef CUNIQUEIDINDEX_HPP
+#define CUNIQUEIDINDEX_HPP
+
+#include "CUniqueID.hpp"
+#include <vector>
+
+/*!
+ * \brief Open addressing (linear probe) map from CUniqueID to an entry index.
+ *
+ * The index doesn't own the entries, it only stores their position in whatever
+ * container the owner keeps them in, so it must be rebuilt if that container is reordered.
+ * When an ID is inserted more than once the first entry wins, this matches the
+ * behavior of the std::find_if lookups it replaces.
+ */
+class CUniqueIDIndex final
+{
+public:
+    static const atUint32 InvalidEntry = 0xFFFFFFFF;
+
+    CUniqueIDIndex();
+
+    void     reserve(atUint32 count);
+    void     clear();
+    bool     insert(const CUniqueID& id, atUint32 entry);
+    atUint32 find(const CUniqueID& id) const;
+    atUint32 size() const;
+
+private:
+    struct SSlot
+    {
+        CUniqueID id;
+        atUint32  entry;
+    };
+
+    void rehash(atUint32 capacity);
+
+    std::vector<SSlot> m_slots;
+    atUint32           m_mask;
+    atUint32           m_count;
+};
+
+#endif // CUNIQUEIDINDEX_HPP
@@ -0,0 +1,198 @@
+#include "CDecompressedCache.hpp"
+#include "CPakFile.hpp"
+#include <Athena/FileWriter.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <iterator>
+#include <vector>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
+
+namespace
+{
+const char EntryExtension[] = ".dcmp";
+// Bumped whenever what an entry holds changes, entries from before never match again and age out
+const atUint32 EntryFormat = 2;
+
+// Temporaries from this process never collide, even when two threads store the same entry
+std::atomic<atUint32> tmpCounter(0);
+
+bool endsWith(const std::string& str, const std::string& suffix)
+{
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+}
+
+CDecompressedCache::CDecompressedCache(const std::string& cacheDirectory, atUint64 sizeLimit)
+    : m_cacheDirectory(cacheDirectory),
+      m_sizeLimit(sizeLimit),
+      m_size(0)
+{
+    scan();
+}
+
+bool CDecompressedCache::isCacheable(const SPakResource& resource)
+{
+    return resource.compressed;
+}
+
+std::string CDecompressedCache::entryName(atUint64 hash, atUint32 storedSize) const
+{
+    return Athena::utility::sprintf("%.16" PRIx64 "-%.8x-v%u%s", hash, storedSize, EntryFormat, EntryExtension);
+}
+
+std::string CDecompressedCache::entryPath(const std::string& name) const
+{
+    return m_cacheDirectory + "/" + name;
+}
+
+void CDecompressedCache::scan()
+{
+    DIR* dir = opendir(m_cacheDirectory.c_str());
+    if (!dir)
+        return;
+
+    struct SScanned
+    {
+        std::string name;
+        atUint64    size;
+        atInt64     modified;
+    };
+
+    std::vector<SScanned> found;
+    struct dirent* dp;
+    while ((dp = readdir(dir)) != NULL)
+    {
+        std::string name = dp->d_name;
+        struct stat st;
+        if (stat(entryPath(name).c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+
+        if (endsWith(name, EntryExtension))
+            found.push_back(SScanned{name, (atUint64)st.st_size, (atInt64)st.st_mtime});
+        else if (name.find(std::string(EntryExtension) + ".tmp") != std::string::npos)
+            std::remove(entryPath(name).c_str()); // left behind by a crash
+    }
+    closedir(dir);
+
+    std::sort(found.begin(), found.end(), [](const SScanned& a, const SScanned& b) { return a.modified > b.modified; });
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const SScanned& entry : found)
+    {
+        m_lru.push_back(SEntry{entry.name, entry.size});
+        m_entries[entry.name] = std::prev(m_lru.end());
+        m_size += entry.size;
+    }
+
+    evict();
+}
+
+std::shared_ptr<CMappedFile> CDecompressedCache::find(atUint64 hash, atUint32 storedSize)
+{
+    std::string name = entryName(hash, storedSize);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unordered_map<std::string, std::list<SEntry>::iterator>::iterator entry = m_entries.find(name);
+        if (entry == m_entries.end())
+            return nullptr;
+
+        m_lru.splice(m_lru.begin(), m_lru, entry->second);
+    }
+
+    std::string path = entryPath(name);
+    std::shared_ptr<CMappedFile> ret = std::make_shared<CMappedFile>(path);
+    if (!ret->data())
+    {
+        // Removed behind our back, most likely by another process evicting it
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unordered_map<std::string, std::list<SEntry>::iterator>::iterator entry = m_entries.find(name);
+        if (entry != m_entries.end())
+        {
+            m_size -= entry->second->size;
+            m_lru.erase(entry->second);
+            m_entries.erase(entry);
+        }
+        return nullptr;
+    }
+
+    // Keeps the recency around for the next session
+    utime(path.c_str(), nullptr);
+    return ret;
+}
+
+bool CDecompressedCache::store(atUint64 hash, atUint32 storedSize, const atUint8* data, atUint32 length)
+{
+    if (m_cacheDirectory.empty() || length == 0 || length > m_sizeLimit)
+        return false;
+
+    std::string name = entryName(hash, storedSize);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_entries.find(name) != m_entries.end())
+            return true;
+    }
+
+    // Write to a temporary first so a crash never leaves a truncated entry behind
+    std::string path = entryPath(name);
+    std::string tmpPath = Athena::utility::sprintf("%s.tmp%u", path.c_str(), tmpCounter++);
+    try
+    {
+        Athena::io::FileWriter writer(tmpPath);
+        writer.writeUBytes(data, length);
+    }
+    catch(...)
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_entries.find(name) != m_entries.end())
+    {
+        // Another thread got there first
+        std::remove(tmpPath.c_str());
+        return true;
+    }
+
+    std::remove(path.c_str());
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+
+    m_lru.push_front(SEntry{name, length});
+    m_entries[name] = m_lru.begin();
+    m_size += length;
+    evict();
+    return true;
+}
+
+void CDecompressedCache::evict()
+{
+    // Entries that are mapped at the moment stay valid after they're removed
+    while (m_size > m_sizeLimit && !m_lru.empty())
+    {
+        const SEntry& oldest = m_lru.back();
+        std::remove(entryPath(oldest.name).c_str());
+        m_size -= oldest.size;
+        m_entries.erase(oldest.name);
+        m_lru.pop_back();
+    }
+}
+
+atUint64 CDecompressedCache::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_size;
+}
+
+atUint64 CDecompressedCache::sizeLimit() const
+{
+    return m_sizeLimit;
+}
@@ -0,0 +1,90 @@
+#include "CMappedFile.hpp"
+#include <Athena/FileReader.hpp>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+CMappedFile::CMappedFile(const std::string& path)
+    : m_data(nullptr),
+      m_size(0),
+      m_mapped(false)
+{
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            m_data   = (const atUint8*)mapping;
+            m_size   = st.st_size;
+            m_mapped = true;
+        }
+    }
+    close(fd);
+#else
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER size;
+        HANDLE section = nullptr;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+            section = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+
+        if (section)
+        {
+            void* mapping = MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(section);
+            if (mapping)
+            {
+                m_data   = (const atUint8*)mapping;
+                m_size   = size.QuadPart;
+                m_mapped = true;
+                return;
+            }
+        }
+    }
+
+    // Mapping failed, fall back to reading it into memory
+    try
+    {
+        Athena::io::FileReader reader(path);
+        m_size = reader.length();
+        m_data = reader.readUBytes(m_size);
+    }
+    catch(...)
+    {
+        m_data = nullptr;
+        m_size = 0;
+    }
+#endif
+}
+
+CMappedFile::~CMappedFile()
+{
+#ifndef _WIN32
+    if (m_mapped)
+        munmap((void*)m_data, m_size);
+#else
+    if (m_mapped)
+        UnmapViewOfFile((void*)m_data);
+    else
+        delete[] m_data;
+#endif
+}
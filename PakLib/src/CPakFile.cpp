@@ -1,27 +1,61 @@
 #include "CPakFile.hpp"
 #include "RetroCommon.hpp"
+#include "CDecompressedCache.hpp"
+#include "CWorkerPool.hpp"
+#include "CBoundedQueue.hpp"
 #include <Athena/FileReader.hpp>
+#include <Athena/FileWriter.hpp>
 #include <Athena/MemoryReader.hpp>
 #include <Athena/MemoryWriter.hpp>
 #include <algorithm>
+#include <chrono>
 #include <iomanip>
+#include <map>
+#include <thread>
 #include <cinttypes>
 #include <string.h>
+#include <cctype>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
 
 bool offsetGreater(const SPakResource& left, const SPakResource& right)
 {
     return (left.offset < right.offset);
 }
 
+namespace
+{
+// Batched reads merge neighbouring resources when the hole between them is at most this big
+const atUint64 BatchMergeGap  = 64 * 1024;
+// and stop growing a single read past this
+const atUint64 BatchMaxRead   = 16 * 1024 * 1024;
+// dumpPak hands this much data at a time to loadBatch
+const atUint64 DumpBatchSize  = 32 * 1024 * 1024;
+}
+
 CPakFile::CPakFile(const std::string& filename, atUint32 version)
     : m_filename(filename),
       m_version(version),
-      m_dataStart(0) // MP1 and 2 have absolute addresses
+      m_dataStart(0), // MP1 and 2 have absolute addresses
+      m_hashed(false),
+      m_mapping(nullptr),
+      m_mappingSize(0)
 {
 }
 
 CPakFile::~CPakFile()
 {
+    unmap();
 }
 
 std::string CPakFile::filename() const
@@ -29,25 +63,132 @@ std::string CPakFile::filename() const
     return m_filename;
 }
 
-atUint8* CPakFile::loadData(CUniqueID assetID, const std::string& type)
+bool CPakFile::map()
 {
-    ConstResourceIterator iter = std::find_if(m_resources.begin(), m_resources.end(),
-                                              [&assetID](SPakResource res)->bool{return res.id == assetID; });
+    if (m_mapping)
+        return true;
+
+#ifndef _WIN32
+    int fd = open(m_filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+        return false;
+
+    m_mapping     = (atUint8*)mapping;
+    m_mappingSize = st.st_size;
+    // Lookups jump all over the pak, don't let the kernel read ahead more than it has to
+    madvise(m_mapping, m_mappingSize, MADV_RANDOM);
+    return true;
+#else
+    HANDLE file = CreateFileA(m_filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE section = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // The view keeps its own references to the file and the section
+    CloseHandle(file);
+    if (!section)
+        return false;
+
+    void* mapping = MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(section);
+    if (!mapping)
+        return false;
+
+    m_mapping     = (atUint8*)mapping;
+    m_mappingSize = size.QuadPart;
+    return true;
+#endif
+}
 
-    if (iter == m_resources.end())
+void CPakFile::unmap()
+{
+#ifndef _WIN32
+    if (m_mapping)
+        munmap(m_mapping, m_mappingSize);
+#else
+    if (m_mapping)
+        UnmapViewOfFile(m_mapping);
+#endif
+    m_mapping     = nullptr;
+    m_mappingSize = 0;
+}
+
+bool CPakFile::isMapped() const
+{
+    return m_mapping != nullptr;
+}
+
+const atUint8* CPakFile::rawData(const SPakResource& resource) const
+{
+    if (!m_mapping)
         return nullptr;
 
-    SPakResource resource = *iter;
+    atUint64 start = (atUint64)m_dataStart + resource.offset;
+    if (start + resource.size > m_mappingSize)
+        return nullptr;
 
-    std::string lowTag = resource.tag.toString();
-    std::string lowType = type;
-    Athena::utility::tolower(lowTag);
-    Athena::utility::tolower(lowType);
+    return m_mapping + start;
+}
 
-    if (!type.empty() && lowTag.compare(lowType) != 0)
+const atUint8* CPakFile::resourceView(const CUniqueID& assetID, atUint32& size, const CFourCC& type) const
+{
+    const SPakResource* res = resource(assetID, type);
+
+    // Compressed resources have to be copied out anyway, so only hand out views of data that's usable as is
+    if (res == nullptr || res->compressed)
+        return nullptr;
+
+    const atUint8* ret = rawData(*res);
+    if (ret)
+    {
+        adviseWillNeed(*res);
+        size = res->size;
+    }
+
+    return ret;
+}
+
+atUint8* CPakFile::loadData(const CUniqueID& assetID, const CFourCC& type)
+{
+    const SPakResource* iter = resource(assetID, type);
+
+    if (iter == nullptr)
         return nullptr;
 
+    SPakResource resource = *iter;
+
     atUint8* data = nullptr;
+    const atUint8* view = rawData(resource);
+    if (view)
+    {
+        adviseWillNeed(resource);
+        data = new atUint8[resource.size];
+        memcpy(data, view, resource.size);
+        return data;
+    }
+
     try
     {
         Athena::io::FileReader reader(m_filename);
@@ -64,84 +205,398 @@ atUint8* CPakFile::loadData(CUniqueID assetID, const std::string& type)
     return data;
 }
 
-std::vector<SPakResource> CPakFile::resourcesByType(const std::string& type)
+std::vector<atUint8*> CPakFile::loadBatch(const std::vector<CUniqueID>& assetIDs)
 {
-    std::vector<SPakResource> ret;
-    std::string lowType = type;
-    Athena::utility::tolower(lowType);
-    for (SPakResource& res : m_resources)
+    std::vector<const SPakResource*> resources(assetIDs.size());
+    for (atUint32 i = 0; i < assetIDs.size(); i++)
+        resources[i] = resource(assetIDs[i]);
+
+    return loadBatch(resources);
+}
+
+std::vector<atUint8*> CPakFile::loadBatch(const std::vector<const SPakResource*>& resources)
+{
+    std::vector<atUint8*> ret(resources.size(), nullptr);
+
+    // Visit the requests in file order, so the reads below are (close to) sequential
+    std::vector<atUint32> order;
+    order.reserve(resources.size());
+    for (atUint32 i = 0; i < resources.size(); i++)
+        if (resources[i])
+            order.push_back(i);
+
+    std::sort(order.begin(), order.end(), [&resources](atUint32 l, atUint32 r)->bool{return resources[l]->offset < resources[r]->offset; });
+
+    Athena::io::FileReader* reader = nullptr;
+#ifndef _WIN32
+    int fd = -1;
+    if (!isMapped())
+        fd = open(m_filename.c_str(), O_RDONLY);
+#endif
+
+    atUint32 runStart = 0;
+    while (runStart < order.size())
     {
-        std::string lowTag = res.tag.toString();
-        Athena::utility::tolower(lowTag);
-        if (!lowTag.compare(lowType))
-            ret.push_back(res);
+        // Grow the run while the next resource starts close enough to the end of this one
+        atUint64 start = (atUint64)m_dataStart + resources[order[runStart]]->offset;
+        atUint64 end   = start + resources[order[runStart]]->size;
+        atUint32 runEnd = runStart + 1;
+        while (runEnd < order.size())
+        {
+            const SPakResource* next = resources[order[runEnd]];
+            atUint64 nextStart = (atUint64)m_dataStart + next->offset;
+            atUint64 nextEnd   = nextStart + next->size;
+            if (nextStart > end + BatchMergeGap || std::max(end, nextEnd) - start > BatchMaxRead)
+                break;
+
+            end = std::max(end, nextEnd);
+            runEnd++;
+        }
+
+        const atUint8* run = nullptr;
+        atUint8* runBuffer = nullptr;
+        if (isMapped() && end <= m_mappingSize)
+        {
+#ifndef _WIN32
+            static const atUint64 pageMask = sysconf(_SC_PAGESIZE) - 1;
+            madvise(m_mapping + (start & ~pageMask), (end - (start & ~pageMask)), MADV_WILLNEED);
+#endif
+            run = m_mapping + start;
+        }
+        else
+        {
+            runBuffer = new atUint8[end - start];
+            bool ok = false;
+#ifndef _WIN32
+            if (fd < 0)
+                fd = open(m_filename.c_str(), O_RDONLY);
+
+            atUint64 done = 0;
+            while (fd >= 0 && done < end - start)
+            {
+                ssize_t bytes = pread(fd, runBuffer + done, (end - start) - done, start + done);
+                if (bytes <= 0)
+                    break;
+                done += bytes;
+            }
+            ok = (done == end - start);
+#endif
+            if (!ok)
+            {
+                try
+                {
+                    if (!reader)
+                        reader = new Athena::io::FileReader(m_filename);
+                    reader->seek(start, Athena::SeekOrigin::Begin);
+                    ok = reader->readUBytesToBuf(runBuffer, end - start) == end - start;
+                }
+                catch(const Athena::error::Exception& e)
+                {
+                    std::cout << e.file() << ": " << e.function() << "(" << e.line() << ")" << e.message() << std::endl;
+                }
+            }
+
+            if (ok)
+                run = runBuffer;
+        }
+
+        // Slice the run back up, a failed read leaves its entries as nullptr
+        for (atUint32 i = runStart; run && i < runEnd; i++)
+        {
+            const SPakResource* res = resources[order[i]];
+            atUint8* data = new atUint8[res->size];
+            memcpy(data, run + ((atUint64)m_dataStart + res->offset - start), res->size);
+            ret[order[i]] = data;
+        }
+
+        delete[] runBuffer;
+        runStart = runEnd;
     }
 
+#ifndef _WIN32
+    if (fd >= 0)
+        close(fd);
+#endif
+    delete reader;
+
     return ret;
 }
 
-std::vector<SPakResource> CPakFile::resources() const
+const SPakResource* CPakFile::resource(const CUniqueID& assetID, const CFourCC& type) const
+{
+    atUint32 entry = m_resourceIndex.find(assetID);
+    if (entry == CUniqueIDIndex::InvalidEntry)
+        return nullptr;
+
+    const SPakResource& res = m_resources[entry];
+    // Type lookups are case insensitive
+    if (!type.isEmpty() && type.upper() != res.tag.upper())
+        return nullptr;
+
+    return &res;
+}
+
+CPakResourceSpan CPakFile::resourcesByType(const CFourCC& type) const
+{
+    atUint32 tag = type.upper().toUint32();
+    std::vector<STypePartition>::const_iterator iter = std::lower_bound(m_typePartitions.begin(), m_typePartitions.end(), tag,
+                                                                        [](const STypePartition& p, atUint32 t)->bool{return p.tag < t; });
+
+    if (iter == m_typePartitions.end() || iter->tag != tag)
+        return CPakResourceSpan();
+
+    const SPakResource* start = m_typedResources.data() + iter->start;
+    return CPakResourceSpan(start, start + iter->count);
+}
+
+const std::vector<SPakResource>& CPakFile::resources() const
 {
     return m_resources;
 }
 
 std::string CPakFile::resourceName(const atUint64& assetID)
 {
-    ConstNamedResourceIterator iter = std::find_if(m_namedResources.begin(), m_namedResources.end(),
-                                                   [&assetID](SPakNamedResource res)->bool{return res.id == assetID; });
-    if (iter != m_namedResources.end())
-        return iter->name;
+    return resourceName(CUniqueID(assetID));
+}
+
+std::string CPakFile::resourceName(const CUniqueID& assetID)
+{
+    atUint32 entry = m_namedResourceIndex.find(assetID);
+    if (entry != CUniqueIDIndex::InvalidEntry)
+        return m_namedResources[entry].name;
 
     return std::string();
 }
 
-void CPakFile::dumpPak(const std::string& path, bool decompress)
+void CPakFile::dumpPak(const std::string& path, bool decompress, CDecompressedCache* cache)
 {
-    Athena::io::FileReader reader(m_filename);
-
-    for (atUint32 i = 0; i < m_resources.size(); i++)
+    // Three stages: this thread reads, jobs on the worker pool decompress and a single
+    // writer thread puts the results on disk in pak order
+    atUint32 total = m_resources.size();
+
+    // Jobs may finish out of order, the writer keeps a small window of results around until
+    // the next one in line shows up, the reader never runs further ahead than that. With at
+    // most a window's worth of jobs out finished never fills up, so pool threads don't block on it
+    std::mutex              windowMutex;
+    std::condition_variable windowAdvanced;
+    atUint32                written = 0;
+    atUint32                window = (CWorkerPool::instance().threadCount() + 1) * 8;
+    CBoundedQueue<SDumpJob> finished(window);
+
+    std::thread writer([this, &path, decompress, total, &finished, &windowMutex, &windowAdvanced, &written]()
     {
-        const SPakResource& resource = m_resources[i];
+        std::map<atUint32, SDumpJob> waiting;
+        atUint64 bytesIn = 0;
+        atUint64 bytesOut = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        SDumpJob job;
+        while (written < total && finished.pop(job))
+        {
+            waiting[job.index] = job;
+
+            std::map<atUint32, SDumpJob>::iterator next;
+            while ((next = waiting.find(written)) != waiting.end())
+            {
+                SDumpJob& ready = next->second;
+                const SPakResource& resource = *ready.resource;
+
+                std::string outName;
+                if (decompress)
+                    outName = Athena::utility::sprintf("%s.%s", resource.id.toString().c_str(), resource.tag.toString().c_str());
+                else
+                    outName = Athena::utility::sprintf("%i_%s.%s", resource.compressed, resource.id.toString().c_str(), resource.tag.toString().c_str());
+
+                const atUint8* data = ready.data ? ready.data : ready.view;
+                if (data)
+                {
+                    try
+                    {
+                        Athena::io::FileWriter writer(path + "/" + outName);
+                        writer.writeUBytes(data, ready.length);
+                    }
+                    catch(const Athena::error::Exception& e)
+                    {
+                        std::cout << e.file() << ": " << e.function() << "(" << e.line() << ")" << e.message() << std::endl;
+                    }
+                }
+                else
+                    std::cout << "Unable to read " << outName << std::endl;
+
+                bytesIn  += resource.size;
+                bytesOut += ready.length;
+                delete[] ready.data;
+                waiting.erase(next); // drops the cached mapping too
+
+                {
+                    std::lock_guard<std::mutex> lock(windowMutex);
+                    written++;
+                }
+                windowAdvanced.notify_one();
+
+                if ((written % 256) == 0 || written == m_resources.size())
+                {
+                    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    double rate = seconds > 0.0 ? (bytesIn / (1024.0 * 1024.0)) / seconds : 0.0;
+                    std::cout << "\rDumped " << written << "/" << m_resources.size() << " resources, "
+                              << std::fixed << std::setprecision(1) << (bytesOut / (1024.0 * 1024.0)) << " MiB written, "
+                              << rate << " MiB/s read" << std::flush;
+                }
+            }
+        }
+
+        if (!m_resources.empty())
+            std::cout << std::endl;
+    });
 
-        reader.seek(m_dataStart + resource.offset, Athena::SeekOrigin::Begin);
-        atUint8* data = reader.readUBytes(resource.size);
+    if (isMapped())
+        adviseSequential(true);
 
-        atUint32 len = resource.size;
-        std::string outName;
-        if (decompress)
-            outName = Athena::utility::sprintf("%s.%s", resource.id.toString().c_str(), resource.tag.toString().c_str());
+    atUint32 batchStart = 0;
+    while (batchStart < m_resources.size())
+    {
+        // Gather a batch worth of resources and pull them in with as few reads as possible
+        atUint32 batchEnd = batchStart;
+        atUint64 batchSize = 0;
+        std::vector<const SPakResource*> batch;
+        while (batchEnd < m_resources.size() && (batch.empty() || batchSize < DumpBatchSize))
+        {
+            batch.push_back(&m_resources[batchEnd]);
+            batchSize += m_resources[batchEnd].size;
+            batchEnd++;
+        }
+
+        // With a mapping the workers read straight out of it
+        std::vector<atUint8*> batchData;
+        if (!isMapped())
+            batchData = loadBatch(batch);
         else
-            outName = Athena::utility::sprintf("%i_%s.%s", resource.compressed, resource.id.toString().c_str(), resource.tag.toString().c_str());
+            batchData.resize(batch.size(), nullptr);
 
-        if (decompress && resource.compressed)
+        for (atUint32 i = 0; i < batch.size(); i++)
         {
-            Athena::io::MemoryWriter tmp;
-            decompressFile(tmp, data, len);
-            if (tmp.length() > 0)
+            SDumpJob job;
+            job.index    = batchStart + i;
+            job.resource = batch[i];
+            job.view     = rawData(*batch[i]);
+            job.data     = batchData[i];
+            job.length   = batch[i]->size;
+
             {
-                delete[] data;
-                data = tmp.data();
-                len = tmp.length();
+                std::unique_lock<std::mutex> lock(windowMutex);
+                windowAdvanced.wait(lock, [&]{ return job.index < written + window; });
             }
+
+            CWorkerPool::instance().enqueue([this, job, decompress, cache, &finished]() mutable
+            {
+                try
+                {
+                    processDumpJob(job, decompress, cache);
+                }
+                catch(...)
+                {
+                    // Dumped as stored, the same as when decompressing fails
+                }
+                finished.push(job);
+            });
         }
 
-        std::string outPath = path + "/" + outName;
-        Athena::io::MemoryWriter writer(outPath);
-        writer.writeUBytes(data, len);
-        writer.save();
+        batchStart = batchEnd;
+    }
+
+    writer.join();
 
-        if (!resource.tag.toString().compare("MREA"))
-        {
-            Athena::io::MemoryReader  in(data, len);
-            Athena::io::MemoryWriter out(outPath);
+    if (isMapped())
+        adviseSequential(false);
+}
 
-            if(decompressMREA(in, out))
-                out.save();
+void CPakFile::processDumpJob(SDumpJob& job, bool decompress, CDecompressedCache* cache) const
+{
+    const SPakResource& resource = *job.resource;
+    bool isMREA = resource.tag == "MREA";
+
+    // Nothing to transform, the writer takes it straight out of the mapping
+    if (!isMREA && !(decompress && resource.compressed))
+        return;
+
+    // Decompress straight out of the mapping (or the batch copy), on failure whatever we
+    // started with is dumped as stored
+    const atUint8* src = job.data ? job.data : job.view;
+    if (!src)
+        return;
 
+    // The cache only holds payloads with the pak's compression undone, the same as RetroView puts in it
+    if (decompress && resource.compressed)
+    {
+        // Hashing is far cheaper than decompressing, so don't insist on computeHashes having run
+        atUint64 hash = 0;
+        if (cache)
+        {
+            hash = resource.hash ? resource.hash : contentHash(src, resource.size);
+            job.cached = cache->find(hash, resource.size);
+        }
+
+        if (job.cached)
+        {
+            delete[] job.data;
+            job.data   = nullptr;
+            job.view   = job.cached->data();
+            job.length = job.cached->size();
         }
         else
-            delete[] data;
+        {
+            atUint32 resultLength = 0;
+            atUint8* result = decompressPayload(resource, src, resultLength, false);
+            if (result)
+            {
+                if (cache)
+                    cache->store(hash, resource.size, result, resultLength);
+
+                delete[] job.data;
+                job.data   = result;
+                job.length = resultLength;
+            }
+        }
     }
+
+    // Dumped areas always have their blocks inflated
+    if (isMREA)
+    {
+        atUint32 areaLength = 0;
+        atUint8* area = decompressMREA(job.data ? job.data : job.view, job.length, areaLength);
+        if (area)
+        {
+            delete[] job.data;
+            job.data   = area;
+            job.length = areaLength;
+        }
+    }
+}
+
+atUint8* CPakFile::decompressPayload(const SPakResource& resource, const atUint8* stored, atUint32& length, bool areaBlocks)
+{
+    atUint8* result = nullptr;
+    atUint32 resultLength = 0;
+
+    if (resource.compressed)
+        result = decompressResource(stored, resource.size, resultLength);
+
+    if (areaBlocks && resource.tag == "MREA")
+    {
+        atUint32 areaLength = 0;
+        atUint8* area = result ? decompressMREA(result, resultLength, areaLength)
+                               : decompressMREA(stored, resource.size, areaLength);
+        if (area)
+        {
+            delete[] result;
+            result       = area;
+            resultLength = areaLength;
+        }
+    }
+
+    if (result)
+        length = resultLength;
+    return result;
 }
 
 bool CPakFile::isWorldPak()
@@ -149,17 +604,22 @@ bool CPakFile::isWorldPak()
     return m_isWorldPak;
 }
 
-bool CPakFile::resourceExists(const CUniqueID& assetID)
+bool CPakFile::resourceExists(const CUniqueID& assetID) const
 {
-    std::vector<SPakResource>::iterator iter = std::find_if(m_resources.begin(), m_resources.end(),
-                                                            [&assetID](const SPakResource& res)->bool{return res.id == assetID;});
-
-    return iter != m_resources.end();
+    return m_resourceIndex.find(assetID) != CUniqueIDIndex::InvalidEntry;
 }
 
-bool CPakFile::resourceExists(const SPakResource& resource)
+bool CPakFile::resourceExists(const SPakResource& resource) const
 {
-    return std::find(m_resources.begin(), m_resources.end(), resource) != m_resources.end();
+    atUint32 entry = m_resourceIndex.find(resource.id);
+    if (entry == CUniqueIDIndex::InvalidEntry)
+        return false;
+
+    if (m_resources[entry] == resource)
+        return true;
+
+    // The index only knows the first copy of an ID, any other copies may still match
+    return std::find(m_resources.begin() + entry, m_resources.end(), resource) != m_resources.end();
 }
 
 int CPakFile::version() const
@@ -172,6 +632,144 @@ void CPakFile::removeDuplicates()
     std::sort(m_resources.begin(), m_resources.end());
     m_resources.erase(std::unique(m_resources.begin(), m_resources.end()), m_resources.end());
     std::sort(m_resources.begin(), m_resources.end(), offsetGreater);
+    buildIndex();
+}
+
+void CPakFile::computeHashes()
+{
+    if (hasHashes())
+        return;
+
+    setHashes(contentHashes());
+}
+
+std::vector<atUint64> CPakFile::contentHashes() const
+{
+    std::vector<atUint64> hashes(m_resources.size(), 0);
+    if (isMapped())
+    {
+        adviseSequential(true);
+        CWorkerPool::instance().parallelFor(m_resources.size(), [this, &hashes](atUint32 i)
+        {
+            const SPakResource& res = m_resources[i];
+            const atUint8* data = rawData(res);
+            if (data)
+                hashes[i] = contentHash(data, res.size);
+        });
+        adviseSequential(false);
+    }
+    else
+    {
+        // Resources are sorted by offset, so this reads the pak front to back
+        Athena::io::FileReader reader(m_filename);
+        for (atUint32 i = 0; i < m_resources.size(); i++)
+        {
+            // An entry that runs past the end of the pak keeps hash 0, the same as with a mapping
+            const SPakResource& res = m_resources[i];
+            atUint8* data = nullptr;
+            try
+            {
+                reader.seek(m_dataStart + res.offset, Athena::SeekOrigin::Begin);
+                data = reader.readUBytes(res.size);
+                hashes[i] = contentHash(data, res.size);
+            }
+            catch(const Athena::error::Exception&)
+            {
+            }
+            delete[] data;
+        }
+    }
+
+    return hashes;
+}
+
+void CPakFile::setHashes(const std::vector<atUint64>& hashes)
+{
+    if (hashes.size() != m_resources.size())
+        return;
+
+    for (atUint32 i = 0; i < m_resources.size(); i++)
+        m_resources[i].hash = hashes[i];
+
+    // The typed copies are updated in place rather than rebuilt, so nothing pointing into them dangles
+    for (atUint32 i = 0; i < m_typedResources.size(); i++)
+        m_typedResources[i].hash = m_resources[m_typedOrder[i]].hash;
+
+    m_hashed = true;
+}
+
+bool CPakFile::hasHashes() const
+{
+    // Entries that couldn't be read keep hash 0, so that alone can't tell whether computeHashes ran
+    return m_hashed;
+}
+
+void CPakFile::adviseSequential(bool sequential) const
+{
+#ifndef _WIN32
+    if (m_mapping)
+        madvise(m_mapping, m_mappingSize, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+#else
+    (void)sequential;
+#endif
+}
+
+void CPakFile::adviseWillNeed(const SPakResource& resource) const
+{
+#ifndef _WIN32
+    if (!m_mapping)
+        return;
+
+    // madvise wants a page aligned start
+    static const atUint64 pageMask = sysconf(_SC_PAGESIZE) - 1;
+    atUint64 start = (atUint64)m_dataStart + resource.offset;
+    atUint64 alignedStart = start & ~pageMask;
+    madvise(m_mapping + alignedStart, (start - alignedStart) + resource.size, MADV_WILLNEED);
+#else
+    (void)resource;
+#endif
+}
+
+void CPakFile::buildIndex()
+{
+    m_resourceIndex.clear();
+    m_resourceIndex.reserve(m_resources.size());
+    for (atUint32 i = 0; i < m_resources.size(); i++)
+        m_resourceIndex.insert(m_resources[i].id, i);
+
+    m_namedResourceIndex.clear();
+    m_namedResourceIndex.reserve(m_namedResources.size());
+    for (atUint32 i = 0; i < m_namedResources.size(); i++)
+        m_namedResourceIndex.insert(m_namedResources[i].id, i);
+
+    // Group the resources by tag, the sort is stable so each group stays in table order
+    std::vector<std::pair<atUint32, atUint32>> order(m_resources.size());
+    for (atUint32 i = 0; i < m_resources.size(); i++)
+        order[i] = std::make_pair(m_resources[i].tag.upper().toUint32(), i);
+
+    std::stable_sort(order.begin(), order.end(),
+                     [](const std::pair<atUint32, atUint32>& l, const std::pair<atUint32, atUint32>& r)->bool{return l.first < r.first; });
+
+    m_typedResources.clear();
+    m_typedResources.reserve(order.size());
+    m_typedOrder.clear();
+    m_typedOrder.reserve(order.size());
+    m_typePartitions.clear();
+    for (const std::pair<atUint32, atUint32>& entry : order)
+    {
+        if (m_typePartitions.empty() || m_typePartitions.back().tag != entry.first)
+        {
+            STypePartition partition;
+            partition.tag   = entry.first;
+            partition.start = m_typedResources.size();
+            partition.count = 0;
+            m_typePartitions.push_back(partition);
+        }
+
+        m_typedResources.push_back(m_resources[entry.second]);
+        m_typedOrder.push_back(entry.second);
+        m_typePartitions.back().count++;
+    }
 }
 
 bool operator ==(const SPakNamedResource& left, const SPakNamedResource& right)
@@ -182,9 +780,9 @@ bool operator ==(const SPakNamedResource& left, const SPakNamedResource& right)
 
 bool operator ==(const SPakResource& left, const SPakResource& right)
 {
-    // We only check up to the data size, since resources can be stored multiple times
-    // Eventually we should add a CRC and check that as well....
-    return (left.compressed == right.compressed && left.tag == right.tag && right.id == left.id && left.size == right.size);
+    // Resources can be stored multiple times, so the payload hash is only compared once both sides have one
+    return (left.compressed == right.compressed && left.tag == right.tag && right.id == left.id && left.size == right.size &&
+            (left.hash == 0 || right.hash == 0 || left.hash == right.hash));
 }
 
 bool operator <(const SPakResource& left, const SPakResource& right)
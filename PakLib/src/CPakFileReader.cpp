@@ -70,7 +70,8 @@ CPakFile* CPakFileReader::read()
             }
                 break;
         }
-        ret->m_isWorldPak = ret->resourcesByType("MLVL").size() > 0 && ret->resourcesByType("MREA").size() > 0;
+        ret->buildIndex();
+        ret->m_isWorldPak = !ret->resourcesByType("MLVL").empty() && !ret->resourcesByType("MREA").empty();
     }
     catch(...)
     {
@@ -144,6 +145,7 @@ void CPakFileReader::loadResourceTable(CPakFile* ret)
             ret->m_resources[i].id         = CUniqueID(*this, CUniqueID::E_32Bits);
             ret->m_resources[i].size       = base::readUint32();
             ret->m_resources[i].offset     = base::readUint32();
+            ret->m_resources[i].hash       = 0;
         }
     }
     else
@@ -155,6 +157,7 @@ void CPakFileReader::loadResourceTable(CPakFile* ret)
             ret->m_resources[i].id         = CUniqueID(*this, CUniqueID::E_64Bits);
             ret->m_resources[i].size       = base::readUint32();
             ret->m_resources[i].offset     = base::readUint32();
+            ret->m_resources[i].hash       = 0;
         }
     }
 }
@@ -0,0 +1,524 @@
+#include "CPakFileWriter.hpp"
+#include "RetroCommon.hpp"
+#include "CWorkerPool.hpp"
+#include <Athena/FileWriter.hpp>
+#include <Athena/InvalidDataException.hpp>
+#include <Athena/InvalidOperationException.hpp>
+#include <Athena/Utility.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <memory.h>
+#include <cstdlib>
+#include <mutex>
+#include <zlib.h>
+#include <lzo/lzo1x.h>
+
+namespace
+{
+// save encodes this much source data at a time
+const atUint64 ChunkSize      = 32 * 1024 * 1024;
+// MP3 CMPD payloads are split into blocks of this size so they can be decompressed in parallel
+const atUint32 CMPDBlockSize  = 0x20000;
+// Retro's LZO streams are made of independently compressed segments of at most this size
+const atUint32 LZOSegmentSize = 0x4000;
+// Flag byte found on the compressed length of retail CMPD blocks, the readers mask it off
+const atUint32 CMPDBlockFlag  = 0xA0000000;
+
+atUint64 alignTo(atUint64 v, atUint32 alignment)
+{
+    return (v + (alignment - 1)) & ~(atUint64)(alignment - 1);
+}
+
+void writeBig32(atUint8* dst, atUint32 v)
+{
+    Athena::utility::BigUint32(v);
+    memcpy(dst, &v, 4);
+}
+
+void writeBig16(atUint8* dst, atUint16 v)
+{
+    Athena::utility::BigUint16(v);
+    memcpy(dst, &v, 2);
+}
+
+bool initLZO()
+{
+    static std::once_flag once;
+    static bool ok = false;
+    std::call_once(once, []{ ok = (lzo_init() == LZO_E_OK); });
+    return ok;
+}
+}
+
+CPakFileWriter::CPakFileWriter(atUint32 version, ECompression compression)
+    : m_version(version),
+      m_compression(compression)
+{
+    if (m_version != EPakVersion::MetroidPrime1_2 && m_version != EPakVersion::MetroidPrime3Beta && m_version != EPakVersion::MetroidPrime3)
+        THROW_INVALID_OPERATION_EXCEPTION("Invalid or unsupported version: 0x%.8X", version);
+}
+
+void CPakFileWriter::addPak(CPakFile* pak)
+{
+    for (const SPakNamedResource& name : pak->m_namedResources)
+        addNamedResource(name);
+
+    for (const SPakResource& res : pak->resources())
+        addResource(res, pak);
+}
+
+void CPakFileWriter::addResource(const SPakResource& resource, CPakFile* source)
+{
+    atUint32 idLength = (idBits() == CUniqueID::E_32Bits ? 4 : 8);
+    if (resource.id.idLength() != idLength)
+        THROW_INVALID_OPERATION_EXCEPTION("%s has %i bit IDs, this layout needs %i bit IDs", source->filename().c_str(),
+                                          resource.id.idLength() * 8, idLength * 8);
+
+    for (const SEntry& entry : m_entries)
+    {
+        if (entry.resource.id == resource.id && entry.resource.tag == resource.tag)
+            return;
+    }
+
+    SEntry entry;
+    entry.resource = resource;
+    entry.source   = source;
+    m_entries.push_back(entry);
+}
+
+void CPakFileWriter::addNamedResource(const SPakNamedResource& name)
+{
+    for (const SPakNamedResource& existing : m_namedResources)
+    {
+        if (existing.name == name.name)
+            return;
+    }
+
+    m_namedResources.push_back(name);
+}
+
+void CPakFileWriter::addOrderGroup(const std::vector<CUniqueID>& ids)
+{
+    m_orderGroups.push_back(ids);
+}
+
+bool CPakFileWriter::loadAccessTrace(const std::string& tracePath)
+{
+    std::ifstream trace(tracePath);
+    if (!trace.is_open())
+        return false;
+
+    // One access per line, "TAG ID", only the ID matters here
+    std::vector<CUniqueID> ids;
+    std::string line;
+    while (std::getline(trace, line))
+    {
+        std::istringstream fields(line);
+        std::string tag, id;
+        if (!(fields >> tag >> id))
+            continue;
+
+        atUint64 value = strtoull(id.c_str(), nullptr, 16);
+        if (id.size() <= 8)
+            ids.push_back(CUniqueID((atUint32)value));
+        else
+            ids.push_back(CUniqueID(value));
+    }
+
+    addOrderGroup(ids);
+    return true;
+}
+
+atUint32 CPakFileWriter::version() const
+{
+    return m_version;
+}
+
+bool CPakFileWriter::isMP3() const
+{
+    return m_version == EPakVersion::MetroidPrime3;
+}
+
+bool CPakFileWriter::sameLayout(const CPakFile* source) const
+{
+    return (source->m_version == EPakVersion::MetroidPrime3) == isMP3();
+}
+
+atUint32 CPakFileWriter::alignment() const
+{
+    return isMP3() ? 0x40 : 0x20;
+}
+
+CUniqueID::EIDBits CPakFileWriter::idBits() const
+{
+    return m_version == EPakVersion::MetroidPrime1_2 ? CUniqueID::E_32Bits : CUniqueID::E_64Bits;
+}
+
+std::vector<atUint32> CPakFileWriter::writeOrder() const
+{
+    std::unordered_map<CUniqueID, std::vector<atUint32>, CUniqueIDHash, CUniqueIDComparison> byID;
+    for (atUint32 i = 0; i < m_entries.size(); i++)
+        byID[m_entries[i].resource.id].push_back(i);
+
+    std::vector<atUint32> ret;
+    std::vector<bool> placed(m_entries.size(), false);
+    ret.reserve(m_entries.size());
+
+    // Groups first, in the order they were added, each entry lands where it was first needed
+    for (const std::vector<CUniqueID>& group : m_orderGroups)
+    {
+        for (const CUniqueID& id : group)
+        {
+            auto iter = byID.find(id);
+            if (iter == byID.end())
+                continue;
+
+            for (atUint32 entry : iter->second)
+            {
+                if (!placed[entry])
+                {
+                    placed[entry] = true;
+                    ret.push_back(entry);
+                }
+            }
+        }
+    }
+
+    for (atUint32 i = 0; i < m_entries.size(); i++)
+        if (!placed[i])
+            ret.push_back(i);
+
+    return ret;
+}
+
+atUint8* CPakFileWriter::compressStream(const atUint8* data, atUint32 length, atUint32& outLength) const
+{
+    bool useZlib = (m_compression == ECompression::Zlib) ||
+                   (m_compression == ECompression::Keep && m_version == EPakVersion::MetroidPrime1_2);
+
+    if (useZlib)
+    {
+        uLongf destLength = compressBound(length);
+        atUint8* ret = new atUint8[destLength];
+        if (compress2(ret, &destLength, data, length, Z_BEST_COMPRESSION) != Z_OK)
+        {
+            delete[] ret;
+            return nullptr;
+        }
+
+        outLength = destLength;
+        return ret;
+    }
+
+    if (!initLZO())
+        return nullptr;
+
+    // Each segment is prefixed with its big endian size, negative sizes mark segments stored as is
+    atUint32 segmentCount = (length + LZOSegmentSize - 1) / LZOSegmentSize;
+    atUint8* ret = new atUint8[length + segmentCount * (2 + LZOSegmentSize / 16 + 64 + 3)];
+    atUint8* workMem = new atUint8[LZO1X_999_MEM_COMPRESS];
+    atUint32 out = 0;
+
+    for (atUint32 in = 0; in < length; in += LZOSegmentSize)
+    {
+        atUint32 segmentLength = std::min(LZOSegmentSize, length - in);
+        lzo_uint packedLength = 0;
+        if (lzo1x_999_compress(data + in, segmentLength, ret + out + 2, &packedLength, workMem) != LZO_E_OK ||
+                packedLength >= segmentLength)
+        {
+            writeBig16(ret + out, (atUint16)-(atInt16)segmentLength);
+            memcpy(ret + out + 2, data + in, segmentLength);
+            packedLength = segmentLength;
+        }
+        else
+            writeBig16(ret + out, (atUint16)packedLength);
+
+        out += 2 + packedLength;
+    }
+
+    delete[] workMem;
+    outLength = out;
+    return ret;
+}
+
+CPakFileWriter::SEncoded CPakFileWriter::encode(const SEntry& entry, atUint8* stored) const
+{
+    // stored is the payload as found in the source pak, we own it
+    const SPakResource& res = entry.resource;
+    SEncoded ret;
+    ret.data       = stored;
+    ret.length     = res.size;
+    ret.compressed = res.compressed;
+
+    if (res.compressed && !(m_compression == ECompression::Keep && sameLayout(entry.source)))
+    {
+        atUint32 rawLength = 0;
+        atUint8* raw = decompressResource(stored, res.size, rawLength);
+        delete[] stored;
+        if (!raw)
+            THROW_INVALID_DATA_EXCEPTION("Unable to decompress %s.%s", res.id.toString().c_str(), res.tag.toString().c_str());
+
+        ret.data       = raw;
+        ret.length     = rawLength;
+        ret.compressed = 0;
+
+        if (m_compression != ECompression::None)
+        {
+            atUint8* packed = nullptr;
+            atUint32 packedLength = 0;
+
+            if (isMP3())
+            {
+                atUint32 blockCount = (rawLength + CMPDBlockSize - 1) / CMPDBlockSize;
+                std::vector<atUint8*> blocks(blockCount, nullptr);
+                std::vector<atUint32> blockLengths(blockCount, 0);
+                packedLength = 8 + blockCount * 8;
+                for (atUint32 i = 0; i < blockCount; i++)
+                {
+                    atUint32 blockLength = std::min(CMPDBlockSize, rawLength - i * CMPDBlockSize);
+                    blocks[i] = compressStream(raw + i * CMPDBlockSize, blockLength, blockLengths[i]);
+                    // Blocks that don't shrink are stored, the readers copy those as is
+                    if (!blocks[i] || blockLengths[i] >= blockLength)
+                    {
+                        delete[] blocks[i];
+                        blocks[i] = nullptr;
+                        blockLengths[i] = blockLength;
+                    }
+                    packedLength += blockLengths[i];
+                }
+
+                packed = new atUint8[packedLength];
+                memcpy(packed, "CMPD", 4);
+                writeBig32(packed + 4, blockCount);
+                atUint32 offset = 8 + blockCount * 8;
+                for (atUint32 i = 0; i < blockCount; i++)
+                {
+                    atUint32 blockLength = std::min(CMPDBlockSize, rawLength - i * CMPDBlockSize);
+                    writeBig32(packed + 8 + i * 8, (blocks[i] ? CMPDBlockFlag : 0) | blockLengths[i]);
+                    writeBig32(packed + 12 + i * 8, blockLength);
+                    memcpy(packed + offset, blocks[i] ? blocks[i] : raw + i * CMPDBlockSize, blockLengths[i]);
+                    offset += blockLengths[i];
+                    delete[] blocks[i];
+                }
+            }
+            else
+            {
+                atUint32 streamLength = 0;
+                atUint8* stream = compressStream(raw, rawLength, streamLength);
+                if (stream)
+                {
+                    packedLength = 4 + streamLength;
+                    packed = new atUint8[packedLength];
+                    writeBig32(packed, rawLength);
+                    memcpy(packed + 4, stream, streamLength);
+                    delete[] stream;
+                }
+            }
+
+            // Not worth it if it doesn't get any smaller
+            if (packed && packedLength < rawLength)
+            {
+                delete[] raw;
+                ret.data       = packed;
+                ret.length     = packedLength;
+                ret.compressed = 1;
+            }
+            else
+                delete[] packed;
+        }
+    }
+
+    // Every resource starts aligned, retail paks count the padding as part of the size
+    atUint32 padded = alignTo(ret.length, alignment());
+    if (padded != ret.length)
+    {
+        atUint8* tmp = new atUint8[padded];
+        memcpy(tmp, ret.data, ret.length);
+        memset(tmp + ret.length, 0, padded - ret.length);
+        delete[] ret.data;
+        ret.data   = tmp;
+        ret.length = padded;
+    }
+
+    return ret;
+}
+
+void CPakFileWriter::save(const std::string& filename)
+{
+    std::vector<atUint32> order = writeOrder();
+    atUint32 idLength = (idBits() == CUniqueID::E_32Bits ? 4 : 8);
+
+    Athena::io::FileWriter writer(filename);
+    writer.setEndian(Athena::Endian::BigEndian);
+
+    // Tables go first, the resource table is rewritten once the data offsets are known
+    atUint64 tableStart = 0;
+    atUint64 sectionTableStart = 0;
+    atUint64 stringsSize = 0;
+    atUint64 resourcesSize = 0;
+    if (isMP3())
+    {
+        writer.writeUint32(m_version);
+        writer.writeUint32(0x40); // header size
+        writer.fill(0, 16);       // MD5 of the pak, left empty
+        writer.fill(0, 0x40 - writer.position());
+
+        sectionTableStart = writer.position();
+        writer.fill(0, alignTo(4 + 3 * 8, 0x40));
+
+        atUint64 stringsStart = writer.position();
+        writer.writeUint32(m_namedResources.size());
+        for (const SPakNamedResource& name : m_namedResources)
+        {
+            writer.writeUBytes((const atUint8*)name.name.c_str(), name.name.size() + 1);
+            writer.writeUBytes((const atUint8*)name.tag.toString().c_str(), 4);
+            writer.writeUBytes(name.id.raw(), idLength);
+        }
+        writer.fill(0, alignTo(writer.position(), 0x40) - writer.position());
+        stringsSize = writer.position() - stringsStart;
+
+        writer.writeUint32(m_entries.size());
+        tableStart = writer.position();
+        writer.fill(0, m_entries.size() * (16 + idLength));
+        writer.fill(0, alignTo(writer.position(), 0x40) - writer.position());
+        resourcesSize = writer.position() - stringsStart - stringsSize;
+    }
+    else
+    {
+        writer.writeUint32(EPakVersion::MetroidPrime1_2);
+        writer.writeUint32(0);
+
+        writer.writeUint32(m_namedResources.size());
+        for (const SPakNamedResource& name : m_namedResources)
+        {
+            writer.writeUBytes((const atUint8*)name.tag.toString().c_str(), 4);
+            writer.writeUBytes(name.id.raw(), idLength);
+            writer.writeUint32(name.name.size());
+            writer.writeUBytes((const atUint8*)name.name.c_str(), name.name.size());
+        }
+
+        writer.writeUint32(m_entries.size());
+        tableStart = writer.position();
+        writer.fill(0, m_entries.size() * (16 + idLength));
+        writer.fill(0, alignTo(writer.position(), 0x20) - writer.position());
+    }
+
+    // MP3 offsets are relative to the DATA section, MP1/2 ones are absolute
+    atUint64 dataStart = writer.position();
+    atUint64 offsetBase = isMP3() ? dataStart : 0;
+
+    std::vector<SPakResource> written(m_entries.size());
+    std::unordered_map<atUint64, atUint32> writtenHashes; // content hash -> entry that carries the data
+
+    atUint32 chunkStart = 0;
+    while (chunkStart < order.size())
+    {
+        atUint32 chunkEnd = chunkStart;
+        atUint64 chunkSize = 0;
+        while (chunkEnd < order.size() && (chunkEnd == chunkStart || chunkSize < ChunkSize))
+            chunkSize += m_entries[order[chunkEnd++]].resource.size;
+
+        // Pull the chunk in with one batch per source pak
+        std::vector<atUint8*> stored(chunkEnd - chunkStart, nullptr);
+        std::vector<CPakFile*> sources;
+        for (atUint32 i = chunkStart; i < chunkEnd; i++)
+            if (std::find(sources.begin(), sources.end(), m_entries[order[i]].source) == sources.end())
+                sources.push_back(m_entries[order[i]].source);
+
+        for (CPakFile* source : sources)
+        {
+            std::vector<atUint32> slots;
+            std::vector<const SPakResource*> batch;
+            for (atUint32 i = chunkStart; i < chunkEnd; i++)
+            {
+                const SEntry& entry = m_entries[order[i]];
+                if (entry.source != source)
+                    continue;
+                if (entry.resource.hash != 0 && writtenHashes.find(entry.resource.hash) != writtenHashes.end())
+                    continue;
+
+                slots.push_back(i - chunkStart);
+                batch.push_back(&entry.resource);
+            }
+
+            std::vector<atUint8*> data = source->loadBatch(batch);
+            for (atUint32 i = 0; i < slots.size(); i++)
+                stored[slots[i]] = data[i];
+        }
+
+        std::vector<SEncoded> encoded(chunkEnd - chunkStart, SEncoded{nullptr, 0, 0});
+        CWorkerPool::instance().parallelFor(chunkEnd - chunkStart, [&](atUint32 i)
+        {
+            if (stored[i])
+                encoded[i] = encode(m_entries[order[chunkStart + i]], stored[i]);
+        });
+
+        for (atUint32 i = chunkStart; i < chunkEnd; i++)
+        {
+            const SEntry& entry = m_entries[order[i]];
+            SEncoded& enc = encoded[i - chunkStart];
+            SPakResource& out = written[order[i]];
+            out = entry.resource;
+
+            std::unordered_map<atUint64, atUint32>::iterator shared = writtenHashes.end();
+            if (entry.resource.hash != 0)
+                shared = writtenHashes.find(entry.resource.hash);
+
+            if (shared != writtenHashes.end())
+            {
+                // Same payload as something already written, point at that copy
+                delete[] enc.data;
+                const SPakResource& original = written[shared->second];
+                out.offset     = original.offset;
+                out.size       = original.size;
+                out.compressed = original.compressed;
+                continue;
+            }
+
+            if (!enc.data)
+                THROW_INVALID_DATA_EXCEPTION("Unable to read %s.%s from %s", entry.resource.id.toString().c_str(),
+                                             entry.resource.tag.toString().c_str(), entry.source->filename().c_str());
+
+            out.offset     = writer.position() - offsetBase;
+            out.size       = enc.length;
+            out.compressed = enc.compressed;
+            writer.writeUBytes(enc.data, enc.length);
+            delete[] enc.data;
+
+            if (entry.resource.hash != 0)
+                writtenHashes[entry.resource.hash] = order[i];
+        }
+
+        chunkStart = chunkEnd;
+    }
+
+    atUint64 dataSize = writer.position() - dataStart;
+
+    // Now that the offsets are known fill in the tables, entries stay in the order they were added
+    writer.seek(tableStart, Athena::SeekOrigin::Begin);
+    for (const SPakResource& res : written)
+    {
+        writer.writeUint32(res.compressed);
+        writer.writeUBytes((const atUint8*)res.tag.toString().c_str(), 4);
+        writer.writeUBytes(res.id.raw(), idLength);
+        writer.writeUint32(res.size);
+        writer.writeUint32(res.offset);
+    }
+
+    if (isMP3())
+    {
+        writer.seek(sectionTableStart, Athena::SeekOrigin::Begin);
+        writer.writeUint32(3);
+        writer.writeUint32((atUint32)EPAKSection::STRG);
+        writer.writeUint32(stringsSize);
+        writer.writeUint32((atUint32)EPAKSection::RSHD);
+        writer.writeUint32(resourcesSize);
+        writer.writeUint32((atUint32)EPAKSection::DATA);
+        writer.writeUint32(dataSize);
+    }
+
+    writer.close();
+}
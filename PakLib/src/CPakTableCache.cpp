@@ -0,0 +1,203 @@
+#include "CPakTableCache.hpp"
+#include "CPakFile.hpp"
+#include "CMappedFile.hpp"
+#include <Athena/FileWriter.hpp>
+#include <cinttypes>
+#include <cstdio>
+#include <memory.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace
+{
+const atUint32 CacheMagic   = 0x50544F43; // PTOC
+const atUint32 CacheVersion = 4;
+
+// Everything is in native byte order, the cache never leaves the machine that wrote it
+struct STableCacheHeader
+{
+    atUint32 magic;
+    atUint32 cacheVersion;
+    atUint32 resourceRecordSize; // sizeof(SPakResource), guards against layout changes
+    atUint32 nameRecordSize;
+    atUint64 pakSize;
+    atInt64  pakModified;
+    atUint32 pakVersion;
+    atUint32 dataStart;
+    atUint32 tableStart;
+    atUint32 isWorldPak;
+    atUint32 hashed;
+    atUint32 resourceCount;
+    atUint32 namedResourceCount;
+    atUint32 pathLength;
+    atUint32 stringsLength;
+    // followed by the pak path, SPakResource[resourceCount], SNamedRecord[namedResourceCount]
+    // and finally the name strings, each section aligned to 8 bytes
+};
+
+struct SNamedRecord
+{
+    CFourCC   tag;
+    CUniqueID id;
+    atUint32  nameOffset;
+    atUint32  nameLength;
+};
+
+atUint64 align8(atUint64 v)
+{
+    return (v + 7) & ~7;
+}
+
+bool statPak(const std::string& pakPath, atUint64& size, atInt64& modified)
+{
+    struct stat st;
+    if (stat(pakPath.c_str(), &st) != 0)
+        return false;
+
+    size     = st.st_size;
+    modified = st.st_mtime;
+    return true;
+}
+
+// FNV-1a, only used to give each pak a unique entry name
+atUint64 hashPath(const std::string& path)
+{
+    atUint64 hash = 0xCBF29CE484222325ULL;
+    for (char c : path)
+    {
+        hash ^= (atUint8)c;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+}
+
+CPakTableCache::CPakTableCache(const std::string& cacheDirectory)
+    : m_cacheDirectory(cacheDirectory)
+{
+}
+
+std::string CPakTableCache::entryPath(const std::string& pakPath) const
+{
+    std::string name = pakPath.substr(pakPath.find_last_of("/\\") + 1);
+    return Athena::utility::sprintf("%s/%s-%.16" PRIx64 ".toc", m_cacheDirectory.c_str(), name.c_str(), hashPath(pakPath));
+}
+
+CPakFile* CPakTableCache::load(const std::string& pakPath) const
+{
+    atUint64 pakSize;
+    atInt64  pakModified;
+    if (m_cacheDirectory.empty() || !statPak(pakPath, pakSize, pakModified))
+        return nullptr;
+
+    CMappedFile view(entryPath(pakPath));
+    if (view.data() == nullptr || view.size() < sizeof(STableCacheHeader))
+        return nullptr;
+
+    STableCacheHeader header;
+    memcpy(&header, view.data(), sizeof(STableCacheHeader));
+
+    if (header.magic != CacheMagic || header.cacheVersion != CacheVersion ||
+            header.resourceRecordSize != sizeof(SPakResource) || header.nameRecordSize != sizeof(SNamedRecord) ||
+            header.pakSize != pakSize || header.pakModified != pakModified)
+        return nullptr;
+
+    atUint64 pathStart      = sizeof(STableCacheHeader);
+    atUint64 resourcesStart = align8(pathStart + header.pathLength);
+    atUint64 namesStart     = align8(resourcesStart + (atUint64)header.resourceCount * sizeof(SPakResource));
+    atUint64 stringsStart   = align8(namesStart + (atUint64)header.namedResourceCount * sizeof(SNamedRecord));
+    if (stringsStart + header.stringsLength > view.size())
+        return nullptr;
+
+    // Two different paths can share an entry name if the hash collides
+    if (pakPath.compare(0, std::string::npos, (const char*)view.data() + pathStart, header.pathLength) != 0)
+        return nullptr;
+
+    CPakFile* ret = new CPakFile(pakPath, header.pakVersion);
+    ret->m_dataStart  = header.dataStart;
+    ret->m_tableStart = header.tableStart;
+    ret->m_isWorldPak = header.isWorldPak != 0;
+    ret->m_hashed     = header.hashed != 0;
+
+    const SPakResource* resources = (const SPakResource*)(view.data() + resourcesStart);
+    ret->m_resources.assign(resources, resources + header.resourceCount);
+
+    const SNamedRecord* names   = (const SNamedRecord*)(view.data() + namesStart);
+    const char*         strings = (const char*)(view.data() + stringsStart);
+    ret->m_namedResources.resize(header.namedResourceCount);
+    for (atUint32 i = 0; i < header.namedResourceCount; i++)
+    {
+        if ((atUint64)names[i].nameOffset + names[i].nameLength > header.stringsLength)
+        {
+            delete ret;
+            return nullptr;
+        }
+
+        ret->m_namedResources[i].tag  = names[i].tag;
+        ret->m_namedResources[i].id   = names[i].id;
+        ret->m_namedResources[i].name = std::string(strings + names[i].nameOffset, names[i].nameLength);
+    }
+
+    ret->buildIndex();
+    return ret;
+}
+
+bool CPakTableCache::save(const CPakFile* pak) const
+{
+    STableCacheHeader header;
+    memset(&header, 0, sizeof(STableCacheHeader));
+
+    if (m_cacheDirectory.empty() || !statPak(pak->m_filename, header.pakSize, header.pakModified))
+        return false;
+
+    std::vector<SNamedRecord> names(pak->m_namedResources.size());
+    std::string strings;
+    for (atUint32 i = 0; i < names.size(); i++)
+    {
+        const SPakNamedResource& res = pak->m_namedResources[i];
+        names[i].tag        = res.tag;
+        names[i].id         = res.id;
+        names[i].nameOffset = strings.size();
+        names[i].nameLength = res.name.size();
+        strings += res.name;
+    }
+
+    header.magic              = CacheMagic;
+    header.cacheVersion       = CacheVersion;
+    header.resourceRecordSize = sizeof(SPakResource);
+    header.nameRecordSize     = sizeof(SNamedRecord);
+    header.pakVersion         = pak->m_version;
+    header.dataStart          = pak->m_dataStart;
+    header.tableStart         = pak->m_tableStart;
+    header.isWorldPak         = pak->m_isWorldPak;
+    header.hashed             = pak->m_hashed;
+    header.resourceCount      = pak->m_resources.size();
+    header.namedResourceCount = names.size();
+    header.pathLength         = pak->m_filename.size();
+    header.stringsLength      = strings.size();
+
+    // Write to a temporary first so a crash never leaves a truncated entry behind
+    std::string path = entryPath(pak->m_filename);
+    std::string tmpPath = path + ".tmp";
+    try
+    {
+        static const atUint8 padding[8] = {0};
+        Athena::io::FileWriter writer(tmpPath);
+        writer.writeUBytes((const atUint8*)&header, sizeof(STableCacheHeader));
+        writer.writeUBytes((const atUint8*)pak->m_filename.data(), header.pathLength);
+        writer.writeUBytes(padding, align8(writer.position()) - writer.position());
+        writer.writeUBytes((const atUint8*)pak->m_resources.data(), pak->m_resources.size() * sizeof(SPakResource));
+        writer.writeUBytes(padding, align8(writer.position()) - writer.position());
+        writer.writeUBytes((const atUint8*)names.data(), names.size() * sizeof(SNamedRecord));
+        writer.writeUBytes(padding, align8(writer.position()) - writer.position());
+        writer.writeUBytes((const atUint8*)strings.data(), strings.size());
+    }
+    catch(...)
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+
+    std::remove(path.c_str());
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
@@ -3,25 +3,19 @@
 
 const CUniqueID CUniqueID::InvalidAsset;
 
-CUniqueID::CUniqueID()
-    : m_idLen(E_Invalid)
-{
-    memset(m_idVal, 0xFF, 16);
-}
-
 CUniqueID::CUniqueID(Athena::io::IStreamReader& input, CUniqueID::EIDBits idLength)
     : m_idLen(idLength)
 {
     atUint32 bytes = this->idLength();
     if (idLength != E_Invalid && bytes > 0)
     {
-        memset(m_idVal, 0, 16);
-        input.readUBytesToBuf(m_idVal, bytes);
+        memset(m_words, 0, 16);
+        input.readUBytesToBuf(m_words, bytes);
     }
     else
     {
         m_idLen = E_Invalid; // just to make sure
-        memset(m_idVal, 0xFF, 16);
+        memset(m_words, 0xFF, 16);
     }
 }
 
@@ -31,13 +25,13 @@ CUniqueID::CUniqueID(const atUint8* assetID, CUniqueID::EIDBits idLength)
     atUint32 bytes = this->idLength();
     if (idLength != E_Invalid && bytes > 0)
     {
-        memset(m_idVal, 0, 16);
-        memcpy(m_idVal, assetID, bytes);
+        memset(m_words, 0, 16);
+        memcpy(m_words, assetID, bytes);
     }
     else
     {
         m_idLen = E_Invalid; // just to make sure
-        memset(m_idVal, 0xFF, 16);
+        memset(m_words, 0xFF, 16);
     }
 }
 
@@ -51,13 +45,10 @@ CUniqueID::CUniqueID(const atUint64& assetID)
     fromUint64(assetID);
 }
 
-CUniqueID::~CUniqueID()
-{
-}
-
 atUint32 CUniqueID::toUint32() const
 {
-    atUint32 id = *(atUint32*)(m_idVal);
+    atUint32 id;
+    memcpy(&id, m_words, 4);
     Athena::utility::BigUint32(id);
 
     return id;
@@ -65,7 +56,7 @@ atUint32 CUniqueID::toUint32() const
 
 atUint64 CUniqueID::toUint64() const
 {
-    atUint64 id = *(atUint64*)(m_idVal);
+    atUint64 id = m_words[0];
     Athena::utility::BigUint64(id);
 
     return id;
@@ -85,15 +76,15 @@ atUint32 CUniqueID::idLength() const
 
 atUint8* CUniqueID::raw() const
 {
-    return (atUint8*)m_idVal;
+    return (atUint8*)m_words;
 }
 
 void CUniqueID::fromUint32(const atUint32& other)
 {
     atUint32 tmp = other;
     Athena::utility::BigUint32(tmp);
-    memset(m_idVal, 0, 16);
-    memcpy(m_idVal, &tmp, 4);
+    memset(m_words, 0, 16);
+    memcpy(m_words, &tmp, 4);
     m_idLen = E_32Bits;
 }
 
@@ -107,8 +98,8 @@ void CUniqueID::fromUint64(const atUint64& other)
 {
     atUint64 tmp = other;
     Athena::utility::BigUint64(tmp);
-    memset(m_idVal, 0, 16);
-    memcpy(m_idVal, &tmp, 8);
+    memset(m_words, 0, 16);
+    memcpy(m_words, &tmp, 8);
     m_idLen = E_64Bits;
 }
 
@@ -121,10 +112,16 @@ CUniqueID& CUniqueID::operator=(atUint64 other)
 
 std::string CUniqueID::toString() const
 {
-    std::string ret = "";
+    static const char digits[] = "0123456789abcdef";
+    const atUint8* bytes = raw();
     atUint32 idLen = idLength();
+
+    std::string ret(idLen * 2, '0');
     for (atUint32 i = 0; i < idLen; i++)
-        ret += Athena::utility::sprintf("%2.2x", m_idVal[i]);
+    {
+        ret[i * 2]     = digits[bytes[i] >> 4];
+        ret[i * 2 + 1] = digits[bytes[i] & 0xF];
+    }
     return ret;
 }
 
@@ -147,13 +144,3 @@ bool CUniqueID::operator!=(atUint64 right) const
 {
     return (toUint64() != right);
 }
-
-bool CUniqueID::operator==(const CUniqueID& right) const
-{
-    return !memcmp(m_idVal, right.m_idVal, 16);
-}
-
-bool CUniqueID::operator!=(const CUniqueID& right) const
-{
-    return memcmp(m_idVal, right.m_idVal, 16) != 0;
-}
@@ -0,0 +1,86 @@
+#include "CUniqueIDIndex.hpp"
+#include <memory.h>
+
+const atUint32 CUniqueIDIndex::InvalidEntry;
+
+CUniqueIDIndex::CUniqueIDIndex()
+    : m_mask(0),
+      m_count(0)
+{
+}
+
+void CUniqueIDIndex::reserve(atUint32 count)
+{
+    // Keep the load factor at or below 0.5, probes stay short even with clustered IDs
+    atUint32 capacity = 16;
+    while (capacity < count * 2)
+        capacity <<= 1;
+
+    if (capacity > m_slots.size())
+        rehash(capacity);
+}
+
+void CUniqueIDIndex::clear()
+{
+    m_slots.clear();
+    m_mask  = 0;
+    m_count = 0;
+}
+
+bool CUniqueIDIndex::insert(const CUniqueID& id, atUint32 entry)
+{
+    if ((m_count + 1) * 2 > m_slots.size())
+        rehash(m_slots.empty() ? 16 : (atUint32)m_slots.size() * 2);
+
+    atUint32 slot = (atUint32)id.hash() & m_mask;
+    while (m_slots[slot].entry != InvalidEntry)
+    {
+        if (m_slots[slot].id == id)
+            return false;
+        slot = (slot + 1) & m_mask;
+    }
+
+    m_slots[slot].id    = id;
+    m_slots[slot].entry = entry;
+    m_count++;
+    return true;
+}
+
+atUint32 CUniqueIDIndex::find(const CUniqueID& id) const
+{
+    if (m_count == 0)
+        return InvalidEntry;
+
+    atUint32 slot = (atUint32)id.hash() & m_mask;
+    while (m_slots[slot].entry != InvalidEntry)
+    {
+        if (m_slots[slot].id == id)
+            return m_slots[slot].entry;
+        slot = (slot + 1) & m_mask;
+    }
+
+    return InvalidEntry;
+}
+
+atUint32 CUniqueIDIndex::size() const
+{
+    return m_count;
+}
+
+void CUniqueIDIndex::rehash(atUint32 capacity)
+{
+    std::vector<SSlot> oldSlots;
+    oldSlots.swap(m_slots);
+
+    SSlot empty;
+    empty.entry = InvalidEntry;
+    m_slots.assign(capacity, empty);
+    m_mask  = capacity - 1;
+    m_count = 0;
+
+    for (const SSlot& slot : oldSlots)
+    {
+        if (slot.entry != InvalidEntry)
+            insert(slot.id, slot.entry);
+    }
+}
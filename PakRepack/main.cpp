@@ -0,0 +1,110 @@
+#include <iostream>
+#include <CPakFile.hpp>
+#include <CPakFileReader.hpp>
+#include <CPakFileWriter.hpp>
+#include <Athena/InvalidDataException.hpp>
+
+void usage(const std::string& progName)
+{
+    printf("Usage: %s [options] <out.pak> <in.pak> [in.pak...]\n", progName.c_str());
+    printf("  -v <mp1|mp3>               layout to write, defaults to the layout of the first input\n");
+    printf("  -c <keep|none|zlib|lzo>    how to compress resources that were compressed in their source pak\n");
+    printf("  -t <trace>                 order resources by an access trace recorded with RETROVIEW_ACCESS_TRACE,\n");
+    printf("                             can be given more than once\n");
+}
+
+int main(int argc, char* argv[])
+{
+    std::string progName = argv[0];
+    progName = progName.substr(progName.find_last_of("/\\") + 1);
+
+    std::string versionName;
+    std::string compressionName = "keep";
+    std::vector<std::string> traces;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if ((arg == "-v" || arg == "-c" || arg == "-t") && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (arg == "-v")
+                versionName = value;
+            else if (arg == "-c")
+                compressionName = value;
+            else
+                traces.push_back(value);
+        }
+        else if (arg[0] == '-')
+        {
+            usage(progName);
+            return 1;
+        }
+        else
+            files.push_back(arg);
+    }
+
+    if (files.size() < 2)
+    {
+        usage(progName);
+        return 1;
+    }
+
+    CPakFileWriter::ECompression compression;
+    if (compressionName == "keep")
+        compression = CPakFileWriter::ECompression::Keep;
+    else if (compressionName == "none")
+        compression = CPakFileWriter::ECompression::None;
+    else if (compressionName == "zlib")
+        compression = CPakFileWriter::ECompression::Zlib;
+    else if (compressionName == "lzo")
+        compression = CPakFileWriter::ECompression::LZO;
+    else
+    {
+        usage(progName);
+        return 1;
+    }
+
+    std::vector<CPakFile*> paks;
+    int ret = 0;
+    try
+    {
+        for (size_t i = 1; i < files.size(); i++)
+        {
+            CPakFile* pak = CPakFileReader::load(files[i]);
+            pak->map();
+            pak->removeDuplicates();
+            pak->computeHashes();
+            paks.push_back(pak);
+        }
+
+        atUint32 version = paks[0]->version();
+        if (versionName == "mp1")
+            version = (version == EPakVersion::MetroidPrime3 ? (atUint32)EPakVersion::MetroidPrime3Beta : (atUint32)version);
+        else if (versionName == "mp3")
+            version = EPakVersion::MetroidPrime3;
+
+        CPakFileWriter writer(version, compression);
+        for (const std::string& trace : traces)
+        {
+            if (!writer.loadAccessTrace(trace))
+                std::cout << "Unable to open trace " << trace << std::endl;
+        }
+
+        for (CPakFile* pak : paks)
+            writer.addPak(pak);
+
+        std::cout << "writing " << files[0] << std::endl;
+        writer.save(files[0]);
+    }
+    catch(const Athena::error::Exception& e)
+    {
+        std::cout << e.file() << ": " << e.function() << "(" << e.line() << ")" << e.message() << std::endl;
+        ret = 1;
+    }
+
+    for (CPakFile* pak : paks)
+        delete pak;
+
+    return ret;
+}
@@ -2,9 +2,32 @@ INCLUDEPATH += $$PWD/include
 
 include(../libSquish/libSquish.pri)
 
+unix:LIBS += -lpthread -lz
+
+# Optional libdeflate inflate backend, qmake CONFIG+=libdeflate
+libdeflate {
+    DEFINES += RETRO_HAVE_LIBDEFLATE
+    win32:INCLUDEPATH += $$PWD/../External/libdeflate/include
+    win32:LIBS += -L$$PWD/../External/libdeflate/lib
+    LIBS += -ldeflate
+}
+
 HEADERS += \
-    $$PWD/include/RetroCommon.hpp
+    $$PWD/include/RetroCommon.hpp \
+    $$PWD/include/CWorkerPool.hpp \
+    $$PWD/include/CBoundedQueue.hpp \
+    $$PWD/include/CInflateBackend.hpp \
+    $$PWD/include/CCompressedMemoryCache.hpp \
+    $$PWD/include/CLazyMREA.hpp \
+    $$PWD/include/CCMPDReader.hpp
 
 SOURCES += \
     $$PWD/src/RetroCommon.cpp \
-    $$PWD/src/MREADecompress.cpp
+    $$PWD/src/MREADecompress.cpp \
+    $$PWD/src/LZODecompress.cpp \
+    $$PWD/src/LZ4.cpp \
+    $$PWD/src/ContentHash.cpp \
+    $$PWD/src/CWorkerPool.cpp \
+    $$PWD/src/CInflateBackend.cpp \
+    $$PWD/src/CCompressedMemoryCache.cpp \
+    $$PWD/src/CCMPDReader.cpp
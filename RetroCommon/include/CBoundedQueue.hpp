@@ -0,0 +1,71 @@
+#ifndef CBOUNDEDQUEUE_HPP
+#define CBOUNDEDQUEUE_HPP
+
+#include <Athena/Types.hpp>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/*!
+ * \brief Fixed capacity FIFO used to connect the stages of a pipeline.
+ *
+ * push blocks while the queue is full, pop blocks while it is empty. Once close
+ * has been called pop drains whatever is left and then returns false.
+ */
+template <typename T>
+class CBoundedQueue final
+{
+public:
+    explicit CBoundedQueue(atUint32 capacity)
+        : m_capacity(capacity > 0 ? capacity : 1),
+          m_closed(false)
+    {
+    }
+
+    // Returns false if the queue was closed before there was room for value
+    bool push(T value)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this]{ return m_closed || m_items.size() < m_capacity; });
+        if (m_closed)
+            return false;
+
+        m_items.push_back(std::move(value));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(T& value)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this]{ return m_closed || !m_items.empty(); });
+        if (m_items.empty())
+            return false;
+
+        value = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+private:
+    CBoundedQueue(const CBoundedQueue&) = delete;
+    CBoundedQueue& operator=(const CBoundedQueue&) = delete;
+
+    std::deque<T>           m_items;
+    atUint32                m_capacity;
+    bool                    m_closed;
+    std::mutex              m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+};
+
+#endif // CBOUNDEDQUEUE_HPP
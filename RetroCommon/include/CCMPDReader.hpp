@@ -0,0 +1,71 @@
+#ifndef CCMPDREADER_HPP
+#define CCMPDREADER_HPP
+
+#include <Athena/IStreamReader.hpp>
+#include <memory>
+#include <vector>
+
+/*!
+ * \brief Reads a compressed resource as if it were decompressed, without decompressing all of it.
+ *
+ * CMPD blocks are decompressed the first time a read touches them and the most recently
+ * used few are kept around, so memory stays bounded by the cache no matter how large the
+ * resource is, and parsing starts as soon as the first block is in. Stored blocks are read
+ * straight out of the source.
+ * Size prefixed (MP1/MP2) resources are a single block, so for those the bound is the whole
+ * decompressed size. A block (CMPD or not) decompressing to more than MaxSingleBlockLength, or
+ * to more than MaxCompressionRatio times its compressed length, makes the reader invalid.
+ * Throws Athena::error::InvalidDataException when a read hits a damaged block.
+ */
+class CCMPDReader final : public Athena::io::IStreamReader
+{
+public:
+    static const atUint32 DefaultCachedBlocks = 4;
+    static const atUint32 MaxSingleBlockLength = 256 * 1024 * 1024;
+    // zlib can't do better than this, LZO does worse
+    static const atUint32 MaxCompressionRatio  = 1032;
+
+    // data has to outlive the reader
+    CCMPDReader(const atUint8* data, atUint32 length, atUint32 cachedBlocks = DefaultCachedBlocks);
+
+    // False if the resource's header is damaged, nothing can be read then
+    bool isValid() const;
+
+    void seek(atInt64 position, Athena::SeekOrigin origin = Athena::SeekOrigin::Current);
+    atUint64 position() const;
+    atUint64 length() const;
+    atUint64 readUBytesToBuf(void* buf, atUint64 length);
+
+private:
+    struct SBlock
+    {
+        atUint32 srcOffset;
+        atUint32 compressedLen;
+        atUint32 dstOffset;
+        atUint32 uncompressedLen;
+        bool     stored;
+    };
+
+    struct SCachedBlock
+    {
+        atUint32 block;
+        atUint64 lastUse;
+        std::unique_ptr<atUint8[]> data;
+    };
+
+    bool parse();
+    // Decompressed contents of a block, out of the cache or the source
+    const atUint8* blockData(atUint32 block);
+
+    const atUint8*            m_src;
+    atUint32                  m_srcLength;
+    atUint64                  m_length;
+    atUint64                  m_position;
+    atUint32                  m_cachedBlocks;
+    atUint64                  m_useCounter;
+    bool                      m_valid;
+    std::vector<SBlock>       m_blocks;
+    std::vector<SCachedBlock> m_cache;
+};
+
+#endif // CCMPDREADER_HPP
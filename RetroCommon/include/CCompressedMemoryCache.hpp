@@ -0,0 +1,55 @@
+#ifndef CCOMPRESSEDMEMORYCACHE_HPP
+#define CCOMPRESSEDMEMORYCACHE_HPP
+
+#include <Athena/Types.hpp>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * \brief Size capped in-memory store of payloads, kept LZ4 compressed.
+ *
+ * Sits between the decoded resources and the pak: getting a payload back out costs
+ * an LZ4 decode instead of a read plus zlib/LZO. Entries are keyed by the content
+ * hash and size of the payload as stored in its pak, the least recently used ones
+ * are dropped once the compressed size goes over the limit.
+ * Safe to use from several threads at once.
+ */
+class CCompressedMemoryCache final
+{
+public:
+    static const atUint64 DefaultSizeLimit = 256ull * 1024 * 1024;
+
+    explicit CCompressedMemoryCache(atUint64 sizeLimit = DefaultSizeLimit);
+
+    // A new[] copy of the payload, nullptr on a miss
+    atUint8* find(atUint64 hash, atUint32 storedSize, atUint32& length);
+    void     store(atUint64 hash, atUint32 storedSize, const atUint8* data, atUint32 length);
+    void     clear();
+
+    // Compressed size of everything held
+    atUint64 size() const;
+    atUint64 sizeLimit() const;
+    void     setSizeLimit(atUint64 sizeLimit);
+private:
+    struct SEntry
+    {
+        atUint64              hash;
+        atUint32              storedSize;
+        atUint32              length;     // uncompressed
+        bool                  compressed; // payloads LZ4 can't shrink are kept as is
+        std::vector<atUint8>  data;
+    };
+
+    // Expects m_mutex to be held
+    void evict();
+
+    atUint64           m_sizeLimit;
+    atUint64           m_size;
+    mutable std::mutex m_mutex;
+    std::list<SEntry>  m_lru; // most recently used first
+    std::unordered_map<atUint64, std::list<SEntry>::iterator> m_entries;
+};
+
+#endif // CCOMPRESSEDMEMORYCACHE_HPP
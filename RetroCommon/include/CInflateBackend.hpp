@@ -0,0 +1,36 @@
+#ifndef CINFLATEBACKEND_HPP
+#define CINFLATEBACKEND_HPP
+
+#include <Athena/Types.hpp>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief A zlib stream decoder the decompressors can be pointed at.
+ *
+ * Implementations have to be safe to call from several threads at once, the CMPD and
+ * MREA decompressors inflate their blocks on the worker pool.
+ */
+class IInflateBackend
+{
+public:
+    virtual ~IInflateBackend() {}
+
+    virtual const char* name() const = 0;
+
+    // Inflates one complete zlib stream into dst, returns the number of bytes written or <= 0 on failure
+    virtual atInt32 inflate(const atUint8* src, atUint32 srcLength, atUint8* dst, atUint32 dstLength) const = 0;
+};
+
+// Every backend that was compiled in, from slowest to fastest. "athena" is always the first one
+const std::vector<const IInflateBackend*>& inflateBackends();
+
+// Defaults to the fastest backend, RETRO_INFLATE_BACKEND=<name> overrides that
+const IInflateBackend& currentInflateBackend();
+// Returns false and keeps the current backend if there's none called name
+bool selectInflateBackend(const std::string& name);
+
+// What the decompressors use. Streams the current backend rejects are retried with the athena one
+atInt32 inflateZlib(const atUint8* src, atUint32 srcLength, atUint8* dst, atUint32 dstLength);
+
+#endif // CINFLATEBACKEND_HPP
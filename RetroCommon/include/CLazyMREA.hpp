@@ -0,0 +1,77 @@
+#ifndef CLAZYMREA_HPP
+#define CLAZYMREA_HPP
+
+#include <Athena/Types.hpp>
+#include <vector>
+
+/*!
+ * \brief Decompresses the blocks of an MP2, MP3 or DKCR area only once something asks for them.
+ *
+ * The decompressed area is laid out the same as decompressMREA's output, the header is
+ * rebuilt up front and every section sits where it would after a full decompression.
+ * Blocks hold whole sections, so asking for a section only decompresses the block(s) it
+ * lives in, everything else (SCLY, collision, lights, VISI, paths...) stays compressed.
+ * Not safe to use from several threads at once, load decompresses in parallel by itself.
+ */
+class CLazyMREA final
+{
+public:
+    // data has to outlive the reader, nothing is decompressed yet
+    CLazyMREA(const atUint8* data, atUint32 length);
+    ~CLazyMREA();
+
+    // False for MP1 areas (they aren't compressed) and anything that isn't a well formed area
+    bool isValid() const;
+
+    // Of the fully decompressed area
+    atUint32 length() const;
+    atUint32 sectionCount() const;
+    atUint32 sectionSize(atUint32 section) const;
+
+    // The decompressed section, its blocks are decompressed on first use. nullptr if one of them is damaged
+    const atUint8* section(atUint32 section);
+
+    // Decompresses every block holding one of sections, false if any of them is damaged
+    bool load(const std::vector<atUint32>& sections);
+    bool loadAll();
+
+    // Hands the decompressed area over to the caller (delete[]), blocks that weren't loaded are zeroed.
+    // Later loads still decompress into the released buffer, so the caller has to keep it alive for those
+    atUint8* release(atUint32& length);
+
+private:
+    enum class EBlockState : atUint8
+    {
+        Compressed,
+        Loaded,
+        Damaged
+    };
+
+    struct SBlock
+    {
+        atUint32    dataSize;
+        atUint32    dataCompSize;
+        atUint64    inOffset;
+        atUint64    outOffset;
+        EBlockState state;
+    };
+
+    bool parse();
+    void blocksFor(atUint32 section, std::vector<atUint32>& blocks) const;
+    bool loadBlocks(const std::vector<atUint32>& blocks);
+
+    CLazyMREA(const CLazyMREA&) = delete;
+    CLazyMREA& operator=(const CLazyMREA&) = delete;
+
+    const atUint8*        m_src;
+    atUint32              m_srcLength;
+    atUint8*              m_data;
+    atUint32              m_length;
+    bool                  m_owned;
+    bool                  m_valid;
+    std::vector<SBlock>   m_blocks;
+    std::vector<atUint32> m_sectionSizes;
+    std::vector<atUint64> m_sectionOffsets;
+};
+
+#endif // CLAZYMREA_HPP
@@ -0,0 +1,46 @@
+#ifndef CWORKERPOOL_HPP
+#define CWORKERPOOL_HPP
+
+#include <Athena/Types.hpp>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * \brief Process wide pool of worker threads shared by the loaders and decompressors.
+ *
+ * parallelFor is safe to call from inside a job, the calling thread always takes part
+ * in the loop so nested calls can't deadlock waiting on a busy pool.
+ */
+class CWorkerPool final
+{
+public:
+    static CWorkerPool& instance();
+
+    atUint32 threadCount() const;
+
+    void enqueue(const std::function<void()>& job);
+
+    // Runs fn(i) for every i in [0, count) and returns once all of them are done.
+    // The first exception thrown by fn is rethrown on the calling thread.
+    void parallelFor(atUint32 count, const std::function<void(atUint32)>& fn);
+
+private:
+    CWorkerPool();
+    ~CWorkerPool();
+    CWorkerPool(const CWorkerPool&) = delete;
+    CWorkerPool& operator=(const CWorkerPool&) = delete;
+
+    void workerMain();
+
+    std::vector<std::thread>          m_threads;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex                        m_mutex;
+    std::condition_variable           m_condition;
+    bool                              m_stopping;
+};
+
+#endif // CWORKERPOOL_HPP
@@ -15,7 +15,34 @@ enum class EPAKSection
 };
 
 void decompressData(aIO::IStreamWriter& outbuf,  const atUint8* srcData, atUint32 srcLength, atInt32 uncompressedLength);
+// Takes ownership of srcData, prefer decompressResource/decompressInto
 void decompressFile(aIO::IStreamWriter& outbuf,  const atUint8* srcData, atUint32 srcLength);
 bool decompressMREA(aIO::IStreamReader& in, aIO::IStreamWriter& out);
 
+// Size of a compressed resource (CMPD or size prefixed) once decompressed, 0 if it can't be determined
+atUint32 decompressedSize(const atUint8* srcData, atUint32 srcLength);
+// Decompresses a whole resource into dst, which has to be exactly decompressedSize bytes.
+// Neither buffer changes owner
+bool decompressInto(const atUint8* srcData, atUint32 srcLength, atUint8* dst, atUint32 dstLength);
+// Same as decompressInto into a new[] buffer the caller owns, nullptr on failure
+atUint8* decompressResource(const atUint8* srcData, atUint32 srcLength, atUint32& dstLength);
+// Decompresses a single CMPD block (a zlib stream or a run of LZO segments) into exactly dstLength bytes at dst
+bool decompressCMPDBlock(const atUint8* srcData, atUint32 srcLength, atUint8* dst, atUint32 dstLength);
+// Decompresses a whole MREA into a new[] buffer the caller owns, nullptr if it isn't compressed or is damaged.
+// srcData stays owned by the caller
+atUint8* decompressMREA(const atUint8* srcData, atUint32 srcLength, atUint32& dstLength);
+// Decodes one LZO1X segment into dst, returns the number of bytes written or -1 if it's damaged or doesn't fit.
+// Anything in dst past the returned length may be overwritten
+atInt32 decompressLZO1X(const atUint8* srcData, atUint32 srcLength, atUint8* dst, atUint32 dstLength);
+
+// LZ4 block compression, for keeping data compressed in memory.
+// compressLZ4 returns the compressed length or 0 if it doesn't fit in dstCapacity, lz4CompressBound bytes always fit
+atUint32 lz4CompressBound(atUint32 srcLength);
+atUint32 compressLZ4(const atUint8* srcData, atUint32 srcLength, atUint8* dst, atUint32 dstCapacity);
+// dst has to be exactly the uncompressed length
+bool     decompressLZ4(const atUint8* srcData, atUint32 srcLength, atUint8* dst, atUint32 dstLength);
+
+// 64 bit content hash (XXH64), used to identify identical payloads
+atUint64 contentHash(const atUint8* data, atUint64 length, atUint64 seed = 0);
+
 #endif // RETROCOMMON_HPP
@@ -0,0 +1,175 @@
+#include "CCMPDReader.hpp"
+#include "RetroCommon.hpp"
+#include <Athena/InvalidDataException.hpp>
+#include <Athena/IOException.hpp>
+#include <algorithm>
+#include <cinttypes>
+#include <memory.h>
+
+CCMPDReader::CCMPDReader(const atUint8* data, atUint32 length, atUint32 cachedBlocks)
+    : m_src(data),
+      m_srcLength(length),
+      m_length(0),
+      m_position(0),
+      m_cachedBlocks(std::max(1u, cachedBlocks)),
+      m_useCounter(0),
+      m_valid(false)
+{
+    m_valid = parse();
+    if (!m_valid)
+    {
+        m_blocks.clear();
+        m_length = 0;
+    }
+}
+
+bool CCMPDReader::parse()
+{
+    if (!m_src || m_srcLength < 8)
+        return false;
+
+    atUint32 magic = *(atUint32*)(m_src);
+    Athena::utility::BigUint32(magic);
+    if (magic != 0x434D5044)
+    {
+        // Everything else starts with the decompressed size. That's one block, decompressed in one go,
+        // so sizes no zlib or LZO stream of this length could decompress to are taken as damage
+        if (magic == 0 || magic > MaxSingleBlockLength || magic > (atUint64)(m_srcLength - 4) * MaxCompressionRatio)
+            return false;
+
+        m_blocks.push_back(SBlock{4, m_srcLength - 4, 0, magic, false});
+        m_length = magic;
+        return true;
+    }
+
+    atUint32 blockCount = *(atUint32*)(m_src + 4);
+    Athena::utility::BigUint32(blockCount);
+    if (8 + (atUint64)blockCount * 8 > m_srcLength)
+        return false;
+
+    atUint64 srcOffset = 8 + blockCount * 8;
+    atUint64 dstOffset = 0;
+    for (atUint32 i = 0; i < blockCount; i++)
+    {
+        atUint32 compressedLen   = *(atUint32*)(m_src + 8 + i * 8);
+        atUint32 uncompressedLen = *(atUint32*)(m_src + 12 + i * 8);
+        Athena::utility::BigUint32(compressedLen);
+        Athena::utility::BigUint32(uncompressedLen);
+        compressedLen &= 0x00FFFFFF;
+
+        // Every block is decompressed in one go too, so the same limits hold for each of them
+        if (uncompressedLen > MaxSingleBlockLength || uncompressedLen > (atUint64)compressedLen * MaxCompressionRatio)
+            return false;
+
+        m_blocks.push_back(SBlock{(atUint32)srcOffset, compressedLen, (atUint32)dstOffset, uncompressedLen,
+                                  compressedLen == uncompressedLen});
+        srcOffset += compressedLen;
+        dstOffset += uncompressedLen;
+    }
+
+    if (srcOffset > m_srcLength || dstOffset > 0xFFFFFFFF)
+        return false;
+
+    m_length = dstOffset;
+    return true;
+}
+
+bool CCMPDReader::isValid() const
+{
+    return m_valid;
+}
+
+void CCMPDReader::seek(atInt64 position, Athena::SeekOrigin origin)
+{
+    switch (origin)
+    {
+        case Athena::SeekOrigin::Begin:
+            break;
+        case Athena::SeekOrigin::Current:
+            position += m_position;
+            break;
+        case Athena::SeekOrigin::End:
+            position = m_length - position;
+            break;
+    }
+
+    if (position < 0 || (atUint64)position > m_length)
+        THROW_IO_EXCEPTION("Position %.8" PRIX64 " outside stream bounds", (atUint64)position);
+
+    m_position = position;
+}
+
+atUint64 CCMPDReader::position() const
+{
+    return m_position;
+}
+
+atUint64 CCMPDReader::length() const
+{
+    return m_length;
+}
+
+atUint64 CCMPDReader::readUBytesToBuf(void* buf, atUint64 length)
+{
+    if (m_position + length > m_length)
+        THROW_IO_EXCEPTION("Position %.8" PRIX64 " outside stream bounds", m_position);
+
+    // The block holding the current position, blocks are sorted by where they decompress to
+    std::vector<SBlock>::const_iterator iter = std::upper_bound(m_blocks.begin(), m_blocks.end(), m_position,
+                                                                [](atUint64 position, const SBlock& block)
+    { return position < (atUint64)block.dstOffset + block.uncompressedLen; });
+
+    atUint8* dst = (atUint8*)buf;
+    atUint64 remaining = length;
+    while (remaining > 0 && iter != m_blocks.end())
+    {
+        atUint32 block = iter - m_blocks.begin();
+        const atUint8* data = blockData(block);
+        if (!data)
+            THROW_INVALID_DATA_EXCEPTION("Unable to decompress block %i", block);
+
+        atUint64 offset = m_position - iter->dstOffset;
+        atUint64 count  = std::min(remaining, iter->uncompressedLen - offset);
+        memcpy(dst, data + offset, count);
+        dst        += count;
+        remaining  -= count;
+        m_position += count;
+        ++iter;
+    }
+
+    return length;
+}
+
+const atUint8* CCMPDReader::blockData(atUint32 block)
+{
+    const SBlock& info = m_blocks[block];
+    if (info.stored)
+        return m_src + info.srcOffset;
+
+    m_useCounter++;
+    for (SCachedBlock& cached : m_cache)
+    {
+        if (cached.block == block)
+        {
+            cached.lastUse = m_useCounter;
+            return cached.data.get();
+        }
+    }
+
+    std::unique_ptr<atUint8[]> data(new atUint8[info.uncompressedLen]);
+    if (!decompressCMPDBlock(m_src + info.srcOffset, info.compressedLen, data.get(), info.uncompressedLen))
+        return nullptr;
+
+    // Replaces the least recently used block once the cache is full
+    std::vector<SCachedBlock>::iterator slot = m_cache.end();
+    if (m_cache.size() < m_cachedBlocks)
+        slot = m_cache.insert(m_cache.end(), SCachedBlock());
+    else
+        slot = std::min_element(m_cache.begin(), m_cache.end(),
+                                [](const SCachedBlock& a, const SCachedBlock& b) { return a.lastUse < b.lastUse; });
+
+    slot->block   = block;
+    slot->lastUse = m_useCounter;
+    slot->data    = std::move(data);
+    return slot->data.get();
+}
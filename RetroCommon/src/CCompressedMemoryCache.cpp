@@ -0,0 +1,105 @@
+#include "CCompressedMemoryCache.hpp"
+#include "RetroCommon.hpp"
+#include <memory.h>
+
+CCompressedMemoryCache::CCompressedMemoryCache(atUint64 sizeLimit)
+    : m_sizeLimit(sizeLimit),
+      m_size(0)
+{
+}
+
+atUint8* CCompressedMemoryCache::find(atUint64 hash, atUint32 storedSize, atUint32& length)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    std::unordered_map<atUint64, std::list<SEntry>::iterator>::iterator entry = m_entries.find(hash);
+    if (entry == m_entries.end() || entry->second->storedSize != storedSize)
+        return nullptr;
+
+    m_lru.splice(m_lru.begin(), m_lru, entry->second);
+    const SEntry& found = *entry->second;
+
+    atUint8* ret = new atUint8[found.length];
+    if (!found.compressed)
+        memcpy(ret, found.data.data(), found.length);
+    else if (!decompressLZ4(found.data.data(), found.data.size(), ret, found.length))
+    {
+        delete[] ret;
+        return nullptr;
+    }
+
+    length = found.length;
+    return ret;
+}
+
+void CCompressedMemoryCache::store(atUint64 hash, atUint32 storedSize, const atUint8* data, atUint32 length)
+{
+    if (length == 0 || length > m_sizeLimit)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_entries.find(hash) != m_entries.end())
+            return;
+    }
+
+    // Compress outside the lock, it's by far the most expensive part
+    SEntry entry;
+    entry.hash       = hash;
+    entry.storedSize = storedSize;
+    entry.length     = length;
+    entry.data.resize(lz4CompressBound(length));
+    atUint32 compressedLength = compressLZ4(data, length, entry.data.data(), entry.data.size());
+    entry.compressed = compressedLength > 0 && compressedLength < length;
+    if (entry.compressed)
+        entry.data.resize(compressedLength);
+    else
+        entry.data.assign(data, data + length);
+    entry.data.shrink_to_fit();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_entries.find(hash) != m_entries.end())
+        return;
+
+    m_size += entry.data.size();
+    m_lru.push_front(std::move(entry));
+    m_entries[hash] = m_lru.begin();
+    evict();
+}
+
+void CCompressedMemoryCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lru.clear();
+    m_entries.clear();
+    m_size = 0;
+}
+
+void CCompressedMemoryCache::evict()
+{
+    while (m_size > m_sizeLimit && !m_lru.empty())
+    {
+        const SEntry& oldest = m_lru.back();
+        m_size -= oldest.data.size();
+        m_entries.erase(oldest.hash);
+        m_lru.pop_back();
+    }
+}
+
+atUint64 CCompressedMemoryCache::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_size;
+}
+
+atUint64 CCompressedMemoryCache::sizeLimit() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sizeLimit;
+}
+
+void CCompressedMemoryCache::setSizeLimit(atUint64 sizeLimit)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sizeLimit = sizeLimit;
+    evict();
+}
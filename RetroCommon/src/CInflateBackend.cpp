@@ -0,0 +1,197 @@
+#include "CInflateBackend.hpp"
+#include <Athena/Compression.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <zlib.h>
+
+#ifdef RETRO_HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+namespace
+{
+// The existing path, inflateInit/inflateEnd around every stream
+class CAthenaInflate final : public IInflateBackend
+{
+public:
+    const char* name() const { return "athena"; }
+
+    atInt32 inflate(const atUint8* src, atUint32 srcLength, atUint8* dst, atUint32 dstLength) const
+    {
+        return Athena::io::Compression::decompressZlib(src, srcLength, dst, dstLength);
+    }
+};
+
+// Plain zlib, but every thread keeps its z_stream around and only resets it between streams,
+// so the 0x4000 byte MREA segments don't each allocate and free a fresh inflate state
+class CZlibInflate final : public IInflateBackend
+{
+public:
+    const char* name() const { return "zlib"; }
+
+    atInt32 inflate(const atUint8* src, atUint32 srcLength, atUint8* dst, atUint32 dstLength) const
+    {
+        thread_local SStream stream;
+        if (!stream.valid)
+            return -1;
+
+        z_stream& zs = stream.zs;
+        if (inflateReset(&zs) != Z_OK)
+            return -1;
+
+        zs.next_in   = (Bytef*)src;
+        zs.avail_in  = srcLength;
+        zs.next_out  = dst;
+        zs.avail_out = dstLength;
+
+        // The whole output buffer is there up front, so this is a single call
+        if (::inflate(&zs, Z_FINISH) != Z_STREAM_END)
+            return -1;
+
+        return (atInt32)zs.total_out;
+    }
+
+private:
+    struct SStream
+    {
+        SStream()
+        {
+            zs.zalloc = Z_NULL;
+            zs.zfree  = Z_NULL;
+            zs.opaque = Z_NULL;
+            zs.next_in  = Z_NULL;
+            zs.avail_in = 0;
+            valid = (inflateInit(&zs) == Z_OK);
+        }
+
+        ~SStream()
+        {
+            if (valid)
+                inflateEnd(&zs);
+        }
+
+        z_stream zs;
+        bool     valid;
+    };
+};
+
+#ifdef RETRO_HAVE_LIBDEFLATE
+// libdeflate only handles whole buffers, which is all we ever have
+class CLibdeflateInflate final : public IInflateBackend
+{
+public:
+    const char* name() const { return "libdeflate"; }
+
+    atInt32 inflate(const atUint8* src, atUint32 srcLength, atUint8* dst, atUint32 dstLength) const
+    {
+        thread_local SDecompressor decompressor;
+        if (!decompressor.d)
+            return -1;
+
+        size_t written = 0;
+        if (libdeflate_zlib_decompress(decompressor.d, src, srcLength, dst, dstLength, &written) != LIBDEFLATE_SUCCESS)
+            return -1;
+
+        return (atInt32)written;
+    }
+
+private:
+    struct SDecompressor
+    {
+        SDecompressor() : d(libdeflate_alloc_decompressor()) {}
+        ~SDecompressor()
+        {
+            if (d)
+                libdeflate_free_decompressor(d);
+        }
+
+        libdeflate_decompressor* d;
+    };
+};
+#endif
+
+CAthenaInflate AthenaInflate;
+CZlibInflate ZlibInflate;
+#ifdef RETRO_HAVE_LIBDEFLATE
+CLibdeflateInflate LibdeflateInflate;
+#endif
+
+const IInflateBackend* findBackend(const std::string& name)
+{
+    for (const IInflateBackend* backend : inflateBackends())
+    {
+        if (name == backend->name())
+            return backend;
+    }
+
+    return nullptr;
+}
+
+std::atomic<const IInflateBackend*>& activeBackend()
+{
+    static std::atomic<const IInflateBackend*> active(nullptr);
+    return active;
+}
+
+const IInflateBackend* defaultBackend()
+{
+    const char* requested = getenv("RETRO_INFLATE_BACKEND");
+    if (requested)
+    {
+        const IInflateBackend* backend = findBackend(requested);
+        if (backend)
+            return backend;
+    }
+
+    return inflateBackends().back();
+}
+}
+
+const std::vector<const IInflateBackend*>& inflateBackends()
+{
+    static const std::vector<const IInflateBackend*> backends =
+    {
+        &AthenaInflate,
+        &ZlibInflate,
+#ifdef RETRO_HAVE_LIBDEFLATE
+        &LibdeflateInflate,
+#endif
+    };
+
+    return backends;
+}
+
+const IInflateBackend& currentInflateBackend()
+{
+    const IInflateBackend* backend = activeBackend().load(std::memory_order_acquire);
+    if (!backend)
+    {
+        // Don't clobber a selectInflateBackend that got in first
+        const IInflateBackend* expected = nullptr;
+        backend = defaultBackend();
+        if (!activeBackend().compare_exchange_strong(expected, backend, std::memory_order_acq_rel))
+            backend = expected;
+    }
+
+    return *backend;
+}
+
+bool selectInflateBackend(const std::string& name)
+{
+    const IInflateBackend* backend = findBackend(name);
+    if (!backend)
+        return false;
+
+    activeBackend().store(backend, std::memory_order_release);
+    return true;
+}
+
+atInt32 inflateZlib(const atUint8* src, atUint32 srcLength, atUint8* dst, atUint32 dstLength)
+{
+    const IInflateBackend& backend = currentInflateBackend();
+    atInt32 ret = backend.inflate(src, srcLength, dst, dstLength);
+    if (ret <= 0 && &backend != &AthenaInflate)
+        ret = AthenaInflate.inflate(src, srcLength, dst, dstLength);
+
+    return ret;
+}
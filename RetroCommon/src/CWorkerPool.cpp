@@ -0,0 +1,147 @@
+#include "CWorkerPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace
+{
+struct SParallelForState
+{
+    SParallelForState(atUint32 count, const std::function<void(atUint32)>& fn)
+        : fn(fn),
+          count(count),
+          next(0),
+          done(0)
+    {
+    }
+
+    // Claims indices until there are none left
+    void run()
+    {
+        atUint32 i;
+        while ((i = next++) < count)
+        {
+            try
+            {
+                fn(i);
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error)
+                    error = std::current_exception();
+            }
+
+            if (++done == count)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.notify_all();
+            }
+        }
+    }
+
+    std::function<void(atUint32)> fn;
+    atUint32                 count;
+    std::atomic<atUint32>    next;
+    std::atomic<atUint32>    done;
+    std::mutex               mutex;
+    std::condition_variable  finished;
+    std::exception_ptr       error;
+};
+}
+
+CWorkerPool& CWorkerPool::instance()
+{
+    static CWorkerPool instance;
+    return instance;
+}
+
+CWorkerPool::CWorkerPool()
+    : m_stopping(false)
+{
+    atUint32 threads = std::thread::hardware_concurrency();
+    // The calling thread always helps out, so leave a core for it
+    if (threads > 1)
+        threads--;
+    if (threads == 0)
+        threads = 1;
+
+    for (atUint32 i = 0; i < threads; i++)
+        m_threads.push_back(std::thread(&CWorkerPool::workerMain, this));
+}
+
+CWorkerPool::~CWorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    for (std::thread& thread : m_threads)
+        thread.join();
+}
+
+atUint32 CWorkerPool::threadCount() const
+{
+    return m_threads.size();
+}
+
+void CWorkerPool::enqueue(const std::function<void()>& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(job);
+    }
+    m_condition.notify_one();
+}
+
+void CWorkerPool::parallelFor(atUint32 count, const std::function<void(atUint32)>& fn)
+{
+    if (count == 0)
+        return;
+
+    if (count == 1)
+    {
+        fn(0);
+        return;
+    }
+
+    // Helpers may still be queued after we return, so they share ownership of the state
+    std::shared_ptr<SParallelForState> state = std::make_shared<SParallelForState>(count, fn);
+
+    atUint32 helpers = std::min<atUint32>(threadCount(), count - 1);
+    for (atUint32 i = 0; i < helpers; i++)
+        enqueue([state]() { state->run(); });
+
+    state->run();
+
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&state]()->bool{ return state->done == state->count; });
+    }
+
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
+
+void CWorkerPool::workerMain()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]()->bool{ return m_stopping || !m_jobs.empty(); });
+
+            if (m_stopping && m_jobs.empty())
+                return;
+
+            job = m_jobs.front();
+            m_jobs.pop_front();
+        }
+
+        job();
+    }
+}
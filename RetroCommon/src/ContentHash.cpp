@@ -0,0 +1,109 @@
+#include "RetroCommon.hpp"
+#include <memory.h>
+
+// XXH64 (https://github.com/Cyan4973/xxHash), reimplemented to avoid another external
+namespace
+{
+const atUint64 Prime1 = 0x9E3779B185EBCA87ULL;
+const atUint64 Prime2 = 0xC2B2AE3D27D4EB4FULL;
+const atUint64 Prime3 = 0x165667B19E3779F9ULL;
+const atUint64 Prime4 = 0x85EBCA77C2B2AE63ULL;
+const atUint64 Prime5 = 0x27D4EB2F165667C5ULL;
+
+inline atUint64 rotl(atUint64 v, atUint32 r)
+{
+    return (v << r) | (v >> (64 - r));
+}
+
+// The hash is defined over little endian words, on big endian hosts this will just give different (but stable) values
+inline atUint64 read64(const atUint8* p)
+{
+    atUint64 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline atUint32 read32(const atUint8* p)
+{
+    atUint32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline atUint64 round(atUint64 acc, atUint64 input)
+{
+    acc += input * Prime2;
+    acc  = rotl(acc, 31);
+    return acc * Prime1;
+}
+
+inline atUint64 mergeRound(atUint64 acc, atUint64 val)
+{
+    acc ^= round(0, val);
+    return acc * Prime1 + Prime4;
+}
+}
+
+atUint64 contentHash(const atUint8* data, atUint64 length, atUint64 seed)
+{
+    const atUint8* p   = data;
+    const atUint8* end = data + length;
+    atUint64 h;
+
+    if (length >= 32)
+    {
+        const atUint8* limit = end - 32;
+        atUint64 v1 = seed + Prime1 + Prime2;
+        atUint64 v2 = seed + Prime2;
+        atUint64 v3 = seed;
+        atUint64 v4 = seed - Prime1;
+
+        do
+        {
+            v1 = round(v1, read64(p)); p += 8;
+            v2 = round(v2, read64(p)); p += 8;
+            v3 = round(v3, read64(p)); p += 8;
+            v4 = round(v4, read64(p)); p += 8;
+        }
+        while (p <= limit);
+
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    }
+    else
+        h = seed + Prime5;
+
+    h += length;
+
+    while (p + 8 <= end)
+    {
+        h ^= round(0, read64(p));
+        h  = rotl(h, 27) * Prime1 + Prime4;
+        p += 8;
+    }
+
+    if (p + 4 <= end)
+    {
+        h ^= (atUint64)read32(p) * Prime1;
+        h  = rotl(h, 23) * Prime2 + Prime3;
+        p += 4;
+    }
+
+    while (p < end)
+    {
+        h ^= (*p) * Prime5;
+        h  = rotl(h, 11) * Prime1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= Prime2;
+    h ^= h >> 29;
+    h *= Prime3;
+    h ^= h >> 32;
+
+    return h;
+}
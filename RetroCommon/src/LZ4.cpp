@@ -0,0 +1,241 @@
+#include "RetroCommon.hpp"
+#include <memory.h>
+#include <vector>
+
+// LZ4 block format (https://github.com/lz4/lz4), reimplemented to avoid another external.
+// Only used for data that never leaves the process, so there's no frame format around it
+namespace
+{
+const atUint32 MinMatch     = 4;
+const atUint32 LastLiterals = 5;  // the last 5 bytes are always literals
+const atUint32 MFLimit      = 12; // and the last match starts at least 12 bytes before the end
+const atUint32 MaxOffset    = 0xFFFF;
+const atUint32 HashLog      = 14;
+
+inline atUint32 read32(const atUint8* p)
+{
+    atUint32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline bool equal8(const atUint8* a, const atUint8* b)
+{
+    return memcmp(a, b, 8) == 0;
+}
+
+inline atUint32 hash32(atUint32 v)
+{
+    return (v * 2654435761U) >> (32 - HashLog);
+}
+
+// Length continuation bytes after a nibble of 15
+inline atUint8* writeLength(atUint8* op, atUint32 length)
+{
+    while (length >= 255)
+    {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (atUint8)length;
+    return op;
+}
+
+inline bool readLength(const atUint8*& ip, const atUint8* ipEnd, atUint32& length)
+{
+    atUint8 b;
+    do
+    {
+        if (ip >= ipEnd)
+            return false;
+        b = *ip++;
+        length += b;
+    } while (b == 255);
+
+    return true;
+}
+}
+
+atUint32 lz4CompressBound(atUint32 srcLength)
+{
+    return srcLength + srcLength / 255 + 16;
+}
+
+atUint32 compressLZ4(const atUint8* srcData, atUint32 srcLength, atUint8* dst, atUint32 dstCapacity)
+{
+    const atUint8* ip     = srcData;
+    const atUint8* anchor = srcData;
+    const atUint8* const end = srcData + srcLength;
+    atUint8* op = dst;
+    atUint8* const opEnd = dst + dstCapacity;
+
+    // Emits the literals from anchor up to ip followed by a match, or only the literals when matchLength is 0
+    auto emitSequence = [&](atUint32 offset, atUint32 matchLength) -> bool
+    {
+        atUint32 literalLength = ip - anchor;
+        if ((atUint64)(opEnd - op) < 1 + literalLength + literalLength / 255 + 1 + 2 + matchLength / 255 + 1)
+            return false;
+
+        atUint8* token = op++;
+        *token = (atUint8)((literalLength >= 15 ? 15 : literalLength) << 4);
+        if (literalLength >= 15)
+            op = writeLength(op, literalLength - 15);
+
+        if (literalLength > 0)
+            memcpy(op, anchor, literalLength);
+        op += literalLength;
+
+        if (matchLength == 0)
+            return true;
+
+        *op++ = (atUint8)(offset & 0xFF);
+        *op++ = (atUint8)(offset >> 8);
+
+        matchLength -= MinMatch;
+        *token |= (atUint8)(matchLength >= 15 ? 15 : matchLength);
+        if (matchLength >= 15)
+            op = writeLength(op, matchLength - 15);
+
+        return true;
+    };
+
+    if (srcLength > MFLimit)
+    {
+        std::vector<atUint32> table(1 << HashLog, 0);
+        const atUint8* const matchLimit = end - LastLiterals;
+        const atUint8* const ipLimit    = end - MFLimit;
+
+        ip++;
+        while (ip < ipLimit)
+        {
+            atUint32 sequence = read32(ip);
+            atUint32 h = hash32(sequence);
+            const atUint8* ref = srcData + table[h];
+            table[h] = ip - srcData;
+
+            if (ref >= ip || ip - ref > MaxOffset || read32(ref) != sequence)
+            {
+                ip++;
+                continue;
+            }
+
+            // Grow the match in both directions
+            const atUint8* matchEnd = ip + MinMatch;
+            const atUint8* refEnd   = ref + MinMatch;
+            while (matchEnd + 8 <= matchLimit && equal8(matchEnd, refEnd))
+            {
+                matchEnd += 8;
+                refEnd   += 8;
+            }
+            while (matchEnd < matchLimit && *matchEnd == *refEnd)
+            {
+                matchEnd++;
+                refEnd++;
+            }
+
+            while (ip > anchor && ref > srcData && ip[-1] == ref[-1])
+            {
+                ip--;
+                ref--;
+            }
+
+            if (!emitSequence(ip - ref, matchEnd - ip))
+                return 0;
+
+            ip     = matchEnd;
+            anchor = ip;
+        }
+    }
+
+    ip = end;
+    if (!emitSequence(0, 0))
+        return 0;
+
+    return op - dst;
+}
+
+bool decompressLZ4(const atUint8* srcData, atUint32 srcLength, atUint8* dst, atUint32 dstLength)
+{
+    const atUint8* ip = srcData;
+    const atUint8* const ipEnd = srcData + srcLength;
+    atUint8* op = dst;
+    atUint8* const opEnd = dst + dstLength;
+
+    while (ip < ipEnd)
+    {
+        atUint8 token = *ip++;
+
+        atUint32 literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(ip, ipEnd, literalLength))
+            return false;
+
+        if (literalLength > (atUint64)(ipEnd - ip) || literalLength > (atUint64)(opEnd - op))
+            return false;
+
+        // Short runs are copied as a fixed 16 bytes when there's room, whatever lands past
+        // the run is overwritten by what follows it
+        if (literalLength <= 16 && ipEnd - ip >= 16 && opEnd - op >= 16)
+            memcpy(op, ip, 16);
+        else if (literalLength > 0)
+            memcpy(op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        // The last sequence has no match
+        if (ip == ipEnd)
+            break;
+
+        if (ipEnd - ip < 2)
+            return false;
+
+        atUint32 offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (atUint64)(op - dst))
+            return false;
+
+        atUint32 matchLength = token & 15;
+        if (matchLength == 15 && !readLength(ip, ipEnd, matchLength))
+            return false;
+        matchLength += MinMatch;
+
+        if (matchLength > (atUint64)(opEnd - op))
+            return false;
+
+        const atUint8* match = op - offset;
+        if (offset >= 8)
+        {
+            // Never reads what it's writing, so 8 bytes at a time, overshooting the match
+            // when there's room for it
+            atUint8* matchEnd = op + matchLength;
+            if (opEnd - matchEnd >= 8)
+            {
+                do
+                {
+                    memcpy(op, match, 8);
+                    op    += 8;
+                    match += 8;
+                } while (op < matchEnd);
+                op = matchEnd;
+            }
+            else
+            {
+                while (op + 8 <= matchEnd)
+                {
+                    memcpy(op, match, 8);
+                    op    += 8;
+                    match += 8;
+                }
+                while (op < matchEnd)
+                    *op++ = *match++;
+            }
+        }
+        else
+        {
+            // Overlapping, repeats the last offset bytes
+            for (atUint32 i = 0; i < matchLength; i++)
+                *op++ = *match++;
+        }
+    }
+
+    return op == opEnd;
+}
@@ -0,0 +1,277 @@
+#include "RetroCommon.hpp"
+#include <memory.h>
+
+// LZO1X decoder for Retro's LZO segments, follows the reference lzo1x_decompress_safe.
+// Retro's segments are tiny (at most 0x4000 bytes in and out) and always decoded into the
+// middle of a larger buffer, so instead of stopping the wide copies at the end of the
+// segment they're only stopped at the end of dst. Whatever they write past the segment
+// is overwritten by the segments that follow it.
+namespace
+{
+inline void copy4(atUint8* dst, const atUint8* src)
+{
+    memcpy(dst, src, 4);
+}
+
+inline void copy8(atUint8* dst, const atUint8* src)
+{
+    memcpy(dst, src, 8);
+}
+
+inline atUint32 readLE16(const atUint8* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+// Offset of the long M1 matches that may directly follow a literal run
+const atUint32 M2MaxOffset = 0x0800;
+}
+
+atInt32 decompressLZO1X(const atUint8* src, atUint32 srcLength, atUint8* dst, atUint32 dstLength)
+{
+    const atUint8* ip = src;
+    const atUint8* const ipEnd = src + srcLength;
+    atUint8* op = dst;
+    atUint8* const opEnd = dst + dstLength;
+    const atUint8* mPos;
+    size_t t;
+    size_t next;
+    size_t state = 0;
+
+#define HAVE_IP(x) ((size_t)(ipEnd - ip) >= (size_t)(x))
+#define HAVE_OP(x) ((size_t)(opEnd - op) >= (size_t)(x))
+#define NEED_IP(x) if (!HAVE_IP(x)) return -1
+#define NEED_OP(x) if (!HAVE_OP(x)) return -1
+#define TEST_LB(m) if ((m) < dst) return -1
+
+    // Every instruction needs at least 3 bytes of input (the end marker is an M4 match),
+    // the checks below keep that true so the instruction bytes themselves aren't bounds checked
+    if (srcLength < 3)
+        return -1;
+
+    if (*ip > 17)
+    {
+        t = *ip++ - 17;
+        if (t < 4)
+        {
+            next = t;
+            goto match_next;
+        }
+
+        goto copy_literal_run;
+    }
+
+    for (;;)
+    {
+        t = *ip++;
+        if (t < 16)
+        {
+            if (state == 0)
+            {
+                // Literal run
+                if (t == 0)
+                {
+                    const atUint8* ipLast = ip;
+                    while (*ip == 0)
+                    {
+                        ip++;
+                        NEED_IP(1);
+                    }
+
+                    size_t zeros = ip - ipLast;
+                    t += (zeros << 8) - zeros + 15 + *ip++;
+                }
+                t += 3;
+
+copy_literal_run:
+                if (HAVE_IP(t + 15) && HAVE_OP(t + 15))
+                {
+                    const atUint8* ie = ip + t;
+                    atUint8* oe = op + t;
+                    do
+                    {
+                        copy8(op, ip);
+                        copy8(op + 8, ip + 8);
+                        op += 16;
+                        ip += 16;
+                    } while (ip < ie);
+
+                    ip = ie;
+                    op = oe;
+                }
+                else
+                {
+                    NEED_OP(t);
+                    NEED_IP(t + 3);
+                    do
+                    {
+                        *op++ = *ip++;
+                    } while (--t > 0);
+                }
+
+                state = 4;
+                continue;
+            }
+            else if (state != 4)
+            {
+                // M1, two bytes close by after a short literal run
+                next = t & 3;
+                mPos = op - 1 - (t >> 2) - (*ip++ << 2);
+                TEST_LB(mPos);
+                NEED_OP(2);
+                op[0] = mPos[0];
+                op[1] = mPos[1];
+                op += 2;
+                goto match_next;
+            }
+            else
+            {
+                // M1, three bytes further back after a long literal run
+                next = t & 3;
+                mPos = op - (1 + M2MaxOffset) - (t >> 2) - (*ip++ << 2);
+                t = 3;
+            }
+        }
+        else if (t >= 64)
+        {
+            // M2
+            next = t & 3;
+            mPos = op - 1 - ((t >> 2) & 7) - (*ip++ << 3);
+            t = (t >> 5) - 1 + 2;
+        }
+        else if (t >= 32)
+        {
+            // M3
+            t = (t & 31) + 2;
+            if (t == 2)
+            {
+                const atUint8* ipLast = ip;
+                while (*ip == 0)
+                {
+                    ip++;
+                    NEED_IP(1);
+                }
+
+                size_t zeros = ip - ipLast;
+                t += (zeros << 8) - zeros + 31 + *ip++;
+                NEED_IP(2);
+            }
+
+            next = readLE16(ip);
+            ip += 2;
+            mPos = op - 1 - (next >> 2);
+            next &= 3;
+        }
+        else
+        {
+            // M4, or the end marker
+            mPos = op - ((t & 8) << 11);
+            t = (t & 7) + 2;
+            if (t == 2)
+            {
+                const atUint8* ipLast = ip;
+                while (*ip == 0)
+                {
+                    ip++;
+                    NEED_IP(1);
+                }
+
+                size_t zeros = ip - ipLast;
+                t += (zeros << 8) - zeros + 7 + *ip++;
+                NEED_IP(2);
+            }
+
+            next = readLE16(ip);
+            ip += 2;
+            mPos -= next >> 2;
+            next &= 3;
+            if (mPos == op)
+                break;
+
+            mPos -= 0x4000;
+        }
+
+        TEST_LB(mPos);
+        if (op - mPos >= 8)
+        {
+            // Far enough back that 8 byte copies never read what they're writing
+            atUint8* oe = op + t;
+            if (HAVE_OP(t + 15))
+            {
+                do
+                {
+                    copy8(op, mPos);
+                    copy8(op + 8, mPos + 8);
+                    op   += 16;
+                    mPos += 16;
+                } while (op < oe);
+
+                op = oe;
+                if (HAVE_IP(6))
+                {
+                    // The trailing literals can be copied 4 at a time too
+                    state = next;
+                    copy4(op, ip);
+                    op += next;
+                    ip += next;
+                    continue;
+                }
+            }
+            else
+            {
+                NEED_OP(t);
+                do
+                {
+                    *op++ = *mPos++;
+                } while (op < oe);
+            }
+        }
+        else
+        {
+            // Overlapping (run length style) match, has to go a byte at a time
+            atUint8* oe = op + t;
+            NEED_OP(t);
+            op[0] = mPos[0];
+            op[1] = mPos[1];
+            op   += 2;
+            mPos += 2;
+            do
+            {
+                *op++ = *mPos++;
+            } while (op < oe);
+        }
+
+match_next:
+        // Up to 3 literals trailing the match
+        state = next;
+        t = next;
+        if (HAVE_IP(6) && HAVE_OP(4))
+        {
+            copy4(op, ip);
+            op += t;
+            ip += t;
+        }
+        else
+        {
+            NEED_IP(t + 3);
+            NEED_OP(t);
+            while (t > 0)
+            {
+                *op++ = *ip++;
+                t--;
+            }
+        }
+    }
+
+#undef HAVE_IP
+#undef HAVE_OP
+#undef NEED_IP
+#undef NEED_OP
+#undef TEST_LB
+
+    // The end marker is always a 3 byte M4 match
+    if (t != 3 || ip > ipEnd)
+        return -1;
+
+    return (atInt32)(op - dst);
+}
@@ -1,5 +1,11 @@
 #include "RetroCommon.hpp"
 #include <Athena/Compression.hpp>
+#include "CInflateBackend.hpp"
+#include "CWorkerPool.hpp"
+#include "CLazyMREA.hpp"
+#include <algorithm>
+#include <exception>
+#include <vector>
 #include <memory.h>
 
 enum MREAVersion
@@ -21,191 +27,437 @@ struct CompressedBlockInfo
 };
 
 
-bool decompressBlock(CompressedBlockInfo& info, Athena::io::IStreamReader& in, Athena::io::IStreamWriter& out);
+// Below this much output the blocks are decompressed on the calling thread
+static const atUint32 ParallelDecompressThreshold = 256 * 1024;
 
-bool decompressMREA(Athena::io::IStreamReader& in, Athena::io::IStreamWriter& out)
+static atUint32 blockInputSize(const CompressedBlockInfo& info)
+{
+    // Compressed blocks are padded to 32 bytes (at the front), raw ones aren't padded at all
+    return info.dataCompSize == 0 ? info.dataSize : ROUND_UP_32(info.dataCompSize);
+}
+
+// Big endian cursors over the raw MREA, the header is parsed straight out of the caller's buffer
+struct SMREAInput
+{
+    const atUint8* data;
+    atUint32       length;
+    atUint32       position;
+
+    atUint32 readUint32()
+    {
+        if (position + 4 > length)
+            throw std::exception();
+
+        atUint32 ret;
+        memcpy(&ret, data + position, 4);
+        Athena::utility::BigUint32(ret);
+        position += 4;
+        return ret;
+    }
+
+    void seekAlign32() { position = ROUND_UP_32(position); }
+};
+
+struct SMREAHeader
+{
+    std::vector<atUint8> data;
+
+    void writeUint32(atUint32 v)
+    {
+        Athena::utility::BigUint32(v);
+        const atUint8* bytes = (const atUint8*)&v;
+        data.insert(data.end(), bytes, bytes + 4);
+    }
+
+    void seekAlign32() { data.resize(ROUND_UP_32(data.size()), 0); }
+};
+
+bool decompressBlock(const CompressedBlockInfo& info, const atUint8* in, atUint8* out);
+
+CLazyMREA::CLazyMREA(const atUint8* data, atUint32 length)
+    : m_src(data),
+      m_srcLength(length),
+      m_data(nullptr),
+      m_length(0),
+      m_owned(true),
+      m_valid(false)
 {
     try
     {
-        // Do this as a precaution, MREAs are always in big endian
-        in.setEndian(Athena::Endian::BigEndian);
-        out.setEndian(Athena::Endian::BigEndian);
-        atUint32 magic = in.readUint32();
+        m_valid = parse();
+    }
+    catch(...)
+    {
+        m_valid = false;
+    }
 
-        if (magic != 0xDEADBEEF)
-            return false;
+    if (!m_valid)
+    {
+        delete[] m_data;
+        m_data = nullptr;
+    }
+}
 
-        atUint32 version = in.readUint32();
+CLazyMREA::~CLazyMREA()
+{
+    if (m_owned)
+        delete[] m_data;
+}
 
-        // Metroid prime 1 MREAs aren't compressed
-        if (version == MetroidPrime1 || version == MetroidPrimeDemo)
-            return false;
+bool CLazyMREA::parse()
+{
+    SMREAInput in = {m_src, m_srcLength, 0};
+    SMREAHeader out;
 
-        out.writeUint32(magic);
-        out.writeUint32(version);
-        
-        atInt8* mtxData = in.readBytes(sizeof(float[3][4]));
-        out.writeBytes(mtxData, sizeof(float[3][4]));
-        delete[] mtxData;
-        out.writeUint32(in.readUint32()); // mesh count
-        out.writeUint32(in.readUint32()); // scly count
+    atUint32 magic = in.readUint32();
 
-        atUint32 sectionCount = in.readUint32();
-        out.writeUint32(sectionCount);
+    if (magic != 0xDEADBEEF)
+        return false;
 
-        if (version == MetroidPrime2)
-        {
-            for (atUint32 i = 0; i < 11; i++)
-                out.writeUint32(in.readUint32());
-        }
+    atUint32 version = in.readUint32();
 
-        atUint32 compressedBlockCount = in.readUint32();
-        out.writeUint32(compressedBlockCount);
-        atUint32 sectionNumberCount = 0;
-        if (version == MetroidPrime3 || version == DKCR)
-            sectionNumberCount = in.readUint32();
-        out.writeUint32(sectionNumberCount);
+    // Metroid prime 1 MREAs aren't compressed
+    if (version == MetroidPrime1 || version == MetroidPrimeDemo)
+        return false;
 
-        in.seekAlign32();
-        out.seekAlign32();
+    out.writeUint32(magic);
+    out.writeUint32(version);
+
+    for (atUint32 i = 0; i < 12; i++) // transform matrix
+        out.writeUint32(in.readUint32());
+    out.writeUint32(in.readUint32()); // mesh count
+    out.writeUint32(in.readUint32()); // scly count
 
-        for (atUint32 i = 0; i < sectionCount; i++)
+    atUint32 sectionCount = in.readUint32();
+    out.writeUint32(sectionCount);
+
+    if (version == MetroidPrime2)
+    {
+        for (atUint32 i = 0; i < 11; i++)
             out.writeUint32(in.readUint32());
+    }
 
-        in.seekAlign32();
-        out.seekAlign32();
+    atUint32 compressedBlockCount = in.readUint32();
+    out.writeUint32(compressedBlockCount);
+    atUint32 sectionNumberCount = 0;
+    if (version == MetroidPrime3 || version == DKCR)
+        sectionNumberCount = in.readUint32();
+    out.writeUint32(sectionNumberCount);
 
-        std::vector<CompressedBlockInfo> blockInfo;
+    in.seekAlign32();
+    out.seekAlign32();
 
-        for (atUint32 i = 0; i < compressedBlockCount; i++)
-        {
-            CompressedBlockInfo block;
-            block.blockSize    = in.readUint32();
-            out.writeUint32(block.blockSize);
-            block.dataSize     = in.readUint32();
-            out.writeUint32(block.dataSize);
-            block.dataCompSize = in.readUint32();
-            out.writeUint32(0);
-            block.sectionCount = in.readUint32();
-            out.writeUint32(block.sectionCount);
-            blockInfo.push_back(block);
-        }
+    m_sectionSizes.resize(sectionCount);
+    for (atUint32 i = 0; i < sectionCount; i++)
+    {
+        m_sectionSizes[i] = in.readUint32();
+        out.writeUint32(m_sectionSizes[i]);
+    }
+
+    in.seekAlign32();
+    out.seekAlign32();
+
+    std::vector<CompressedBlockInfo> blockInfo;
+
+    for (atUint32 i = 0; i < compressedBlockCount; i++)
+    {
+        CompressedBlockInfo block;
+        block.blockSize    = in.readUint32();
+        out.writeUint32(block.blockSize);
+        block.dataSize     = in.readUint32();
+        out.writeUint32(block.dataSize);
+        block.dataCompSize = in.readUint32();
+        out.writeUint32(0);
+        block.sectionCount = in.readUint32();
+        out.writeUint32(block.sectionCount);
+        blockInfo.push_back(block);
+    }
+
+    in.seekAlign32();
+    out.seekAlign32();
+
+    if (version == MetroidPrime3 || version == DKCR)
+    {
+        for (atUint32 i = 0; i < sectionNumberCount * 2; i++)
+            out.writeUint32(in.readUint32());
 
-        // We only need to seek in, out is already where it needs to be
         in.seekAlign32();
         out.seekAlign32();
+    }
 
-        if (version == MetroidPrime3 || version == DKCR)
-        {
-            for (atUint32 i = 0; i < sectionNumberCount * 2; i++)
-                out.writeUint32(in.readUint32());
+    // Each block's input and output size is in the header, so every block gets its own
+    // slice of the input and of the output and they can be decompressed independently
+    atUint64 inSize = in.position;
+    atUint64 outSize = out.data.size();
+    for (const CompressedBlockInfo& info : blockInfo)
+    {
+        m_blocks.push_back(SBlock{info.dataSize, info.dataCompSize, inSize, outSize, EBlockState::Compressed});
+        inSize  += blockInputSize(info);
+        outSize += info.dataSize;
+    }
+
+    if (inSize > m_srcLength || outSize > 0xFFFFFFFF)
+        return false;
+
+    // The blocks hold the sections back to back, in order
+    m_sectionOffsets.resize(sectionCount);
+    atUint64 sectionOffset = out.data.size();
+    for (atUint32 i = 0; i < sectionCount; i++)
+    {
+        m_sectionOffsets[i] = sectionOffset;
+        sectionOffset += m_sectionSizes[i];
+    }
+
+    m_length = outSize;
+    m_data = new atUint8[m_length];
+    memcpy(m_data, out.data.data(), out.data.size());
+    return true;
+}
 
-            in.seekAlign32();
-            out.seekAlign32();
+bool CLazyMREA::isValid() const
+{
+    return m_valid;
+}
+
+atUint32 CLazyMREA::length() const
+{
+    return m_length;
+}
+
+atUint32 CLazyMREA::sectionCount() const
+{
+    return m_sectionSizes.size();
+}
+
+atUint32 CLazyMREA::sectionSize(atUint32 section) const
+{
+    return section < m_sectionSizes.size() ? m_sectionSizes[section] : 0;
+}
+
+void CLazyMREA::blocksFor(atUint32 section, std::vector<atUint32>& blocks) const
+{
+    atUint64 start = m_sectionOffsets[section];
+    atUint64 end   = start + m_sectionSizes[section];
+
+    // First block ending past the section's start, then every block starting before its end
+    std::vector<SBlock>::const_iterator iter = std::upper_bound(m_blocks.begin(), m_blocks.end(), start,
+                                                                [](atUint64 offset, const SBlock& block)
+    { return offset < block.outOffset + block.dataSize; });
+
+    for (; iter != m_blocks.end() && iter->outOffset < end; ++iter)
+    {
+        atUint32 index = iter - m_blocks.begin();
+        if (std::find(blocks.begin(), blocks.end(), index) == blocks.end())
+            blocks.push_back(index);
+    }
+}
+
+bool CLazyMREA::loadBlocks(const std::vector<atUint32>& blocks)
+{
+    std::vector<atUint32> pending;
+    atUint64 pendingSize = 0;
+    for (atUint32 block : blocks)
+    {
+        if (m_blocks[block].state == EBlockState::Damaged)
+            return false;
+
+        if (m_blocks[block].state == EBlockState::Compressed)
+        {
+            pending.push_back(block);
+            pendingSize += m_blocks[block].dataSize;
         }
+    }
 
-        for (CompressedBlockInfo info : blockInfo)
-            if (!decompressBlock(info, in, out))
-                return false;
+    auto decompressOne = [&](atUint32 i)
+    {
+        SBlock& block = m_blocks[pending[i]];
+        CompressedBlockInfo info = {0, block.dataSize, block.dataCompSize, 0};
+        bool ok = decompressBlock(info, m_src + block.inOffset, m_data + block.outOffset);
+        block.state = (ok ? EBlockState::Loaded : EBlockState::Damaged);
+    };
+
+    if (pending.size() > 1 && pendingSize >= ParallelDecompressThreshold)
+        CWorkerPool::instance().parallelFor(pending.size(), decompressOne);
+    else
+    {
+        for (atUint32 i = 0; i < pending.size(); i++)
+            decompressOne(i);
     }
-    catch(...)
+
+    for (atUint32 block : pending)
     {
-        return false;
+        if (m_blocks[block].state != EBlockState::Loaded)
+            return false;
     }
 
     return true;
 }
 
-bool decompressBlock(CompressedBlockInfo& info, Athena::io::IStreamReader& in, Athena::io::IStreamWriter& out)
+const atUint8* CLazyMREA::section(atUint32 section)
+{
+    if (!m_valid || section >= m_sectionSizes.size() || m_sectionOffsets[section] + m_sectionSizes[section] > m_length)
+        return nullptr;
+
+    std::vector<atUint32> blocks;
+    blocksFor(section, blocks);
+    if (!loadBlocks(blocks))
+        return nullptr;
+
+    return m_data + m_sectionOffsets[section];
+}
+
+bool CLazyMREA::load(const std::vector<atUint32>& sections)
+{
+    if (!m_valid)
+        return false;
+
+    std::vector<atUint32> blocks;
+    for (atUint32 section : sections)
+    {
+        if (section >= m_sectionSizes.size() || m_sectionOffsets[section] + m_sectionSizes[section] > m_length)
+            return false;
+
+        blocksFor(section, blocks);
+    }
+
+    return loadBlocks(blocks);
+}
+
+bool CLazyMREA::loadAll()
+{
+    if (!m_valid)
+        return false;
+
+    std::vector<atUint32> blocks(m_blocks.size());
+    for (atUint32 i = 0; i < blocks.size(); i++)
+        blocks[i] = i;
+
+    return loadBlocks(blocks);
+}
+
+atUint8* CLazyMREA::release(atUint32& length)
+{
+    if (!m_valid || !m_owned)
+        return nullptr;
+
+    for (const SBlock& block : m_blocks)
+    {
+        if (block.state != EBlockState::Loaded)
+            memset(m_data + block.outOffset, 0, block.dataSize);
+    }
+
+    m_owned = false;
+    length = m_length;
+    return m_data;
+}
+
+atUint8* decompressMREA(const atUint8* srcData, atUint32 srcLength, atUint32& dstLength)
+{
+    CLazyMREA area(srcData, srcLength);
+    if (!area.loadAll())
+        return nullptr;
+
+    return area.release(dstLength);
+}
+
+bool decompressMREA(Athena::io::IStreamReader& in, Athena::io::IStreamWriter& out)
 {
+    atUint8* srcData = nullptr;
+    atUint8* dstData = nullptr;
+    atUint32 dstLength = 0;
+
     try
     {
-        // if dataCompSize is 0 we just write the raw data
-        if (info.dataCompSize == 0)
+        atUint64 srcLength = in.length() - in.position();
+        srcData = in.readUBytes(srcLength);
+        dstData = decompressMREA(srcData, srcLength, dstLength);
+        if (dstData)
         {
-            atUint8* rawData = in.readUBytes(info.dataSize);
-            out.writeUBytes(rawData, info.dataSize);
-            delete[] rawData;
+            out.setEndian(Athena::Endian::BigEndian);
+            out.writeUBytes(dstData, dstLength);
         }
-        else
-        {
-            // We have compressed data, this is a bit tricky since the compression header isn't always located at the start of the data
-            // Retro did something unorthodox, instead of padding the end of the block, they padded the beginning
-            atUint32 blockStart = ROUND_UP_32(info.dataCompSize) - info.dataCompSize;
+    }
+    catch(...)
+    {
+        delete[] dstData;
+        dstData = nullptr;
+    }
+
+    delete[] srcData;
+    bool ret = (dstData != nullptr);
+    delete[] dstData;
+    return ret;
+}
+
+bool decompressBlock(const CompressedBlockInfo& info, const atUint8* in, atUint8* out)
+{
+    // if dataCompSize is 0 we just copy the raw data
+    if (info.dataCompSize == 0)
+    {
+        memcpy(out, in, info.dataSize);
+        return true;
+    }
 
-            atUint8* rawData = in.readUBytes(ROUND_UP_32(info.dataCompSize));
-            atUint8* dataStart = rawData;
-            rawData += blockStart;
+    // We have compressed data, this is a bit tricky since the compression header isn't always located at the start of the data
+    // Retro did something unorthodox, instead of padding the end of the block, they padded the beginning
+    const atUint8* rawData = in + (ROUND_UP_32(info.dataCompSize) - info.dataCompSize);
+    const atUint8* rawEnd  = in + ROUND_UP_32(info.dataCompSize);
 
-            bool result = true;
-            atUint32 decompressedSize = info.dataSize;
-            atInt32 remainingSize = info.dataSize;
+    atUint32 decompressedSize = info.dataSize;
+    atInt32 remainingSize = info.dataSize;
 
-            // We use the blockSize because it's always larger than either size, it's also the behavior observed in the engine.
-            atUint8* newData = new atUint8[info.blockSize];
-            while (remainingSize > 0)
-            {
+    while (remainingSize > 0)
+    {
+        if (rawData + 4 > rawEnd)
+            return false;
+
+        atUint16 segmentSize = *(atUint16*)(rawData);
+        Athena::utility::BigUint16(segmentSize);
+        rawData += 2;
 
-                atUint16 segmentSize = *(atUint16*)(rawData);
-                Athena::utility::BigUint16(segmentSize);
-                rawData += 2;
-
-                atUint16 peek = *(atUint16*)(rawData);
-                Athena::utility::BigUint16(peek);
-                if (peek != 0x78DA && peek != 0x7801 && peek != 0x789C)
-                {
-                    if (segmentSize > 0x4000)
-                    {
-                        // not compressed
-                        memcpy(&newData[decompressedSize - remainingSize], rawData, 0x10000 - segmentSize);
-                        rawData       += 0x10000 - segmentSize;
-                        remainingSize -= 0x10000 - segmentSize;
-                        result = true;
-                        continue;
-                    }
-
-                    int lzoStatus = Athena::io::Compression::decompressLZO(rawData, segmentSize, &newData[decompressedSize - remainingSize], remainingSize);
-
-                    if (!lzoStatus)
-                        result = true;
-                    else
-                    {
-                        result = false;
-                        break;
-                    }
-
-                    rawData += segmentSize;
-                }
-                else
-                {
-
-                    int err = Athena::io::Compression::decompressZlib(rawData, segmentSize, &newData[decompressedSize - remainingSize], decompressedSize);
-
-                    if (err > 0)
-                    {
-                        remainingSize -= err;
-                        result = true;
-                    }
-                    else
-                    {
-                        result = false;
-                        break;
-                    }
-
-                    rawData += segmentSize;
-                }
+        atUint16 peek = *(atUint16*)(rawData);
+        Athena::utility::BigUint16(peek);
+        if (peek != 0x78DA && peek != 0x7801 && peek != 0x789C)
+        {
+            if (segmentSize > 0x4000)
+            {
+                // not compressed
+                atUint32 storedSize = 0x10000 - segmentSize;
+                if ((atInt32)storedSize > remainingSize || rawData + storedSize > rawEnd)
+                    return false;
+
+                memcpy(&out[decompressedSize - remainingSize], rawData, storedSize);
+                rawData       += storedSize;
+                remainingSize -= storedSize;
+                continue;
             }
 
-            if (result)
-                out.writeUBytes(newData, decompressedSize);
+            if (rawData + segmentSize > rawEnd)
+                return false;
+
+            atInt32 written = decompressLZO1X(rawData, segmentSize, &out[decompressedSize - remainingSize], remainingSize);
 
-            delete[] newData;
-            delete[] dataStart;
+            if (written < 0)
+                return false;
+
+            remainingSize -= written;
+
+            rawData += segmentSize;
+        }
+        else
+        {
+            if (rawData + segmentSize > rawEnd)
+                return false;
+
+            // Bounded by what's left of this block, the rest of the buffer belongs to the next one
+            int err = inflateZlib(rawData, segmentSize, &out[decompressedSize - remainingSize], remainingSize);
+
+            if (err <= 0)
+                return false;
+
+            remainingSize -= err;
+            rawData += segmentSize;
         }
-    }
-    catch(...)
-    {
-        return false;
     }
 
     return true;
@@ -1,6 +1,10 @@
 #include "RetroCommon.hpp"
 #include <Athena/Compression.hpp>
 #include <Athena/InvalidDataException.hpp>
+#include "CInflateBackend.hpp"
+#include "CWorkerPool.hpp"
+#include <algorithm>
+#include <vector>
 #include <memory.h>
 
 struct CMPDBlock
@@ -9,99 +13,182 @@ struct CMPDBlock
     atUint32 uncompressedLen;
 };
 
-void decompressData(aIO::IStreamWriter& outbuf,  const atUint8* srcData, atUint32 srcLength, atInt32 uncompressedLength)
+namespace
+{
+// Below this much output a CMPD resource is decompressed on the calling thread, handing
+// the blocks out to the pool costs more than it saves
+const atUint32 ParallelDecompressThreshold = 256 * 1024;
+}
+
+bool decompressCMPDBlock(const atUint8* srcData, atUint32 srcLength, atUint8* dst, atUint32 dstLength)
 {
+    if (srcLength < 2)
+        return false;
+
     atUint16 compressionMethod = *(atUint16*)(srcData);
     Athena::utility::BigUint16(compressionMethod);
     if (compressionMethod == 0x78DA || compressionMethod == 0x7801 || compressionMethod == 0x789C)
+        return inflateZlib(srcData, srcLength, dst, dstLength) == (atInt32)dstLength;
+
+    const atUint8* srcEnd = srcData + srcLength;
+    atInt32 remainingSize = dstLength;
+    while (remainingSize > 0)
     {
-        atUint8*  decompData = new atUint8[uncompressedLength];
-        if (aIO::Compression::decompressZlib(srcData, srcLength,  decompData, uncompressedLength) == uncompressedLength)
-            outbuf.writeUBytes(decompData, uncompressedLength);
-        delete[] decompData;
-    }
-    else
-    {
-        bool result = true;
-        atUint8* newData = new atUint8[uncompressedLength];
-        atInt32 remainingSize = uncompressedLength;
-        do
+        if (srcData + 2 > srcEnd)
+            return false;
+
+        atInt16 segmentSize = *(atInt16*)(srcData);
+        srcData += 2;
+
+        Athena::utility::BigInt16(segmentSize);
+
+        if (segmentSize < 0)
         {
-            if (remainingSize <= 0)
-                break;
-
-            atInt16 segmentSize = *(atInt16*)(srcData);
-            srcData += 2;
-
-            Athena::utility::BigInt16(segmentSize);
-
-            if (segmentSize < 0)
-            {
-                segmentSize = -segmentSize;
-                memcpy(&newData[uncompressedLength - remainingSize], srcData, segmentSize);
-            }
-            else
-            {
-                atInt32 lzoStatus = Athena::io::Compression::decompressLZO((const atUint8*)srcData, segmentSize, &newData[uncompressedLength - remainingSize], remainingSize);
-
-                if ((lzoStatus & 8) != 0)
-                {
-                    result = false;
-                    break;
-                }
-            }
-
-            srcData  += segmentSize;
+            // Stored as is, negated as an atInt32 since -0x8000 doesn't fit an atInt16
+            atInt32 storedSize = -(atInt32)segmentSize;
+            if (storedSize > remainingSize || srcData + storedSize > srcEnd)
+                return false;
+
+            memcpy(&dst[dstLength - remainingSize], srcData, storedSize);
+            remainingSize -= storedSize;
+            srcData       += storedSize;
         }
-        while (remainingSize > 0);
+        else
+        {
+            if (srcData + segmentSize > srcEnd)
+                return false;
 
-        if (result)
-            outbuf.writeUBytes(newData, uncompressedLength);
+            atInt32 written = decompressLZO1X(srcData, segmentSize, &dst[dstLength - remainingSize], remainingSize);
 
-        delete[] newData;
+            if (written < 0)
+                return false;
+
+            remainingSize -= written;
+            srcData       += segmentSize;
+        }
     }
+
+    return true;
 }
 
-void decompressFile(aIO::IStreamWriter& outbuf, const atUint8* data, atUint32 srcLength)
+void decompressData(aIO::IStreamWriter& outbuf,  const atUint8* srcData, atUint32 srcLength, atInt32 uncompressedLength)
+{
+    atUint8* newData = new atUint8[uncompressedLength];
+
+    if (decompressCMPDBlock(srcData, srcLength, newData, uncompressedLength))
+        outbuf.writeUBytes(newData, uncompressedLength);
+
+    delete[] newData;
+}
+
+atUint32 decompressedSize(const atUint8* srcData, atUint32 srcLength)
 {
-    atUint32 magic = *(atUint32*)(data);
+    if (srcLength < 8)
+        return 0;
+
+    atUint32 magic = *(atUint32*)(srcData);
     Athena::utility::BigUint32(magic);
-    if (magic == 0x434D5044)
+    if (magic != 0x434D5044)
+        return magic; // Everything else starts with the decompressed size
+
+    atUint32 blockCount = *(atUint32*)(srcData + 4);
+    Athena::utility::BigUint32(blockCount);
+    if (8 + (atUint64)blockCount * sizeof(CMPDBlock) > srcLength)
+        return 0;
+
+    atUint64 totalLength = 0;
+    for (atUint32 i = 0; i < blockCount; i++)
     {
-        atUint32 currentOffset = 4;
-        atUint32 blockCount = *(atUint32*)(data + currentOffset);
-        currentOffset += 4;
-        Athena::utility::BigUint32(blockCount);
-        CMPDBlock* blocks = new CMPDBlock[blockCount];
-        memcpy(blocks, data + currentOffset, sizeof(CMPDBlock)*blockCount);
-        currentOffset += (sizeof(CMPDBlock)*blockCount);
+        CMPDBlock block;
+        memcpy(&block, srcData + 8 + i * sizeof(CMPDBlock), sizeof(CMPDBlock));
+        Athena::utility::BigUint32(block.uncompressedLen);
+        totalLength += block.uncompressedLen;
+    }
 
-        for (atUint32 i = 0; i < blockCount; i++)
-        {
-            Athena::utility::BigUint32(blocks[i].compressedLen);
-            Athena::utility::BigUint32(blocks[i].uncompressedLen);
+    return totalLength > 0xFFFFFFFF ? 0 : (atUint32)totalLength;
+}
 
-            blocks[i].compressedLen &= 0x00FFFFFF;
+bool decompressInto(const atUint8* srcData, atUint32 srcLength, atUint8* dst, atUint32 dstLength)
+{
+    if (dstLength == 0 || decompressedSize(srcData, srcLength) != dstLength)
+        return false;
 
-            if (blocks[i].compressedLen == blocks[i].uncompressedLen)
-                outbuf.writeUBytes((atUint8*)(data + currentOffset), blocks[i].uncompressedLen);
-            else
-            {
-                decompressData(outbuf, (const atUint8*)(data + currentOffset), blocks[i].compressedLen, blocks[i].uncompressedLen);
-            }
+    atUint32 magic = *(atUint32*)(srcData);
+    Athena::utility::BigUint32(magic);
+    if (magic != 0x434D5044)
+        return decompressCMPDBlock(srcData + 4, srcLength - 4, dst, dstLength);
 
-            currentOffset += blocks[i].compressedLen;
-        }
+    atUint32 blockCount = *(atUint32*)(srcData + 4);
+    Athena::utility::BigUint32(blockCount);
+
+    // Every block's size is in the header, so where each one starts in both the input
+    // and the output is known before anything gets decompressed
+    std::vector<CMPDBlock> blocks(blockCount);
+    std::vector<atUint32> srcOffsets(blockCount);
+    std::vector<atUint32> dstOffsets(blockCount);
+    atUint64 srcOffset = 8 + blockCount * sizeof(CMPDBlock);
+    atUint32 dstOffset = 0;
+    for (atUint32 i = 0; i < blockCount; i++)
+    {
+        memcpy(&blocks[i], srcData + 8 + i * sizeof(CMPDBlock), sizeof(CMPDBlock));
+        Athena::utility::BigUint32(blocks[i].compressedLen);
+        Athena::utility::BigUint32(blocks[i].uncompressedLen);
+
+        blocks[i].compressedLen &= 0x00FFFFFF;
+
+        srcOffsets[i] = srcOffset;
+        dstOffsets[i] = dstOffset;
+        srcOffset += blocks[i].compressedLen;
+        dstOffset += blocks[i].uncompressedLen;
     }
+
+    if (srcOffset > srcLength)
+        return false;
+
+    std::vector<atUint8> blockOk(blockCount, 1);
+    auto decompressOne = [&](atUint32 i)
+    {
+        if (blocks[i].compressedLen == blocks[i].uncompressedLen)
+            memcpy(dst + dstOffsets[i], srcData + srcOffsets[i], blocks[i].uncompressedLen);
+        else
+            blockOk[i] = decompressCMPDBlock(srcData + srcOffsets[i], blocks[i].compressedLen, dst + dstOffsets[i], blocks[i].uncompressedLen);
+    };
+
+    if (blockCount > 1 && dstLength >= ParallelDecompressThreshold)
+        CWorkerPool::instance().parallelFor(blockCount, decompressOne);
     else
     {
-        atUint32 uncompressedLength = *(atUint32*)(data);
-        Athena::utility::BigUint32(uncompressedLength);
-        atUint8* tmp = new atUint8[srcLength];
-        memcpy(tmp, data + 4, srcLength - 4);
-        decompressData(outbuf, (const atUint8*)tmp, srcLength - 4, uncompressedLength);
-        delete[] tmp;
+        for (atUint32 i = 0; i < blockCount; i++)
+            decompressOne(i);
     }
 
+    return std::find(blockOk.begin(), blockOk.end(), 0) == blockOk.end();
+}
+
+atUint8* decompressResource(const atUint8* srcData, atUint32 srcLength, atUint32& dstLength)
+{
+    atUint32 size = decompressedSize(srcData, srcLength);
+    if (size == 0)
+        return nullptr;
+
+    atUint8* ret = new atUint8[size];
+    if (!decompressInto(srcData, srcLength, ret, size))
+    {
+        delete[] ret;
+        return nullptr;
+    }
+
+    dstLength = size;
+    return ret;
+}
+
+void decompressFile(aIO::IStreamWriter& outbuf, const atUint8* data, atUint32 srcLength)
+{
+    atUint32 length = 0;
+    atUint8* decompressed = decompressResource(data, srcLength, length);
+    if (decompressed)
+        outbuf.writeUBytes(decompressed, length);
+
+    delete[] decompressed;
     delete[] data;
 }
@@ -8,8 +8,14 @@
 #include <vector>
 #include <unordered_map>
 #include <memory>
+#include <fstream>
+#include <mutex>
+#include <condition_variable>
 
 #include <CPakFile.hpp>
+#include <CPakTableCache.hpp>
+#include <CDecompressedCache.hpp>
+#include <CCompressedMemoryCache.hpp>
 #include "IResource.hpp"
 
 typedef IResource* (*ResourceDataLoaderCallback)(const atUint8*, atUint64);
@@ -37,11 +43,16 @@ public:
     typedef std::unordered_map<CUniqueID, IResource*, CUniqueIDHash, CUniqueIDComparison>::const_iterator   ConstCachedResourceIterator;
 
     void initialize(const std::string& baseDirectory);
+    void setCacheDirectory(const std::string& cacheDirectory);
+    // Budget for payloads kept LZ4 compressed in memory, what's left of a resource once it's destroyed
+    void setMemoryCacheLimit(atUint64 sizeLimit);
+    bool setAccessTrace(const std::string& tracePath);
     bool addPack(const std::string& pak);
     std::vector<SPakResource*> resourcesForPack(const std::string& pak);
 
-    IResource* loadResource(const CUniqueID& assetID, const std::string& type = std::string());
-    IResource* loadResourceFromPak(CPakFile* pak, const CUniqueID& assetID, const std::string& type = std::string());
+    IResource* loadResource(const CUniqueID& assetID, const CFourCC& type = CFourCC());
+    IResource* loadResourceFromPak(CPakFile* pak, const CUniqueID& assetID, const CFourCC& type = CFourCC());
+    void preloadResources(CPakFile* pak, const std::vector<CUniqueID>& assetIDs);
     void destroyResource(IResource* res);
 
     void registerLoader(const CFourCC& tag, ResourceDataLoaderCallback byData);
@@ -49,7 +60,8 @@ public:
 
     std::vector<CPakTreeWidget*> pakWidgets() const;
 
-    void loadPak(std::string filepath);
+    void loadPak(std::string filepath, atInt32 priority = 0);
+    void loadPaks(std::vector<std::string> filepaths, atInt32 priority = 0);
 
     void clear();
 signals:
@@ -60,13 +72,54 @@ protected:
     CResourceManager& operator =(const CResourceManager&)=delete;
 
 private:
+    // Where an asset can be found, IDs shipped in several paks are chained from the
+    // highest priority pak down, paks with the same priority keep their mount order
+    struct SAssetLocation
+    {
+        CPakFile*           pak;
+        const SPakResource* resource;
+        atInt32             priority;
+        atUint32            next;
+    };
+
+    // Canonical copy of a payload shared by several entries, decoded is the IResource every copy resolves to
+    struct SContentEntry
+    {
+        CPakFile*           pak;
+        const SPakResource* resource;
+        IResource*          decoded;
+    };
+
+    static CPakFile* readPak(const std::string& filepath, const CPakTableCache& tableCache);
+    void mountPak(CPakFile* pak, atInt32 priority);
+    // Adds the pak's payloads to m_contentDirectory, once it has hashes
+    void registerContent(CPakFile* pak);
+    // Hashing reads the whole pak, so paks mounted without hashes get them on the pool instead of at startup
+    void hashInBackground(CPakFile* pak);
+    // Hands the hashes finished since the last call to their paks, called before every load
+    void applyHashes();
+
     std::unordered_map<CFourCC, ResourceLoaderDesc, CFourCCHash, CFourCC_Comparison> m_loaders;
-    IResource* attemptLoad(SPakResource res, CPakFile* pak);
+    IResource* attemptLoad(SPakResource res, CPakFile* pak, atUint8* data = nullptr);
+    // The payload to hand to a loader, decompressed if it comes from one of the caches. Takes ownership of data
+    atUint8* loadPayload(const SPakResource& res, CPakFile* pak, atUint8* data, atUint64& length);
+    CUniqueIDIndex                           m_assetDirectory; // ID -> head of the chain in m_assetLocations
+    std::vector<SAssetLocation>              m_assetLocations;
+    std::unordered_map<atUint64, SContentEntry> m_contentDirectory; // content hash -> canonical entry
+    std::unordered_map<IResource*, std::vector<CUniqueID>> m_resourceAliases; // extra IDs a shared resource is cached under
     std::unordered_map<CUniqueID, IResource*, CUniqueIDHash, CUniqueIDComparison> m_cachedResources;
     std::vector<CPakFile*>                   m_pakFiles;
     std::vector<CPakTreeWidget*>             m_pakTreeWidgets;
     std::vector<CUniqueID>                   m_failedAssets;
     std::string                              m_baseDirectory;
+    std::string                              m_cacheDirectory;
+    std::unique_ptr<CDecompressedCache>      m_payloadCache; // decompressed payloads, in m_cacheDirectory
+    CCompressedMemoryCache                   m_memoryCache;  // the same, LZ4 compressed in memory
+    std::ofstream                            m_accessTrace; // "TAG ID" per resource read from a pak, see CPakFileWriter::loadAccessTrace
+    std::mutex                               m_hashMutex;   // guards m_hashJobs and m_finishedHashes
+    std::condition_variable                  m_hashCondition;
+    atUint32                                 m_hashJobs;    // background hash jobs not finished yet
+    std::vector<std::pair<CPakFile*, std::vector<atUint64>>> m_finishedHashes; // waiting for applyHashes
 };
 
 
@@ -86,6 +86,7 @@ public:
     virtual ~CWorldFile();
 
     std::string areaName(const CUniqueID& assetId, CPakFile* pak = nullptr);
+    std::vector<CUniqueID> areaDependencies(const CUniqueID& mreaID) const;
     IRenderableModel* skyboxModel();
 private:
     friend class CWorldFileReader;
@@ -8,7 +8,7 @@
 
 struct SAreaSectionIndex final
 {
-    std::string tag;
+    CFourCC     tag;
     atUint32    index;
 };
 
@@ -32,6 +32,8 @@ public:
     static IResource* loadByData(const atUint8* data, atUint64 length);
 
 private:
+    // Sections the readers below look at, for compressed areas only their blocks are decompressed
+    std::vector<atUint32> sectionsToLoad(CAreaFile* ret) const;
     void readSections(CAreaFile* ret);
     void readSectionsMP3DKCR(CAreaFile* ret);
     void readModelHeader(CAreaFile*  file, atUint64& sectionStart, atUint32& i);
@@ -27,13 +27,15 @@ signals:
     void resourceChanged(IResource*);
 protected:
     void changeEvent(QEvent *e);
+    void showEvent(QShowEvent* e);
 
 private slots:
     void onItemClicked(QModelIndex idx);
     void onSelectionChanged(QItemSelection, QItemSelection);
 private:
     Ui::CPakTreeWidget *ui;
-    CPakFileModel* m_model;
+    CPakFile*      m_pak;
+    CPakFileModel* m_model; // Created on first show, building it loads every MLVL and area name
     IResource* m_currentResource;
 };
 
@@ -123,8 +123,8 @@ void CPakFileModel::setupModelData()
     std::vector<CWorldFile*> worlds;
     if (m_pakFile->isWorldPak())
     {
-        std::vector<SPakResource> mlvls = m_pakFile->resourcesByType("mlvl");
-        for (SPakResource res : mlvls)
+        CPakResourceSpan mlvls = m_pakFile->resourcesByType("mlvl");
+        for (const SPakResource& res : mlvls)
         {
             CWorldFile* world = dynamic_cast<CWorldFile*>(CResourceManager::instance()->loadResource(res.id, "MLVL"));
             if (world)
@@ -67,5 +67,5 @@ CStructProperty* CStructProperty::structByName(const std::string& name)
 IResource* CAssetProperty::load()
 {
     CAssetPropertyTemplate* assetTemplate = dynamic_cast<CAssetPropertyTemplate*>(m_propertyTemplate);
-    return CResourceManager::instance()->loadResource(m_value, assetTemplate->assetType().toString());
+    return CResourceManager::instance()->loadResource(m_value, assetTemplate->assetType());
 }
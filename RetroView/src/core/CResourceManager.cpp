@@ -3,8 +3,10 @@
 #include "core/GXCommon.hpp"
 
 #include <CPakFileReader.hpp>
+#include <CWorkerPool.hpp>
 #include <iostream>
 #include <algorithm>
+#include <unordered_set>
 #include <Athena/Utility.hpp>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -21,14 +23,20 @@ struct concrete_ResourceManager : public CResourceManager
 }
 
 CResourceManager::CResourceManager()
+    : m_hashJobs(0)
 {
     std::cout << "ResourceManager created" << std::endl;
 }
 
 CResourceManager::~CResourceManager()
 {
-    for (std::pair<CUniqueID, IResource*> res : m_cachedResources)
-        delete res.second;
+    // The hash jobs read the paks, so they have to be done before those go
+    {
+        std::unique_lock<std::mutex> lock(m_hashMutex);
+        m_hashCondition.wait(lock, [this]()->bool{ return m_hashJobs == 0; });
+    }
+
+    clear();
 
     for (CPakFile* pak : m_pakFiles)
         delete pak;
@@ -38,42 +46,103 @@ CResourceManager::~CResourceManager()
     std::cout << "ResourceManager destroyed" << std::endl;
 }
 
-void CResourceManager::loadPak(std::string filepath)
+void CResourceManager::loadPak(std::string filepath, atInt32 priority)
 {
+    loadPaks(std::vector<std::string>(1, filepath), priority);
+}
 
-    std::vector<CPakFile*>::iterator iter = std::find_if(m_pakFiles.begin(), m_pakFiles.end(),
-                                                            [&filepath](const CPakFile* r)->bool{return r->filename() == filepath; });
-
-    if (iter != m_pakFiles.end())
-        return;
+void CResourceManager::loadPaks(std::vector<std::string> filepaths, atInt32 priority)
+{
+    // Skip anything that's already mounted (or listed twice)
+    std::sort(filepaths.begin(), filepaths.end());
+    filepaths.erase(std::unique(filepaths.begin(), filepaths.end()), filepaths.end());
+    filepaths.erase(std::remove_if(filepaths.begin(), filepaths.end(), [this](const std::string& filepath)->bool
+    {
+        return std::find_if(m_pakFiles.begin(), m_pakFiles.end(),
+                            [&filepath](const CPakFile* r)->bool{return r->filename() == filepath; }) != m_pakFiles.end();
+    }), filepaths.end());
+
+    // Parsing the tables only touches the pak itself, so every pak gets its own job
+    CPakTableCache tableCache(m_cacheDirectory);
+    std::vector<CPakFile*> paks(filepaths.size(), nullptr);
+    CWorkerPool::instance().parallelFor(filepaths.size(), [&filepaths, &paks, &tableCache](atUint32 i)
+    {
+        paks[i] = readPak(filepaths[i], tableCache);
+    });
 
-    CPakFile* pak = nullptr;
-    try
+    // Mount in path order so ID overrides don't depend on which job finished first
+    for (atUint32 i = 0; i < paks.size(); i++)
     {
-        CPakFileReader reader(filepath);
-        pak = reader.read();
-        pak->removeDuplicates();
+        std::cout << "Pak " << filepaths[i] << " ...";
+        CPakFile* pak = paks[i];
+        if (pak == nullptr)
+        {
+            std::cout << " failed to load" << std::endl;
+            continue;
+        }
+
+        if (!pak->isMapped())
+            std::cout << " (unmapped)";
+
         m_pakFiles.push_back(pak);
-        CPakTreeWidget* widget = new CPakTreeWidget(pak);
+        mountPak(pak, priority);
+        if (!pak->hasHashes())
+            hashInBackground(pak);
 
+        // Cheap, the tree model is only built once the widget is shown
+        CPakTreeWidget* widget = new CPakTreeWidget(pak);
         m_pakTreeWidgets.push_back(widget);
-
         emit newPak(widget);
 
         std::cout << " loaded" << std::endl;
     }
+}
+
+CPakFile* CResourceManager::readPak(const std::string& filepath, const CPakTableCache& tableCache)
+{
+    CPakFile* pak = nullptr;
+    try
+    {
+        // Cache entries are written after removeDuplicates, and again once hashInBackground is done
+        pak = tableCache.load(filepath);
+        bool fromCache = (pak != nullptr);
+        if (!fromCache)
+        {
+            CPakFileReader reader(filepath);
+            pak = reader.read();
+            pak->removeDuplicates();
+        }
+
+        // Not fatal, loadData falls back to reading the file
+        pak->map();
+
+        if (!fromCache)
+            tableCache.save(pak);
+    }
     catch(...)
     {
         delete pak;
-        std::cout << " failed to load" << std::endl;
+        pak = nullptr;
     }
+
+    return pak;
 }
 
 void CResourceManager::clear()
 {
+    // Shared resources are cached under several IDs, make sure they're only deleted once
+    std::unordered_set<IResource*> resources;
     for (std::pair<CUniqueID, IResource*> res : m_cachedResources)
-        delete res.second;
+        if (res.second)
+            resources.insert(res.second);
+
+    for (IResource* res : resources)
+        delete res;
+
     m_cachedResources.clear();
+    m_resourceAliases.clear();
+    for (std::pair<const atUint64, SContentEntry>& entry : m_contentDirectory)
+        entry.second.decoded = nullptr;
     m_failedAssets.clear();
 }
 
@@ -84,6 +153,7 @@ void CResourceManager::initialize(const std::string& baseDirectory)
     std::cout << "ResourceManager initialized @ " << m_baseDirectory << std::endl;
     std::cout << "Searching for paks..." << std::endl;
 
+    std::vector<std::string> paks;
     DIR* dir = opendir(m_baseDirectory.c_str());
     if (dir)
     {
@@ -101,17 +171,41 @@ void CResourceManager::initialize(const std::string& baseDirectory)
                 Athena::utility::tolower(ext);
                 if (!ext.compare("pak"))
                 {
-                    std::cout << "Found pak " << filename << " ...";
-                    loadPak(filepath);
+                    std::cout << "Found pak " << filename << std::endl;
+                    paks.push_back(filepath);
                 }
             }
         }
         closedir(dir);
     }
+
+    loadPaks(paks);
 }
 
-IResource* CResourceManager::loadResource(const CUniqueID& assetID, const std::string& type)
+void CResourceManager::setCacheDirectory(const std::string& cacheDirectory)
 {
+    m_cacheDirectory = cacheDirectory;
+    m_payloadCache.reset(cacheDirectory.empty() ? nullptr : new CDecompressedCache(cacheDirectory));
+}
+
+void CResourceManager::setMemoryCacheLimit(atUint64 sizeLimit)
+{
+    m_memoryCache.setSizeLimit(sizeLimit);
+}
+
+bool CResourceManager::setAccessTrace(const std::string& tracePath)
+{
+    if (m_accessTrace.is_open())
+        m_accessTrace.close();
+
+    m_accessTrace.open(tracePath, std::ios::out | std::ios::app);
+    return m_accessTrace.is_open();
+}
+
+IResource* CResourceManager::loadResource(const CUniqueID& assetID, const CFourCC& type)
+{
+    applyHashes();
+
     if (assetID == CUniqueID::InvalidAsset)
         return nullptr;
 
@@ -123,18 +217,28 @@ IResource* CResourceManager::loadResource(const CUniqueID& assetID, const std::s
     if (iter != m_cachedResources.end())
         return iter->second;
 
-    for (CPakFile* pak : m_pakFiles)
+    atUint32 location = m_assetDirectory.find(assetID);
+    while (location != CUniqueIDIndex::InvalidEntry)
     {
-        IResource* ret = loadResourceFromPak(pak, assetID, type);
-        if (ret)
-            return ret;
+        const SAssetLocation& loc = m_assetLocations[location];
+        // A copy that fails to load leaves the lookup to the next pak in line
+        if (loc.pak->resource(assetID, type) != nullptr)
+        {
+            IResource* ret = attemptLoad(*loc.resource, loc.pak);
+            if (ret)
+                return ret;
+        }
+
+        location = loc.next;
     }
 
     return nullptr;
 }
 
-IResource* CResourceManager::loadResourceFromPak(CPakFile* pak, const CUniqueID& assetID, const std::string& type)
+IResource* CResourceManager::loadResourceFromPak(CPakFile* pak, const CUniqueID& assetID, const CFourCC& type)
 {
+    applyHashes();
+
     if (assetID == CUniqueID::InvalidAsset)
         return nullptr;
 
@@ -147,23 +251,185 @@ IResource* CResourceManager::loadResourceFromPak(CPakFile* pak, const CUniqueID&
     if (res != nullptr)
         return res;
 
-    std::vector<SPakResource> pakResources;
-    if (!type.empty())
-        pakResources = pak->resourcesByType(type);
-    else
-        pakResources = pak->resources();
-
-    std::vector<SPakResource>::iterator iter = std::find_if(pakResources.begin(), pakResources.end(),
-                                                            [&assetID](const SPakResource& r)->bool{return r.id == assetID; });
-    if (iter != pakResources.end())
-        return attemptLoad(*iter, pak);
+    const SPakResource* pakResource = pak->resource(assetID, type);
+    if (pakResource != nullptr)
+        return attemptLoad(*pakResource, pak);
 
     return nullptr;
 }
 
+void CResourceManager::preloadResources(CPakFile* pak, const std::vector<CUniqueID>& assetIDs)
+{
+    applyHashes();
+
+    // Only bother reading what would actually get decoded
+    std::vector<CUniqueID> pending;
+    std::vector<SPakResource> resources;
+    for (const CUniqueID& id : assetIDs)
+    {
+        if (id == CUniqueID::InvalidAsset || m_cachedResources.find(id) != m_cachedResources.end())
+            continue;
+        if (std::find(m_failedAssets.begin(), m_failedAssets.end(), id) != m_failedAssets.end())
+            continue;
+
+        const SPakResource* res = pak->resource(id);
+        if (res == nullptr || m_loaders.find(res->tag) == m_loaders.end())
+            continue;
+        if (std::find(pending.begin(), pending.end(), id) != pending.end())
+            continue;
+
+        pending.push_back(id);
+        resources.push_back(*res);
+    }
+
+    if (pending.empty())
+        return;
+
+    // One pass over the pak in file order instead of a seek per dependency
+    std::vector<atUint8*> data = pak->loadBatch(pending);
+    for (atUint32 i = 0; i < pending.size(); i++)
+    {
+        if (data[i] && m_cachedResources.find(pending[i]) == m_cachedResources.end())
+            attemptLoad(resources[i], pak, data[i]);
+        else
+            delete[] data[i];
+    }
+}
+
+void CResourceManager::mountPak(CPakFile* pak, atInt32 priority)
+{
+    const std::vector<SPakResource>& resources = pak->resources();
+    m_assetDirectory.reserve(m_assetDirectory.size() + resources.size());
+    m_assetLocations.reserve(m_assetLocations.size() + resources.size());
+
+    for (const SPakResource& res : resources)
+    {
+        // Only the copy the pak itself resolves to gets an entry
+        if (pak->resource(res.id) != &res)
+            continue;
+
+        SAssetLocation loc;
+        loc.pak      = pak;
+        loc.resource = &res;
+        loc.priority = priority;
+        loc.next     = CUniqueIDIndex::InvalidEntry;
+
+        atUint32 newLocation = m_assetLocations.size();
+        atUint32 head = m_assetDirectory.find(res.id);
+        if (head == CUniqueIDIndex::InvalidEntry)
+        {
+            m_assetLocations.push_back(loc);
+            m_assetDirectory.insert(res.id, newLocation);
+        }
+        else if (priority > m_assetLocations[head].priority)
+        {
+            // Overrides the current head, the directory keeps pointing at the head slot so move the old head out of it
+            m_assetLocations.push_back(m_assetLocations[head]);
+            loc.next = newLocation;
+            m_assetLocations[head] = loc;
+        }
+        else
+        {
+            atUint32 prev = head;
+            while (m_assetLocations[prev].next != CUniqueIDIndex::InvalidEntry &&
+                   m_assetLocations[m_assetLocations[prev].next].priority >= priority)
+                prev = m_assetLocations[prev].next;
+
+            loc.next = m_assetLocations[prev].next;
+            m_assetLocations.push_back(loc);
+            m_assetLocations[prev].next = newLocation;
+        }
+
+    }
+
+    if (pak->hasHashes())
+        registerContent(pak);
+}
+
+void CResourceManager::registerContent(CPakFile* pak)
+{
+    // The first copy of a payload to be registered becomes its canonical entry
+    for (const SPakResource& res : pak->resources())
+    {
+        if (pak->resource(res.id) != &res || res.hash == 0 || m_contentDirectory.find(res.hash) != m_contentDirectory.end())
+            continue;
+
+        SContentEntry entry;
+        entry.pak      = pak;
+        entry.resource = &res;
+        entry.decoded  = nullptr;
+        m_contentDirectory[res.hash] = entry;
+    }
+}
+
+void CResourceManager::hashInBackground(CPakFile* pak)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_hashMutex);
+        m_hashJobs++;
+    }
+
+    // contentHashes leaves the pak alone, the hashes are only set on the GUI thread by applyHashes
+    CWorkerPool::instance().enqueue([this, pak]()
+    {
+        std::vector<atUint64> hashes;
+        try
+        {
+            hashes = pak->contentHashes();
+        }
+        catch(const Athena::error::Exception&)
+        {
+        }
+
+        std::lock_guard<std::mutex> lock(m_hashMutex);
+        if (!hashes.empty())
+            m_finishedHashes.push_back(std::make_pair(pak, std::move(hashes)));
+        m_hashJobs--;
+        m_hashCondition.notify_all();
+    });
+}
+
+void CResourceManager::applyHashes()
+{
+    std::vector<std::pair<CPakFile*, std::vector<atUint64>>> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_hashMutex);
+        finished.swap(m_finishedHashes);
+    }
+
+    if (finished.empty())
+        return;
+
+    CPakTableCache tableCache(m_cacheDirectory);
+    for (std::pair<CPakFile*, std::vector<atUint64>>& result : finished)
+    {
+        result.first->setHashes(result.second);
+        registerContent(result.first);
+        // So the next start finds them in the table cache
+        tableCache.save(result.first);
+    }
+}
+
 void CResourceManager::destroyResource(IResource* res)
 {
     m_cachedResources.erase(res->assetId());
+
+    std::unordered_map<IResource*, std::vector<CUniqueID>>::iterator aliases = m_resourceAliases.find(res);
+    if (aliases != m_resourceAliases.end())
+    {
+        for (const CUniqueID& id : aliases->second)
+            m_cachedResources.erase(id);
+        m_resourceAliases.erase(aliases);
+    }
+
+    const SPakResource* pakResource = res->source() ? res->source()->resource(res->assetId()) : nullptr;
+    if (pakResource && pakResource->hash != 0)
+    {
+        std::unordered_map<atUint64, SContentEntry>::iterator entry = m_contentDirectory.find(pakResource->hash);
+        if (entry != m_contentDirectory.end() && entry->second.decoded == res)
+            entry->second.decoded = nullptr;
+    }
+
     delete res;
 }
 
@@ -179,25 +445,54 @@ std::vector<CPakTreeWidget*> CResourceManager::pakWidgets() const
     return m_pakTreeWidgets;
 }
 
-IResource* CResourceManager::attemptLoad(SPakResource res, CPakFile* pak)
+IResource* CResourceManager::attemptLoad(SPakResource res, CPakFile* pak, atUint8* data)
 {
+    // data is the resource as stored if the caller already read it, we own it either way
     if (m_loaders.find(res.tag) == m_loaders.end())
+    {
+        delete[] data;
         return nullptr;
+    }
+
+    // Identical payloads decode to identical resources, so share whatever was decoded first
+    SContentEntry* content = nullptr;
+    if (res.hash != 0)
+    {
+        std::unordered_map<atUint64, SContentEntry>::iterator entry = m_contentDirectory.find(res.hash);
+        if (entry != m_contentDirectory.end() && entry->second.resource->tag == res.tag &&
+                entry->second.resource->size == res.size && entry->second.resource->compressed == res.compressed)
+            content = &entry->second;
+    }
+
+    if (content && content->decoded)
+    {
+        delete[] data;
+        m_cachedResources[res.id] = content->decoded;
+        if (content->decoded->assetId() != res.id)
+            m_resourceAliases[content->decoded].push_back(res.id);
+        return content->decoded;
+    }
 
-    atUint8* data = pak->loadData(res.id, res.tag.toString());
+    atUint64 length = 0;
+    data = loadPayload(res, pak, data, length);
     if (data == nullptr)
         return nullptr;
 
+    if (m_accessTrace.is_open())
+        m_accessTrace << res.tag.toString() << " " << res.id.toString() << "\n";
+
     IResource* ret = nullptr;
     try
     {
-        ret = m_loaders[res.tag].byData(data, res.size);
+        ret = m_loaders[res.tag].byData(data, length);
         if (ret)
         {
             ret->m_assetType = res.tag;
             ret->m_assetID = res.id;
             ret->m_source = pak;
             m_cachedResources[res.id] = ret;
+            if (content)
+                content->decoded = ret;
         }
     }
     catch(const Athena::error::Exception& e)
@@ -211,6 +506,61 @@ IResource* CResourceManager::attemptLoad(SPakResource res, CPakFile* pak)
     return ret;
 }
 
+atUint8* CResourceManager::loadPayload(const SPakResource& res, CPakFile* pak, atUint8* data, atUint64& length)
+{
+    // Decompressing the same payloads over and over adds up and the loaders take decompressed data just as well.
+    // Payloads come out of memory first, then the on-disk cache and only then the pak itself. Only the pak's
+    // compression is undone here, CAreaReader inflates the MREA blocks it actually needs itself
+    bool cacheable = res.hash != 0 && CDecompressedCache::isCacheable(res);
+    if (cacheable)
+    {
+        atUint32 cachedLength = 0;
+        atUint8* cachedData = m_memoryCache.find(res.hash, res.size, cachedLength);
+        if (cachedData)
+        {
+            delete[] data;
+            length = cachedLength;
+            return cachedData;
+        }
+    }
+
+    std::shared_ptr<CMappedFile> cached;
+    if (cacheable && m_payloadCache)
+        cached = m_payloadCache->find(res.hash, res.size);
+
+    length = res.size;
+    if (cached)
+    {
+        // The loaders take ownership, so they get a copy of the mapping
+        delete[] data;
+        length = cached->size();
+        data = new atUint8[length];
+        memcpy(data, cached->data(), length);
+    }
+    else
+    {
+        if (data == nullptr)
+            data = pak->loadData(res.id, res.tag);
+        if (data == nullptr || !cacheable)
+            return data;
+
+        atUint32 decompressedLength = 0;
+        atUint8* decompressed = CPakFile::decompressPayload(res, data, decompressedLength, false);
+        if (!decompressed)
+            return data; // let the loader deal with it
+
+        if (m_payloadCache)
+            m_payloadCache->store(res.hash, res.size, decompressed, decompressedLength);
+
+        delete[] data;
+        data   = decompressed;
+        length = decompressedLength;
+    }
+
+    m_memoryCache.store(res.hash, res.size, data, length);
+    return data;
+}
+
 void CResourceManager::registerLoader(const CFourCC& tag, ResourceDataLoaderCallback byData)
 {
     if (m_loaders.find(tag) != m_loaders.end())
@@ -24,6 +24,8 @@ IResource* CTexture::loadByData(const atUint8* data, atUint64 length)
     try
     {
         TextureReader reader(data, length);
+        // Big textures are decoded on the worker pool, the viewer waits on them
+        reader.setParallelDecode(true);
         tex = reader.read();
         ret = new CTexture(tex);
     }
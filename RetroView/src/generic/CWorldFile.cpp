@@ -44,6 +44,23 @@ std::string CWorldFile::areaName(const CUniqueID& assetId, CPakFile* pak)
     return std::string();
 }
 
+std::vector<CUniqueID> CWorldFile::areaDependencies(const CUniqueID& mreaID) const
+{
+    std::vector<CUniqueID> ret;
+    for (const SWorldArea& area : m_areas)
+    {
+        if (area.mreaID != mreaID)
+            continue;
+
+        // MP3 and DKCR keep these in the MREA itself, so they come back empty
+        for (const SDependency& dep : area.dependencies.dependencies())
+            ret.push_back(dep.id);
+        break;
+    }
+
+    return ret;
+}
+
 IRenderableModel* CWorldFile::skyboxModel()
 {
     return dynamic_cast<IRenderableModel*>(CResourceManager::instance()->loadResourceFromPak(m_source, m_skyboxID, "CMDL"));
@@ -29,11 +29,13 @@ CAnimCharacterSet* CAnimCharacterSetReader::read()
 
     if (unk1 != 1 || unk2 != 1)
     {
-        Athena::io::MemoryWriter tmp;
-        decompressFile(tmp, base::data(), base::length());
+        atUint32 decompressedLength = 0;
+        atUint8* decompressed = decompressResource(base::m_data, base::m_length, decompressedLength);
 
-        if (tmp.length() > 0x10)
-            base::setData(tmp.data(), tmp.length());
+        if (decompressed && decompressedLength > 0x10)
+            base::setData(decompressed, decompressedLength);
+        else
+            delete[] decompressed;
 
         unk1 = base::readUint16();
         unk2 = base::readUint16();
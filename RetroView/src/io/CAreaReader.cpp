@@ -5,11 +5,13 @@
 #include "core/GXCommon.hpp"
 
 #include <RetroCommon.hpp>
+#include <CLazyMREA.hpp>
 #include <Athena/MemoryWriter.hpp>
 #include <Athena/InvalidDataException.hpp>
 
 #include <algorithm>
 #include <map>
+#include <memory>
 #include <glm/glm.hpp>
 
 CAreaReader::CAreaReader(const atUint8 *data, atUint64 length)
@@ -32,11 +34,22 @@ CAreaReader::~CAreaReader()
 
 CAreaFile* CAreaReader::read()
 {
+    // Compressed areas only get their header decompressed here, the blocks holding the
+    // sections read below are decompressed once the header says which ones those are
+    std::unique_ptr<atUint8[]> compressed;
+    std::unique_ptr<CLazyMREA> area(new CLazyMREA(base::m_data, base::m_length));
+    if (area->isValid())
     {
-        Athena::io::MemoryWriter out;
-        if (decompressMREA(*this, out))
-            setData(out.data(), out.length());
+        // The area keeps reading from the compressed data, so it can't be freed by setData
+        compressed.reset(base::m_data);
+        base::m_data = nullptr;
+
+        atUint32 decompressedLength = 0;
+        atUint8* decompressed = area->release(decompressedLength);
+        setData(decompressed, decompressedLength);
     }
+    else
+        area.reset();
 
     seek(0, Athena::SeekOrigin::Begin);
 
@@ -123,15 +136,22 @@ CAreaFile* CAreaReader::read()
         m_sectionIndices.resize(sectionIndexCount);
         for (atUint32 i = 0; i < sectionIndexCount; i++)
         {
-            atUint32 tmp = base::readUint32();
-            Athena::utility::BigUint32(tmp);
-            m_sectionIndices[i].tag = std::string(((char*)&tmp), 4);
+            m_sectionIndices[i].tag = CFourCC((long)base::readUint32());
             m_sectionIndices[i].index = base::readUint32();
         }
     }
 
     base::seekAlign32();
 
+    if (area && !area->load(sectionsToLoad(ret)))
+    {
+        delete ret;
+        THROW_INVALID_DATA_EXCEPTION("Damaged compressed block in MREA\n");
+    }
+
+    area.reset();
+    compressed.reset();
+
     m_modelMeshOffsets.resize(modelCount);
 
     if (version == CAreaFile::MetroidPrime3 || version == CAreaFile::DKCR)
@@ -147,6 +167,51 @@ IResource* CAreaReader::loadByData(const atUint8* data, atUint64 length)
     return CAreaReader(data, length).read();
 }
 
+std::vector<atUint32> CAreaReader::sectionsToLoad(CAreaFile* ret) const
+{
+    // Materials and geometry come before the first indexed section, after that every
+    // section belongs to the indexed section in front of it
+    std::vector<std::pair<atUint32, bool>> indexed;
+    if (ret->m_version == CAreaFile::MetroidPrime3 || ret->m_version == CAreaFile::DKCR)
+    {
+        for (const SAreaSectionIndex& index : m_sectionIndices)
+            indexed.push_back(std::make_pair(index.index, index.tag == "AABB" || index.tag == "GPUD"));
+    }
+    else
+    {
+        // Only Metroid Prime's SCLY is read, MP1 areas are never compressed though
+        indexed.push_back(std::make_pair(m_sclySection, ret->m_version == CAreaFile::MetroidPrime1));
+        indexed.push_back(std::make_pair(m_collisionSection, false));
+        indexed.push_back(std::make_pair(m_unknownSection, false));
+        indexed.push_back(std::make_pair(m_lightSection, false));
+        indexed.push_back(std::make_pair(m_visiSection, false));
+        indexed.push_back(std::make_pair(m_pathSection, false));
+        indexed.push_back(std::make_pair(m_arotSection, true));
+        if (ret->m_version == CAreaFile::MetroidPrime2)
+        {
+            indexed.push_back(std::make_pair(m_scgnSection, false));
+            indexed.push_back(std::make_pair(m_ptlaSection, false));
+            indexed.push_back(std::make_pair(m_egmcSection, false));
+        }
+    }
+
+    std::sort(indexed.begin(), indexed.end());
+
+    std::vector<atUint32> sections;
+    atUint32 next = 0;
+    bool used = true;
+    for (atUint32 i = 0; i < m_sectionSizes.size(); i++)
+    {
+        while (next < indexed.size() && indexed[next].first <= i)
+            used = indexed[next++].second;
+
+        if (used)
+            sections.push_back(i);
+    }
+
+    return sections;
+}
+
 void CAreaReader::readSections(CAreaFile* ret)
 {
     m_sectionReader.setEndian(endian());
@@ -215,13 +280,13 @@ void CAreaReader::readSectionsMP3DKCR(CAreaFile* ret)
             if (iter != m_sectionIndices.end())
             {
                 SAreaSectionIndex idx = *iter;
-                if (!idx.tag.compare("AABB"))
+                if (idx.tag == "AABB")
                 {
                     atUint8* data = base::readUBytes(m_sectionSizes[i]);
                     m_sectionReader.setData(data, m_sectionSizes[i]);
                     readAABB(ret, m_sectionReader);
                 }
-                else if (!idx.tag.compare("GPUD"))
+                else if (idx.tag == "GPUD")
                 {
                     for (atUint32 m = 0; m < ret->m_models.size(); m++)
                     {
@@ -41,11 +41,13 @@ CModelFile* CModelReader::read()
 
     if (magic != 0xDEADBABE)
     {
-        Athena::io::MemoryWriter tmp;
-        decompressFile(tmp, base::data(), base::length());
+        atUint32 decompressedLength = 0;
+        atUint8* decompressed = decompressResource(base::m_data, base::m_length, decompressedLength);
 
-        if (tmp.length() > 0x10)
-            base::setData(tmp.data(), tmp.length());
+        if (decompressed && decompressedLength > 0x10)
+            base::setData(decompressed, decompressedLength);
+        else
+            delete[] decompressed;
 
         magic = base::readUint32();
     }
@@ -30,11 +30,11 @@ CStringTable* CStringTableReader::read()
         if (magic != 0x87654321)
         {
             // not an STRG file? Try to decompress
-            Athena::io::MemoryWriter tmp;
-            decompressFile(tmp, base::data(), base::length());
+            atUint32 decompressedLength = 0;
+            atUint8* decompressed = decompressResource(base::m_data, base::m_length, decompressedLength);
 
-            if (tmp.length() > 0)
-                base::setData(tmp.data(), tmp.length());
+            if (decompressed)
+                base::setData(decompressed, decompressedLength);
 
             magic = base::readUint32();
         }
@@ -1,5 +1,6 @@
 #include "ui/CMainWindow.hpp"
 #include "core/CTemplateManager.hpp"
+#include "core/CResourceManager.hpp"
 #include <QApplication>
 #include <QSurfaceFormat>
 #include <QMessageBox>
@@ -87,6 +88,20 @@ int main(int argc, char *argv[])
         std::cout << homeDir.absolutePath().toStdString() << std::endl;
         CTemplateManager::instance()->initialize(homeDir.absolutePath().toStdString());
     }
+    QString cacheLocation = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (!cacheLocation.isEmpty() && QDir().mkpath(cacheLocation))
+        CResourceManager::instance()->setCacheDirectory(cacheLocation.toStdString());
+
+    // Keep less (or more) of what's been loaded around in memory, LZ4 compressed
+    QByteArray memoryCacheLimit = qgetenv("RETROVIEW_MEMORY_CACHE_MB");
+    if (!memoryCacheLimit.isEmpty())
+        CResourceManager::instance()->setMemoryCacheLimit(memoryCacheLimit.toULongLong() * 1024 * 1024);
+
+    // Record the order resources get loaded in, pakrepack can lay a pak out to match it
+    QByteArray accessTrace = qgetenv("RETROVIEW_ACCESS_TRACE");
+    if (!accessTrace.isEmpty())
+        CResourceManager::instance()->setAccessTrace(accessTrace.toStdString());
+
     QSurfaceFormat fmt = QSurfaceFormat::defaultFormat();
     fmt.setDepthBufferSize(24);
     fmt.setMajorVersion(3);
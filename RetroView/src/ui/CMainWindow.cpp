@@ -153,8 +153,11 @@ void CMainWindow::onLoadPak()
     if (files.count() == 0)
         return;
 
+    std::vector<std::string> paks;
     foreach(QString file, files)
-        resourceManager->loadPak(file.toStdString());
+        paks.push_back(file.toStdString());
+
+    resourceManager->loadPaks(paks);
 }
 
 void CMainWindow::onTabChanged()
@@ -171,7 +174,7 @@ void CMainWindow::onTabChanged()
     if (ptw && ptw->pak()->isWorldPak())
     {
         m_currentTab = ptw;
-        std::vector<SPakResource> res = m_currentTab->pak()->resourcesByType("mlvl");
+        CPakResourceSpan res = m_currentTab->pak()->resourcesByType("mlvl");
         CWorldFile* world = nullptr;
         if (res.size() > 0)
             world = dynamic_cast<CWorldFile*>(CResourceManager::instance()->loadResourceFromPak(ptw->pak(), res.at(0).id, "MLVL"));
@@ -3,21 +3,21 @@
 #include "core/CPakFileModel.hpp"
 #include "core/CResourceManager.hpp"
 #include "core/IRenderableModel.hpp"
+#include "generic/CWorldFile.hpp"
 #include "ui/CGLViewer.hpp"
 
 #include <CPakFile.hpp>
+#include <QShowEvent>
 #include <iostream>
 
 CPakTreeWidget::CPakTreeWidget(CPakFile* pak, QWidget *parent) :
     QWidget(parent),
     ui(new Ui::CPakTreeWidget),
-    m_model(new CPakFileModel(pak)),
+    m_pak(pak),
+    m_model(nullptr),
     m_currentResource(nullptr)
 {
     ui->setupUi(this);
-    ui->treeView->setModel(m_model);
-    QItemSelectionModel* selectionModel = ui->treeView->selectionModel();
-    connect(selectionModel, SIGNAL(selectionChanged(QItemSelection,QItemSelection)), this, SLOT(onSelectionChanged(QItemSelection,QItemSelection)));
 }
 
 CPakTreeWidget::~CPakTreeWidget()
@@ -27,12 +27,12 @@ CPakTreeWidget::~CPakTreeWidget()
 
 QString CPakTreeWidget::filepath() const
 {
-    return m_model->filepath();
+    return QString::fromStdString(m_pak->filename());
 }
 
 CPakFile* CPakTreeWidget::pak() const
 {
-    return m_model->pak();
+    return m_pak;
 }
 
 void CPakTreeWidget::clearCurrent()
@@ -54,13 +54,45 @@ void CPakTreeWidget::changeEvent(QEvent *e)
     }
 }
 
+void CPakTreeWidget::showEvent(QShowEvent* e)
+{
+    if (m_model == nullptr)
+    {
+        m_model = new CPakFileModel(m_pak, this);
+        ui->treeView->setModel(m_model);
+        QItemSelectionModel* selectionModel = ui->treeView->selectionModel();
+        connect(selectionModel, SIGNAL(selectionChanged(QItemSelection,QItemSelection)), this, SLOT(onSelectionChanged(QItemSelection,QItemSelection)));
+    }
+
+    QWidget::showEvent(e);
+}
+
 void CPakTreeWidget::onItemClicked(QModelIndex idx)
 {
     CResourceTreeItem* item = static_cast<CResourceTreeItem*>(idx.internalPointer());
     if (item)
     {
         //CResourceManager::instance()->clear();
-        m_currentResource = CResourceManager::instance()->loadResourceFromPak(m_model->pak(), item->assetID());
+        const SPakResource* res = m_pak->resource(item->assetID());
+        if (res && res->tag == "MREA")
+        {
+            // Pull the area's dependencies in with one batched read before the area loads them one by one
+            for (const SPakResource& mlvl : m_pak->resourcesByType("MLVL"))
+            {
+                CWorldFile* world = dynamic_cast<CWorldFile*>(CResourceManager::instance()->loadResourceFromPak(m_pak, mlvl.id, "MLVL"));
+                if (!world)
+                    continue;
+
+                std::vector<CUniqueID> dependencies = world->areaDependencies(item->assetID());
+                if (!dependencies.empty())
+                {
+                    CResourceManager::instance()->preloadResources(m_pak, dependencies);
+                    break;
+                }
+            }
+        }
+
+        m_currentResource = CResourceManager::instance()->loadResourceFromPak(m_pak, item->assetID());
         emit resourceChanged(m_currentResource);
     }
 }
@@ -6,10 +6,13 @@ INCLUDEPATH += $$PWD/include $$PWD/Externals/pngpp/include
 
 SOURCES += \
     $$PWD/src/Texture.cpp \
-    $$PWD/src/TextureReader.cpp
+    $$PWD/src/TextureReader.cpp \
+    $$PWD/src/GXTexelKernels.cpp
 
 HEADERS += \
     $$PWD/include/Texture.hpp \
     $$PWD/include/TextureReader.hpp \
+    $$PWD/include/GXTileDecoder.hpp \
+    $$PWD/include/GXTexelKernels.hpp \
     $$PWD/include/dds.h
 
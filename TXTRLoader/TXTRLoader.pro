@@ -5,6 +5,7 @@ TARGET = mptexconv
 
 include(../Athena/AthenaCore.pri)
 include(../RetroCommon/RetroCommon.pri)
+include(../PakLib/PakLib.pri)
 
 win32:LIBS += -L$$PWD/Externals/squish/lib
 
@@ -16,10 +17,13 @@ win32:INCLUDEPATH += $$PWD/Externals/squish/include
 SOURCES += \
     $$PWD/src/Texture.cpp \
     $$PWD/src/TextureReader.cpp \
+    $$PWD/src/GXTexelKernels.cpp \
     $$PWD/src/main.cpp
 
 HEADERS += \
     $$PWD/include/Texture.hpp \
     $$PWD/include/TextureReader.hpp \
+    $$PWD/include/GXTileDecoder.hpp \
+    $$PWD/include/GXTexelKernels.hpp \
     $$PWD/include/dds.h
 
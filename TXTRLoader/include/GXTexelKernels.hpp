@@ -0,0 +1,47 @@
+#ifndef GXTEXELKERNELS_HPP
+#define GXTEXELKERNELS_HPP
+
+#include <Athena/Types.hpp>
+#include <string>
+#include <vector>
+
+// Expands one whole tile of a GX format to its output format, row y of the tile going to
+// dst + y * pitch. Every row is written in one go, texels keep their natural output size
+typedef void (*GXTileKernel)(const atUint8* tile, atUint8* dst, atUint32 pitch);
+// The same for the paletted formats, lut is the palette after expandGXPalette. Lookups of
+// 2 byte entries read 4 bytes, so those palettes need 2 bytes of padding at the end
+typedef void (*GXPaletteTileKernel)(const atUint8* tile, const atUint8* lut, atUint8* dst, atUint32 pitch);
+
+/*!
+ * \brief The tile kernels for one instruction set.
+ *
+ * The SIMD sets expand 8 to 16 texels per instruction and give the same bytes as the scalar
+ * expanders in GXTileDecoder.hpp. Formats a set has nothing faster for point at the next best.
+ */
+struct SGXTileKernels
+{
+    const char*  name;
+    GXTileKernel i4;     // 8x8 tile
+    GXTileKernel i8;     // 8x4 tile
+    GXTileKernel ia4;    // 8x4 tile
+    GXTileKernel ia8;    // 4x4 tile
+    GXTileKernel rgb565; // 4x4 tile
+    GXTileKernel rgb5a3; // 4x4 tile
+    GXTileKernel rgba8;  // 4x4 tile, the AR plane followed by the GB plane
+    GXTileKernel cmpr;   // 2x2 DXT1 blocks
+
+    GXPaletteTileKernel c4RGBA8;  // 8x8 tile, IA8 or RGB5A3 palette
+    GXPaletteTileKernel c8RGBA8;  // 8x4 tile, IA8 or RGB5A3 palette
+    GXPaletteTileKernel c4RGB565; // 8x8 tile
+    GXPaletteTileKernel c8RGB565; // 8x4 tile
+};
+
+// Every set this CPU can run, from slowest to fastest. "scalar" is always the first one
+const std::vector<const SGXTileKernels*>& gxTileKernelSets();
+
+// Defaults to the fastest set, RETRO_TEXEL_KERNELS=<name> overrides that
+const SGXTileKernels& gxTileKernels();
+// Returns false and keeps the current set if there's none called name
+bool selectGXTileKernels(const std::string& name);
+
+#endif // GXTEXELKERNELS_HPP
@@ -0,0 +1,313 @@
+#ifndef GXTILEDECODER_HPP
+#define GXTILEDECODER_HPP
+
+#include <Athena/Types.hpp>
+#include <algorithm>
+#include <memory.h>
+
+// GX textures are stored as tiles of BlockWidth x BlockHeight texels. decodeGXTiles walks a
+// mip level tile by tile and hands each tile to a tile decoder, which writes its rows straight
+// into the output. That's either an expander run texel by texel (a pair of them for 4 bit
+// formats) through SGXExpandTile, or one of the GXTexelKernels. The layout is a template
+// parameter, so the inner loop has no stream seeks or format switch left in it.
+
+inline atUint8 extend3To8(atUint8 in)
+{
+    in &= 0x7;
+    return (in << 5) | (in << 2) | (in >> 1);
+}
+
+inline atUint8 extend4To8(atUint8 in)
+{
+    in &= 0xF;
+    return (in << 4) | in;
+}
+
+inline atUint8 extend5To8(atUint8 in)
+{
+    in &= 0x1F;
+    return (in << 3) | (in >> 2);
+}
+
+inline atUint8 extend6To8(atUint8 in)
+{
+    in &= 0x3F;
+    return (in << 2) | (in >> 4);
+}
+
+inline void writeLittle32(atUint8* out, atUint32 v)
+{
+    out[0] = v;
+    out[1] = v >> 8;
+    out[2] = v >> 16;
+    out[3] = v >> 24;
+}
+
+// Expanders turn step number step of a tile into OutBytes bytes at out. A step is one texel,
+// or two for the 4 bit formats, in the order they're stored in
+
+struct SGXExpandI4
+{
+    static const atUint32 OutBytes = 8;
+    void operator()(const atUint8* tile, atUint32 step, atUint8* out) const
+    {
+        atUint8 px = tile[step];
+        memset(out, extend4To8(px >> 4), 4);
+        memset(out + 4, extend4To8(px), 4);
+    }
+};
+
+struct SGXExpandI8
+{
+    static const atUint32 OutBytes = 4;
+    void operator()(const atUint8* tile, atUint32 step, atUint8* out) const
+    {
+        memset(out, tile[step], 4);
+    }
+};
+
+struct SGXExpandIA4
+{
+    static const atUint32 OutBytes = 4;
+    void operator()(const atUint8* tile, atUint32 step, atUint8* out) const
+    {
+        atUint8 b = tile[step];
+        atUint8 l = extend4To8(b);
+        out[0] = l;
+        out[1] = l;
+        out[2] = l;
+        out[3] = extend4To8(b >> 4);
+    }
+};
+
+struct SGXExpandIA8
+{
+    static const atUint32 OutBytes = 4;
+    void operator()(const atUint8* tile, atUint32 step, atUint8* out) const
+    {
+        const atUint8* px = tile + step * 2;
+        out[0] = px[1];
+        out[1] = px[1];
+        out[2] = px[1];
+        out[3] = px[0];
+    }
+};
+
+struct SGXExpandRGB565
+{
+    static const atUint32 OutBytes = 2;
+    void operator()(const atUint8* tile, atUint32 step, atUint8* out) const
+    {
+        // Stays RGB565, just little endian
+        const atUint8* px = tile + step * 2;
+        out[0] = px[1];
+        out[1] = px[0];
+    }
+};
+
+struct SGXExpandRGB5A3
+{
+    static const atUint32 OutBytes = 4;
+    void operator()(const atUint8* tile, atUint32 step, atUint8* out) const
+    {
+        atUint16 px = (tile[step * 2] << 8) | tile[step * 2 + 1];
+        atUint8 r, g, b, a;
+        if (px & 0x8000) // RGB5
+        {
+            b = extend5To8(px >> 10);
+            g = extend5To8(px >>  5);
+            r = extend5To8(px >>  0);
+            a = 0xFF;
+        }
+        else // RGB4A3
+        {
+            a = extend3To8(px >> 12);
+            b = extend4To8(px >>  8);
+            g = extend4To8(px >>  4);
+            r = extend4To8(px >>  0);
+        }
+
+        writeLittle32(out, (atUint32)((a << 24) | (r << 16) | (g << 8) | b));
+    }
+};
+
+struct SGXExpandRGBA8
+{
+    static const atUint32 OutBytes = 4;
+    void operator()(const atUint8* tile, atUint32 step, atUint8* out) const
+    {
+        // The tile's first 32 bytes hold AR pairs, the next 32 the matching GB pairs
+        const atUint8* ar = tile + step * 2;
+        const atUint8* gb = tile + 0x20 + step * 2;
+        out[0] = gb[1];
+        out[1] = gb[0];
+        out[2] = ar[1];
+        out[3] = ar[0];
+    }
+};
+
+struct SGXExpandCMPR
+{
+    static const atUint32 OutBytes = 8;
+    void operator()(const atUint8* tile, atUint32 step, atUint8* out) const
+    {
+        // One DXT1 block, colors to little endian and the 2 bit indices mirrored within each byte
+        const atUint8* block = tile + step * 8;
+        out[0] = block[1];
+        out[1] = block[0];
+        out[2] = block[3];
+        out[3] = block[2];
+        for (atUint32 i = 4; i < 8; i++)
+        {
+            atUint8 b = block[i];
+            out[i] = ((b & 0x03) << 6) | ((b & 0x0C) << 2) | ((b & 0x30) >> 2) | ((b & 0xC0) >> 6);
+        }
+    }
+};
+
+// Expands a whole palette to its output format, entry i ends up at lut + i * Expander::OutBytes
+template <class Expander>
+void expandGXPalette(const atUint8* palette, atUint32 entryCount, atUint8* lut)
+{
+    Expander expand;
+    for (atUint32 i = 0; i < entryCount; i++)
+        expand(palette, i, lut + i * Expander::OutBytes);
+}
+
+// Paletted formats look their indices up in a palette expandGXPalette already went over
+template <atUint32 EntrySize>
+struct SGXLookupC4
+{
+    static const atUint32 OutBytes = EntrySize * 2;
+    const atUint8* lut;
+    void operator()(const atUint8* tile, atUint32 step, atUint8* out) const
+    {
+        memcpy(out, lut + (tile[step] >> 4) * EntrySize, EntrySize);
+        memcpy(out + EntrySize, lut + (tile[step] & 0xF) * EntrySize, EntrySize);
+    }
+};
+
+template <atUint32 EntrySize>
+struct SGXLookupC8
+{
+    static const atUint32 OutBytes = EntrySize;
+    const atUint8* lut;
+    void operator()(const atUint8* tile, atUint32 step, atUint8* out) const
+    {
+        memcpy(out, lut + tile[step] * EntrySize, EntrySize);
+    }
+};
+
+// Output that grows (zero filled) when a texel lands past its end. Some formats are given
+// less room up front than they decode to, so the room grows in doubling steps
+struct SGXOutput
+{
+    atUint8* data;
+    atUint32 length;
+    atUint32 capacity;
+
+    SGXOutput(atUint32 length)
+        : data(new atUint8[length]),
+          length(length),
+          capacity(length)
+    {
+    }
+
+    void ensure(atUint64 needed)
+    {
+        if (needed <= length)
+            return;
+
+        if (needed > capacity)
+        {
+            atUint64 grownCapacity = std::max<atUint64>(needed, (atUint64)capacity * 2);
+            atUint8* grown = new atUint8[grownCapacity];
+            memcpy(grown, data, length);
+            memset(grown + length, 0, grownCapacity - length);
+            delete[] data;
+            data     = grown;
+            capacity = grownCapacity;
+        }
+
+        length = needed;
+    }
+};
+
+// Runs an expander over a whole tile, row y of it going to dst + y * pitch,
+// every texel stride bytes after the one before it
+template <atUint32 BlockWidth, atUint32 BlockHeight, atUint32 BitsPerTexel, class Expander>
+struct SGXExpandTile
+{
+    static const atUint32 TexelsPerStep = BitsPerTexel == 4 ? 2 : 1;
+    static const atUint32 StepsPerRow   = BlockWidth / TexelsPerStep;
+
+    Expander expand;
+    atUint32 stride;
+
+    // How far the writes for one row of the tile reach
+    atUint32 rowExtent() const { return (StepsPerRow - 1) * TexelsPerStep * stride + Expander::OutBytes; }
+
+    void operator()(const atUint8* tile, atUint8* dst, atUint32 pitch) const
+    {
+        for (atUint32 y = 0; y < BlockHeight; y++, dst += pitch)
+        {
+            for (atUint32 step = 0; step < StepsPerRow; step++)
+                expand(tile, y * StepsPerRow + step, dst + step * TexelsPerStep * stride);
+        }
+    }
+};
+
+// Decodes one mip level of width x height texels from src into out at mipOffset, one tile at a
+// time. Texels past the right edge of the image wrap into the next row, the same as they always
+// have. Returns false if src runs out first, src is left past what was decoded
+template <atUint32 BlockWidth, atUint32 BlockHeight, atUint32 BitsPerTexel, class TileDecoder>
+bool decodeGXTiles(const atUint8*& src, const atUint8* srcEnd, SGXOutput& out, atUint32 mipOffset,
+                   atUint32 width, atUint32 height, const TileDecoder& decodeTile)
+{
+    static const atUint32 TileSize = BlockWidth * BlockHeight * BitsPerTexel / 8;
+    const atUint32 stride = decodeTile.stride;
+    const atUint32 pitch  = width * stride;
+
+    // The last row of the last tile in a row of tiles lands furthest out
+    const atUint32 lastBlockX = ((width + BlockWidth - 1) / BlockWidth - 1) * BlockWidth;
+    const atUint32 reach = lastBlockX * stride + decodeTile.rowExtent();
+
+    for (atUint32 blockY = 0; blockY < height; blockY += BlockHeight)
+    {
+        out.ensure(mipOffset + (atUint64)(blockY + BlockHeight - 1) * pitch + reach);
+
+        atUint8* row = out.data + mipOffset + blockY * pitch;
+        for (atUint32 blockX = 0; blockX < width; blockX += BlockWidth)
+        {
+            if (srcEnd - src < (atInt64)TileSize)
+                return false;
+
+            decodeTile(src, row + blockX * stride, pitch);
+            src += TileSize;
+        }
+    }
+
+    return true;
+}
+
+// Decodes tile rows [firstRow, endRow) of a mip level made of whole tiles, starting at src and
+// dst. Nothing is checked here, the caller has to make sure both are big enough. Rows don't
+// touch each other's output, so separate ranges can be decoded at the same time
+template <atUint32 BlockWidth, atUint32 BlockHeight, atUint32 BitsPerTexel, class TileDecoder>
+void decodeGXTileRows(const atUint8* src, atUint8* dst, atUint32 width, atUint32 firstRow, atUint32 endRow,
+                      const TileDecoder& decodeTile)
+{
+    static const atUint32 TileSize = BlockWidth * BlockHeight * BitsPerTexel / 8;
+    const atUint32 stride = decodeTile.stride;
+    const atUint32 pitch  = width * stride;
+
+    src += (atUint64)firstRow * (width / BlockWidth) * TileSize;
+    for (atUint32 row = firstRow; row < endRow; row++)
+    {
+        atUint8* rowDst = dst + (atUint64)row * BlockHeight * pitch;
+        for (atUint32 blockX = 0; blockX < width; blockX += BlockWidth, src += TileSize)
+            decodeTile(src, rowDst + blockX * stride, pitch);
+    }
+}
+
+#endif // GXTILEDECODER_HPP
@@ -0,0 +1,491 @@
+#include "GXTexelKernels.hpp"
+#include "GXTileDecoder.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <memory.h>
+
+// The SIMD sets need GCC or clang for the per function target attributes and CPU detection,
+// everything else only gets the scalar set
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RETRO_GX_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace
+{
+template <atUint32 BlockWidth, atUint32 BlockHeight, atUint32 BitsPerTexel, class Expander>
+void scalarTile(const atUint8* tile, atUint8* dst, atUint32 pitch)
+{
+    typedef SGXExpandTile<BlockWidth, BlockHeight, BitsPerTexel, Expander> Tile;
+    Tile{Expander(), Expander::OutBytes / Tile::TexelsPerStep}(tile, dst, pitch);
+}
+
+template <atUint32 BlockWidth, atUint32 BlockHeight, atUint32 BitsPerTexel, class Lookup>
+void scalarPaletteTile(const atUint8* tile, const atUint8* lut, atUint8* dst, atUint32 pitch)
+{
+    typedef SGXExpandTile<BlockWidth, BlockHeight, BitsPerTexel, Lookup> Tile;
+    Tile{Lookup{lut}, Lookup::OutBytes / Tile::TexelsPerStep}(tile, dst, pitch);
+}
+
+const SGXTileKernels ScalarKernels =
+{
+    "scalar",
+    &scalarTile<8, 8, 4,  SGXExpandI4>,
+    &scalarTile<8, 4, 8,  SGXExpandI8>,
+    &scalarTile<8, 4, 8,  SGXExpandIA4>,
+    &scalarTile<4, 4, 16, SGXExpandIA8>,
+    &scalarTile<4, 4, 16, SGXExpandRGB565>,
+    &scalarTile<4, 4, 16, SGXExpandRGB5A3>,
+    &scalarTile<4, 4, 32, SGXExpandRGBA8>,
+    &scalarTile<2, 2, 64, SGXExpandCMPR>,
+    &scalarPaletteTile<8, 8, 4, SGXLookupC4<4>>,
+    &scalarPaletteTile<8, 4, 8, SGXLookupC8<4>>,
+    &scalarPaletteTile<8, 8, 4, SGXLookupC4<2>>,
+    &scalarPaletteTile<8, 4, 8, SGXLookupC8<2>>,
+};
+
+#ifdef RETRO_GX_X86_KERNELS
+#define SSE2_KERNEL __attribute__((target("sse2")))
+#define AVX2_KERNEL __attribute__((target("avx2")))
+
+// Most of the work happens in 16 bit lanes, one lane per texel. The low lane holds the first
+// two output bytes of a texel and the high lane the last two, interleaving them gives the texels
+
+SSE2_KERNEL inline __m128i load128(const atUint8* src)
+{
+    return _mm_loadu_si128((const __m128i*)src);
+}
+
+SSE2_KERNEL inline __m128i swapBytes16(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+// Nibbles to bytes, 0xA becomes 0xAA
+SSE2_KERNEL inline __m128i expand4(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 4), v);
+}
+
+// 16 texels of luminance l and alpha a, two rows of 8
+SSE2_KERNEL inline void storeLARows(__m128i l, __m128i a, atUint8* dst, atUint32 pitch)
+{
+    __m128i ll = _mm_unpacklo_epi8(l, l);
+    __m128i la = _mm_unpacklo_epi8(l, a);
+    _mm_storeu_si128((__m128i*)dst,        _mm_unpacklo_epi16(ll, la));
+    _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(ll, la));
+    dst += pitch;
+    ll = _mm_unpackhi_epi8(l, l);
+    la = _mm_unpackhi_epi8(l, a);
+    _mm_storeu_si128((__m128i*)dst,        _mm_unpacklo_epi16(ll, la));
+    _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(ll, la));
+}
+
+// 8 texels, two rows of 4
+SSE2_KERNEL inline void storeRows4(__m128i lo, __m128i hi, atUint8* dst, atUint32 pitch)
+{
+    _mm_storeu_si128((__m128i*)dst,           _mm_unpacklo_epi16(lo, hi));
+    _mm_storeu_si128((__m128i*)(dst + pitch), _mm_unpackhi_epi16(lo, hi));
+}
+
+SSE2_KERNEL void sse2TileI4(const atUint8* tile, atUint8* dst, atUint32 pitch)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    for (atUint32 i = 0; i < 2; i++, tile += 16)
+    {
+        // 4 rows, the high nibble is the first texel of a byte
+        __m128i v  = load128(tile);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+        __m128i lo = _mm_and_si128(v, nibble);
+        __m128i l  = expand4(_mm_unpacklo_epi8(hi, lo));
+        storeLARows(l, l, dst, pitch);
+        dst += pitch * 2;
+        l = expand4(_mm_unpackhi_epi8(hi, lo));
+        storeLARows(l, l, dst, pitch);
+        dst += pitch * 2;
+    }
+}
+
+SSE2_KERNEL void sse2TileI8(const atUint8* tile, atUint8* dst, atUint32 pitch)
+{
+    for (atUint32 i = 0; i < 2; i++, tile += 16, dst += pitch * 2)
+    {
+        __m128i l = load128(tile);
+        storeLARows(l, l, dst, pitch);
+    }
+}
+
+SSE2_KERNEL void sse2TileIA4(const atUint8* tile, atUint8* dst, atUint32 pitch)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    for (atUint32 i = 0; i < 2; i++, tile += 16, dst += pitch * 2)
+    {
+        __m128i v = load128(tile);
+        storeLARows(expand4(_mm_and_si128(v, nibble)), expand4(_mm_and_si128(_mm_srli_epi16(v, 4), nibble)), dst, pitch);
+    }
+}
+
+SSE2_KERNEL void sse2TileIA8(const atUint8* tile, atUint8* dst, atUint32 pitch)
+{
+    const __m128i lowByte = _mm_set1_epi16(0xFF);
+    for (atUint32 i = 0; i < 2; i++, tile += 16, dst += pitch * 2)
+    {
+        __m128i v = load128(tile);
+        __m128i l = _mm_srli_epi16(v, 8);
+        __m128i a = _mm_and_si128(v, lowByte);
+        storeRows4(_mm_or_si128(l, _mm_slli_epi16(l, 8)), _mm_or_si128(l, _mm_slli_epi16(a, 8)), dst, pitch);
+    }
+}
+
+SSE2_KERNEL void sse2TileRGB565(const atUint8* tile, atUint8* dst, atUint32 pitch)
+{
+    for (atUint32 i = 0; i < 2; i++, tile += 16, dst += pitch * 2)
+    {
+        __m128i px = swapBytes16(load128(tile));
+        _mm_storel_epi64((__m128i*)dst,           px);
+        _mm_storel_epi64((__m128i*)(dst + pitch), _mm_srli_si128(px, 8));
+    }
+}
+
+// The four channels of 8 RGB5A3 texels, in output order
+SSE2_KERNEL inline void expandRGB5A3(__m128i px, __m128i& lo, __m128i& hi)
+{
+    const __m128i c5 = _mm_set1_epi16(0x1F);
+    const __m128i c4 = _mm_set1_epi16(0x0F);
+    const __m128i c3 = _mm_set1_epi16(0x07);
+    __m128i rgb5 = _mm_srai_epi16(px, 15);
+
+    __m128i x5 = _mm_and_si128(_mm_srli_epi16(px, 10), c5);
+    __m128i y5 = _mm_and_si128(_mm_srli_epi16(px,  5), c5);
+    __m128i z5 = _mm_and_si128(px, c5);
+    x5 = _mm_or_si128(_mm_slli_epi16(x5, 3), _mm_srli_epi16(x5, 2));
+    y5 = _mm_or_si128(_mm_slli_epi16(y5, 3), _mm_srli_epi16(y5, 2));
+    z5 = _mm_or_si128(_mm_slli_epi16(z5, 3), _mm_srli_epi16(z5, 2));
+
+    __m128i x4 = expand4(_mm_and_si128(_mm_srli_epi16(px, 8), c4));
+    __m128i y4 = expand4(_mm_and_si128(_mm_srli_epi16(px, 4), c4));
+    __m128i z4 = expand4(_mm_and_si128(px, c4));
+    __m128i a3 = _mm_and_si128(_mm_srli_epi16(px, 12), c3);
+    a3 = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(a3, 5), _mm_slli_epi16(a3, 2)), _mm_srli_epi16(a3, 1));
+
+    __m128i x = _mm_or_si128(_mm_and_si128(rgb5, x5), _mm_andnot_si128(rgb5, x4));
+    __m128i y = _mm_or_si128(_mm_and_si128(rgb5, y5), _mm_andnot_si128(rgb5, y4));
+    __m128i z = _mm_or_si128(_mm_and_si128(rgb5, z5), _mm_andnot_si128(rgb5, z4));
+    __m128i a = _mm_or_si128(_mm_and_si128(rgb5, _mm_set1_epi16(0xFF)), _mm_andnot_si128(rgb5, a3));
+    lo = _mm_or_si128(x, _mm_slli_epi16(y, 8));
+    hi = _mm_or_si128(z, _mm_slli_epi16(a, 8));
+}
+
+SSE2_KERNEL void sse2TileRGB5A3(const atUint8* tile, atUint8* dst, atUint32 pitch)
+{
+    for (atUint32 i = 0; i < 2; i++, tile += 16, dst += pitch * 2)
+    {
+        __m128i lo, hi;
+        expandRGB5A3(swapBytes16(load128(tile)), lo, hi);
+        storeRows4(lo, hi, dst, pitch);
+    }
+}
+
+SSE2_KERNEL void sse2TileRGBA8(const atUint8* tile, atUint8* dst, atUint32 pitch)
+{
+    // Merges the AR and GB planes
+    for (atUint32 i = 0; i < 2; i++, tile += 16, dst += pitch * 2)
+        storeRows4(swapBytes16(load128(tile + 0x20)), swapBytes16(load128(tile)), dst, pitch);
+}
+
+SSE2_KERNEL void sse2TileCMPR(const atUint8* tile, atUint8* dst, atUint32 pitch)
+{
+    // Bytes 0-3 of each block hold the colors, 4-7 the indices
+    const __m128i indices = _mm_set_epi32(-1, 0, -1, 0);
+    const __m128i m03 = _mm_set1_epi8(0x03), m0C = _mm_set1_epi8(0x0C);
+    const __m128i m30 = _mm_set1_epi8(0x30), mC0 = _mm_set1_epi8((char)0xC0);
+    for (atUint32 i = 0; i < 2; i++, tile += 16, dst += pitch)
+    {
+        __m128i v = load128(tile);
+        __m128i mirrored = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_epi16(v, 6), mC0),
+                                                     _mm_and_si128(_mm_slli_epi16(v, 2), m30)),
+                                        _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 2), m0C),
+                                                     _mm_and_si128(_mm_srli_epi16(v, 6), m03)));
+        _mm_storeu_si128((__m128i*)dst, _mm_or_si128(_mm_and_si128(indices, mirrored),
+                                                     _mm_andnot_si128(indices, swapBytes16(v))));
+    }
+}
+
+const SGXTileKernels SSE2Kernels =
+{
+    "sse2",
+    &sse2TileI4,
+    &sse2TileI8,
+    &sse2TileIA4,
+    &sse2TileIA8,
+    &sse2TileRGB565,
+    &sse2TileRGB5A3,
+    &sse2TileRGBA8,
+    &sse2TileCMPR,
+    // No gathers before AVX2, plain lookups are as good as it gets
+    &scalarPaletteTile<8, 8, 4, SGXLookupC4<4>>,
+    &scalarPaletteTile<8, 4, 8, SGXLookupC8<4>>,
+    &scalarPaletteTile<8, 8, 4, SGXLookupC4<2>>,
+    &scalarPaletteTile<8, 4, 8, SGXLookupC8<2>>,
+};
+
+// AVX2 lanes are two SSE registers side by side, so a 256 bit load of a tile holds its rows
+// 0 and 1 in the low lane and rows 2 and 3 in the high one
+
+AVX2_KERNEL inline __m256i load256(const atUint8* src)
+{
+    return _mm256_loadu_si256((const __m256i*)src);
+}
+
+AVX2_KERNEL inline __m256i swapBytes16(__m256i v)
+{
+    return _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+}
+
+AVX2_KERNEL inline __m256i expand4(__m256i v)
+{
+    return _mm256_or_si256(_mm256_slli_epi16(v, 4), v);
+}
+
+// 32 texels of luminance l and alpha a, four rows of 8
+AVX2_KERNEL inline void storeLARows(__m256i l, __m256i a, atUint8* dst, atUint32 pitch)
+{
+    __m256i ll = _mm256_unpacklo_epi8(l, l);
+    __m256i la = _mm256_unpacklo_epi8(l, a);
+    __m256i first  = _mm256_unpacklo_epi16(ll, la);
+    __m256i second = _mm256_unpackhi_epi16(ll, la);
+    __m256i row0 = _mm256_permute2x128_si256(first, second, 0x20);
+    __m256i row2 = _mm256_permute2x128_si256(first, second, 0x31);
+    ll = _mm256_unpackhi_epi8(l, l);
+    la = _mm256_unpackhi_epi8(l, a);
+    first  = _mm256_unpacklo_epi16(ll, la);
+    second = _mm256_unpackhi_epi16(ll, la);
+    __m256i row1 = _mm256_permute2x128_si256(first, second, 0x20);
+    __m256i row3 = _mm256_permute2x128_si256(first, second, 0x31);
+    _mm256_storeu_si256((__m256i*)dst, row0);
+    _mm256_storeu_si256((__m256i*)(dst + pitch), row1);
+    _mm256_storeu_si256((__m256i*)(dst + pitch * 2), row2);
+    _mm256_storeu_si256((__m256i*)(dst + pitch * 3), row3);
+}
+
+// 16 texels, four rows of 4
+AVX2_KERNEL inline void storeRows4(__m256i lo, __m256i hi, atUint8* dst, atUint32 pitch)
+{
+    __m256i even = _mm256_unpacklo_epi16(lo, hi);
+    __m256i odd  = _mm256_unpackhi_epi16(lo, hi);
+    _mm_storeu_si128((__m128i*)dst,               _mm256_castsi256_si128(even));
+    _mm_storeu_si128((__m128i*)(dst + pitch),     _mm256_castsi256_si128(odd));
+    _mm_storeu_si128((__m128i*)(dst + pitch * 2), _mm256_extracti128_si256(even, 1));
+    _mm_storeu_si128((__m128i*)(dst + pitch * 3), _mm256_extracti128_si256(odd, 1));
+}
+
+AVX2_KERNEL void avx2TileI4(const atUint8* tile, atUint8* dst, atUint32 pitch)
+{
+    // Rows 0-3 of the tile are in the low lane, 4-7 in the high one
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i v  = load256(tile);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+    __m256i lo = _mm256_and_si256(v, nibble);
+    __m256i rows01 = expand4(_mm256_unpacklo_epi8(hi, lo)); // and 4, 5
+    __m256i rows23 = expand4(_mm256_unpackhi_epi8(hi, lo)); // and 6, 7
+    __m256i l = _mm256_permute2x128_si256(rows01, rows23, 0x20);
+    storeLARows(l, l, dst, pitch);
+    l = _mm256_permute2x128_si256(rows01, rows23, 0x31);
+    storeLARows(l, l, dst + pitch * 4, pitch);
+}
+
+AVX2_KERNEL void avx2TileI8(const atUint8* tile, atUint8* dst, atUint32 pitch)
+{
+    __m256i l = load256(tile);
+    storeLARows(l, l, dst, pitch);
+}
+
+AVX2_KERNEL void avx2TileIA4(const atUint8* tile, atUint8* dst, atUint32 pitch)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i v = load256(tile);
+    storeLARows(expand4(_mm256_and_si256(v, nibble)), expand4(_mm256_and_si256(_mm256_srli_epi16(v, 4), nibble)), dst, pitch);
+}
+
+AVX2_KERNEL void avx2TileIA8(const atUint8* tile, atUint8* dst, atUint32 pitch)
+{
+    __m256i v = load256(tile);
+    __m256i l = _mm256_srli_epi16(v, 8);
+    __m256i a = _mm256_and_si256(v, _mm256_set1_epi16(0xFF));
+    storeRows4(_mm256_or_si256(l, _mm256_slli_epi16(l, 8)), _mm256_or_si256(l, _mm256_slli_epi16(a, 8)), dst, pitch);
+}
+
+AVX2_KERNEL void avx2TileRGB5A3(const atUint8* tile, atUint8* dst, atUint32 pitch)
+{
+    const __m256i c5 = _mm256_set1_epi16(0x1F);
+    const __m256i c4 = _mm256_set1_epi16(0x0F);
+    const __m256i c3 = _mm256_set1_epi16(0x07);
+    __m256i px   = swapBytes16(load256(tile));
+    __m256i rgb5 = _mm256_srai_epi16(px, 15);
+
+    __m256i x5 = _mm256_and_si256(_mm256_srli_epi16(px, 10), c5);
+    __m256i y5 = _mm256_and_si256(_mm256_srli_epi16(px,  5), c5);
+    __m256i z5 = _mm256_and_si256(px, c5);
+    x5 = _mm256_or_si256(_mm256_slli_epi16(x5, 3), _mm256_srli_epi16(x5, 2));
+    y5 = _mm256_or_si256(_mm256_slli_epi16(y5, 3), _mm256_srli_epi16(y5, 2));
+    z5 = _mm256_or_si256(_mm256_slli_epi16(z5, 3), _mm256_srli_epi16(z5, 2));
+
+    __m256i x4 = expand4(_mm256_and_si256(_mm256_srli_epi16(px, 8), c4));
+    __m256i y4 = expand4(_mm256_and_si256(_mm256_srli_epi16(px, 4), c4));
+    __m256i z4 = expand4(_mm256_and_si256(px, c4));
+    __m256i a3 = _mm256_and_si256(_mm256_srli_epi16(px, 12), c3);
+    a3 = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(a3, 5), _mm256_slli_epi16(a3, 2)), _mm256_srli_epi16(a3, 1));
+
+    __m256i x = _mm256_blendv_epi8(x4, x5, rgb5);
+    __m256i y = _mm256_blendv_epi8(y4, y5, rgb5);
+    __m256i z = _mm256_blendv_epi8(z4, z5, rgb5);
+    __m256i a = _mm256_blendv_epi8(a3, _mm256_set1_epi16(0xFF), rgb5);
+    storeRows4(_mm256_or_si256(x, _mm256_slli_epi16(y, 8)), _mm256_or_si256(z, _mm256_slli_epi16(a, 8)), dst, pitch);
+}
+
+AVX2_KERNEL void avx2TileRGBA8(const atUint8* tile, atUint8* dst, atUint32 pitch)
+{
+    storeRows4(swapBytes16(load256(tile + 0x20)), swapBytes16(load256(tile)), dst, pitch);
+}
+
+// A row of 8 palette indices from a C4 tile, the high nibble is the first texel of a byte
+AVX2_KERNEL inline __m256i c4Indices(const atUint8* row)
+{
+    atInt32 packed;
+    memcpy(&packed, row, 4);
+    __m128i v = _mm_cvtsi32_si128(packed);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    return _mm256_cvtepu8_epi32(_mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(v, 4), nibble), _mm_and_si128(v, nibble)));
+}
+
+AVX2_KERNEL inline __m256i c8Indices(const atUint8* row)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)row));
+}
+
+// Gathers 8 two byte entries, the lookups read 4 bytes and keep the low 2
+AVX2_KERNEL inline void storeGather16(const atUint8* lut, __m256i indices, atUint8* dst)
+{
+    __m256i entries = _mm256_and_si256(_mm256_i32gather_epi32((const int*)lut, indices, 2), _mm256_set1_epi32(0xFFFF));
+    __m256i packed  = _mm256_permute4x64_epi64(_mm256_packus_epi32(entries, entries), 0x08);
+    _mm_storeu_si128((__m128i*)dst, _mm256_castsi256_si128(packed));
+}
+
+AVX2_KERNEL void avx2TileC4RGBA8(const atUint8* tile, const atUint8* lut, atUint8* dst, atUint32 pitch)
+{
+    for (atUint32 y = 0; y < 8; y++, tile += 4, dst += pitch)
+        _mm256_storeu_si256((__m256i*)dst, _mm256_i32gather_epi32((const int*)lut, c4Indices(tile), 4));
+}
+
+AVX2_KERNEL void avx2TileC8RGBA8(const atUint8* tile, const atUint8* lut, atUint8* dst, atUint32 pitch)
+{
+    for (atUint32 y = 0; y < 4; y++, tile += 8, dst += pitch)
+        _mm256_storeu_si256((__m256i*)dst, _mm256_i32gather_epi32((const int*)lut, c8Indices(tile), 4));
+}
+
+AVX2_KERNEL void avx2TileC4RGB565(const atUint8* tile, const atUint8* lut, atUint8* dst, atUint32 pitch)
+{
+    for (atUint32 y = 0; y < 8; y++, tile += 4, dst += pitch)
+        storeGather16(lut, c4Indices(tile), dst);
+}
+
+AVX2_KERNEL void avx2TileC8RGB565(const atUint8* tile, const atUint8* lut, atUint8* dst, atUint32 pitch)
+{
+    for (atUint32 y = 0; y < 4; y++, tile += 8, dst += pitch)
+        storeGather16(lut, c8Indices(tile), dst);
+}
+
+// RGB565 and CMPR are a shuffle per row, AVX2 doesn't buy them anything
+const SGXTileKernels AVX2Kernels =
+{
+    "avx2",
+    &avx2TileI4,
+    &avx2TileI8,
+    &avx2TileIA4,
+    &avx2TileIA8,
+    &sse2TileRGB565,
+    &avx2TileRGB5A3,
+    &avx2TileRGBA8,
+    &sse2TileCMPR,
+    &avx2TileC4RGBA8,
+    &avx2TileC8RGBA8,
+    &avx2TileC4RGB565,
+    &avx2TileC8RGB565,
+};
+#endif
+
+std::vector<const SGXTileKernels*> supportedSets()
+{
+    std::vector<const SGXTileKernels*> sets = {&ScalarKernels};
+#ifdef RETRO_GX_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        sets.push_back(&SSE2Kernels);
+    if (__builtin_cpu_supports("avx2"))
+        sets.push_back(&AVX2Kernels);
+#endif
+
+    return sets;
+}
+
+const SGXTileKernels* findSet(const std::string& name)
+{
+    for (const SGXTileKernels* set : gxTileKernelSets())
+    {
+        if (name == set->name)
+            return set;
+    }
+
+    return nullptr;
+}
+
+std::atomic<const SGXTileKernels*>& activeSet()
+{
+    static std::atomic<const SGXTileKernels*> active(nullptr);
+    return active;
+}
+
+const SGXTileKernels* defaultSet()
+{
+    const char* requested = getenv("RETRO_TEXEL_KERNELS");
+    if (requested)
+    {
+        const SGXTileKernels* set = findSet(requested);
+        if (set)
+            return set;
+    }
+
+    return gxTileKernelSets().back();
+}
+}
+
+const std::vector<const SGXTileKernels*>& gxTileKernelSets()
+{
+    static const std::vector<const SGXTileKernels*> sets = supportedSets();
+    return sets;
+}
+
+const SGXTileKernels& gxTileKernels()
+{
+    const SGXTileKernels* set = activeSet().load(std::memory_order_acquire);
+    if (!set)
+    {
+        // Don't clobber a selectGXTileKernels that got in first
+        const SGXTileKernels* expected = nullptr;
+        set = defaultSet();
+        if (!activeSet().compare_exchange_strong(expected, set, std::memory_order_acq_rel))
+            set = expected;
+    }
+
+    return *set;
+}
+
+bool selectGXTileKernels(const std::string& name)
+{
+    const SGXTileKernels* set = findSet(name);
+    if (!set)
+        return false;
+
+    activeSet().store(set, std::memory_order_release);
+    return true;
+}
@@ -1,7 +1,10 @@
 #include "TextureReader.hpp"
 #include <Athena/InvalidDataException.hpp>
 #include <RetroCommon.hpp>
+#include "GXTexelKernels.hpp"
+#include "CWorkerPool.hpp"
 #include "pngpp/png.hpp"
+#include <algorithm>
 
 static const float sizeOutputMultiplierLut[] =
 { // number of pixels * this = number of bytes
@@ -18,33 +21,27 @@ static const atUint32 pixelStrideLut[] =
   4, 4, 4, 4, 2, 2, 0, 2, 4, 4, 8
 };
 
-static const atUint32 blockWidthLut[] =
-{
-    8, 8, 8, 4, 8, 8, 0, 4, 4, 4, 2
-};
-
-static const atUint32 blockHeightLut[] =
-{
-    8, 4, 4, 4, 8, 4, 0, 4, 4, 4, 2
-};
-
 TextureReader::TextureReader(const atUint8* data, atUint64 length)
     : base(data, length),
-      m_paletteStream(nullptr)
+      m_parallelDecode(false)
 {
     base::setEndian(Athena::Endian::BigEndian);
 }
 
 TextureReader::TextureReader(const std::string &filename)
     : base(filename),
-      m_paletteStream(nullptr)
+      m_parallelDecode(false)
 {
     base::setEndian(Athena::Endian::BigEndian);
 }
 
 TextureReader::~TextureReader()
 {
-    delete m_paletteStream;
+}
+
+void TextureReader::setParallelDecode(bool parallel)
+{
+    m_parallelDecode = parallel;
 }
 
 Texture* TextureReader::read()
@@ -57,13 +54,13 @@ Texture* TextureReader::read()
 
         if (fmt > (atUint32)GXTextureFormat::CMPR)
         {
-            Athena::io::MemoryWriter writer;
+            // Decompress straight out of our own buffer, setData takes ownership of the result
+            atUint32 decompressedLength = 0;
+            atUint8* decompressed = decompressResource(base::m_data, base::m_length, decompressedLength);
 
-            decompressFile(writer, data(), length());
-
-            if (writer.length() > 0)
+            if (decompressed)
             {
-                setData(writer.data(), writer.length());
+                setData(decompressed, decompressedLength);
                 fmt = base::readUint32();
             }
             else
@@ -84,9 +81,25 @@ Texture* TextureReader::read()
             base::seek(4);
 
             atUint32 entryCount = (m_format == GXTextureFormat::C4) ? 16 : 256;
-            atUint8* palData = base::readUBytes(entryCount * 2);
+            std::unique_ptr<atUint8[]> palette(base::readUBytes(entryCount * 2));
+
+            // The palette used to be read through a little endian stream, which
+            // byte swaps the color entries, keep the output the same
+            if (m_palFormat == GXPaletteFormat::RGB565 || m_palFormat == GXPaletteFormat::RGB5A3)
+            {
+                for (atUint32 i = 0; i < entryCount * 2; i += 2)
+                    std::swap(palette[i], palette[i + 1]);
+            }
 
-            m_paletteStream = new Athena::io::MemoryReader(palData, entryCount * 2);
+            // Expanded once here, decoding only looks entries up. The padding is for the
+            // lookups of 2 byte entries, which read 4 bytes
+            m_paletteLUT.reset(new atUint8[entryCount * 4 + 2]);
+            if (m_palFormat == GXPaletteFormat::IA8)
+                expandGXPalette<SGXExpandIA8>(palette.get(), entryCount, m_paletteLUT.get());
+            else if (m_palFormat == GXPaletteFormat::RGB565)
+                expandGXPalette<SGXExpandRGB565>(palette.get(), entryCount, m_paletteLUT.get());
+            else if (m_palFormat == GXPaletteFormat::RGB5A3)
+                expandGXPalette<SGXExpandRGB5A3>(palette.get(), entryCount, m_paletteLUT.get());
         }
         else
             m_hasPalette = false;
@@ -99,11 +112,16 @@ Texture* TextureReader::read()
         if (m_hasPalette && m_palFormat == GXPaletteFormat::RGB5A3)
             dataBufferSize *= 2;
 
-        atUint8* data = new atUint8[dataBufferSize];
-
-        Athena::io::MemoryWriter buf{data, dataBufferSize};
-
-        decode(*this, buf);
+        SGXOutput out(dataBufferSize);
+        try
+        {
+            decode(out);
+        }
+        catch(...)
+        {
+            delete[] out.data;
+            throw;
+        }
 
         ret = new Texture;
         switch (m_format)
@@ -136,8 +154,8 @@ Texture* TextureReader::read()
         ret->m_width      = m_width;
         ret->m_height     = m_height;
         ret->m_mipmaps    = m_mipmaps;
-        ret->m_bits       = buf.data();
-        ret->m_dataSize   = buf.length();
+        ret->m_bits       = out.data;
+        ret->m_dataSize   = out.length;
         ret->m_linearSize = m_width * m_height * sizeOutputMultiplierLut[(atUint32)m_format];
     }
     catch(...)
@@ -150,232 +168,226 @@ Texture* TextureReader::read()
     return ret;
 }
 
-void TextureReader::decode(Athena::io::MemoryReader& in, Athena::io::MemoryWriter& buf)
+// How much output a texture needs before its decode gets split up, and about how much each job gets
+static const atUint32 ParallelDecodeThreshold = 256 * 1024;
+static const atUint32 ParallelDecodeChunk     = 64 * 1024;
+
+// Splits the mip levels into ranges of tile rows and decodes those on the worker pool. The jobs
+// run in any order, so this only takes textures where none of them write over each other, which
+// means whole tiles that stay inside of their mip level. Returns false without touching
+// anything for everything else, that goes through decodeMipChain one tile after the other
+template <atUint32 BlockWidth, atUint32 BlockHeight, atUint32 BitsPerTexel, class TileDecoder>
+static bool decodeMipChainParallel(const atUint8*& src, const atUint8* srcEnd, SGXOutput& out, atUint32 width, atUint32 height,
+                                   atUint32 mipmaps, float sizeMultiplier, atUint32 texelScale, const TileDecoder& decodeTile)
 {
-    atUint32 mipWidth = m_width, mipHeight = m_height;
-    atUint32 mipOffset = 0;
+    static const atUint32 TileSize = BlockWidth * BlockHeight * BitsPerTexel / 8;
+    const atUint32 stride = decodeTile.stride;
+    if (decodeTile.rowExtent() != BlockWidth * stride)
+        return false;
 
-    // I stole this little trick from Parax, so I'll let him explain what's going on here:
-    // With CMPR, we're using a little trick.
-    // CMPR stores pixels in 8x8 blocks, with four 4x4 subblocks.
-    // An easy way to convert it is to pretend each block is 2x2 and each subblock is one pixel.
-    // So to do that we need to calculate the "new" dimensions of the image, 1/4 the size of the original.
-    if (m_format == GXTextureFormat::CMPR)
+    struct SJob
     {
-        mipWidth /= 4;
-        mipHeight /= 4;
-    }
-
-    atUint32 blockWidth = blockWidthLut[(atUint32)m_format];
-    atUint32 blockHeight = blockHeightLut[(atUint32)m_format];
-
-    atUint32 pxStride = pixelStrideLut[(atUint32)m_format];
-    if (m_hasPalette && (m_palFormat == GXPaletteFormat::RGB5A3))
-        pxStride = 4;
-
-    for (atUint32 m = 0; m < m_mipmaps; m++)
+        const atUint8* src;
+        atUint32       mipOffset;
+        atUint32       width;
+        atUint32       firstRow;
+        atUint32       endRow;
+    };
+
+    std::vector<SJob> jobs;
+    const atUint8* mipSrc = src;
+    atUint32 mipOffset = 0;
+    atUint64 outEnd = 0;
+    for (atUint32 m = 0; m < mipmaps; m++)
     {
-        for (atUint32 blockY = 0; blockY < mipHeight; blockY += blockHeight)
-        {
-            for (atUint32 blockX = 0; blockX < mipWidth; blockX += blockWidth)
-            {
-                for (atUint32 imgY = blockY; imgY < blockY + blockHeight; imgY++)
-                {
-                    for (atUint32 imgX = blockX; imgX < blockX + blockWidth; imgX++)
-                    {
-                        atUint32 pos = ((imgY * mipWidth) + imgX) * pxStride;
-                        buf.seek(mipOffset + pos, Athena::SeekOrigin::Begin);
-
-                        switch(m_format)
-                        {
-                            case GXTextureFormat::I4:     readPixelI4     (in, buf); break;
-                            case GXTextureFormat::I8:     readPixelI8     (in, buf); break;
-                            case GXTextureFormat::IA4:    readPixelIA4    (in, buf); break;
-                            case GXTextureFormat::IA8:    readPixelIA8    (in, buf); break;
-                            case GXTextureFormat::C4:     readPixelC4     (in, buf); break;
-                            case GXTextureFormat::C8:     readPixelC8     (in, buf); break;
-                            case GXTextureFormat::RGB565: readPixelRGB565 (in, buf); break;
-                            case GXTextureFormat::RGB5A3: readPixelRGB5A3 (in, buf); break;
-                            case GXTextureFormat::RGBA8:  readPixelRGBA8  (in, buf); break;
-                            case GXTextureFormat::CMPR:   readCMPRSubBlock(in, buf); break;
-                        }
-
-                        if (m_format == GXTextureFormat::I4 || m_format == GXTextureFormat::C4)
-                            imgX++;
-                    }
-                }
-                if (m_format ==  GXTextureFormat::RGBA8)
-                    in.seek(0x20, Athena::SeekOrigin::Current);
-            }
-        }
-
-        atUint32 mipSize = mipWidth * mipHeight * sizeOutputMultiplierLut[(atUint32)m_format];
-        if (m_format == GXTextureFormat::CMPR)
-            mipSize *= 16;
-
-        mipOffset += mipSize;
-        mipWidth /= 2;
-        mipHeight /= 2;
-        if (mipWidth < blockWidth)
-            mipWidth = blockWidth;
-        if (mipHeight < blockHeight)
-            mipHeight = blockHeight;
+        if (width % BlockWidth != 0 || height % BlockHeight != 0)
+            return false;
+
+        atUint32 pitch      = width * stride;
+        atUint32 tileRows   = height / BlockHeight;
+        atUint64 mipEnd     = mipOffset + (atUint64)height * pitch;
+        atUint32 nextOffset = mipOffset + (atUint32)(width * height * sizeMultiplier) * texelScale;
+        atUint64 mipSrcSize = (atUint64)(width / BlockWidth) * tileRows * TileSize;
+        if ((m + 1 < mipmaps && mipEnd > nextOffset) || (atUint64)(srcEnd - mipSrc) < mipSrcSize)
+            return false;
+
+        atUint32 rowsPerJob = std::max<atUint32>(1, ParallelDecodeChunk / std::max<atUint32>(1, BlockHeight * pitch));
+        for (atUint32 row = 0; row < tileRows; row += rowsPerJob)
+            jobs.push_back(SJob{mipSrc, mipOffset, width, row, std::min(row + rowsPerJob, tileRows)});
+
+        outEnd = std::max(outEnd, mipEnd);
+        mipSrc += mipSrcSize;
+        mipOffset = nextOffset;
+        width /= 2;
+        height /= 2;
+        if (width < BlockWidth)
+            width = BlockWidth;
+        if (height < BlockHeight)
+            height = BlockHeight;
     }
-}
 
-void TextureReader::readPixelI4(Athena::io::MemoryReader& in, Athena::io::MemoryWriter& out)
-{
-    atUint8 px = in.readByte();
-    atUint8 l1 = extend4To8(px >> 4);
-    atUint8 l2 = extend4To8(px);
-    out.writeByte(l1);
-    out.writeByte(l1);
-    out.writeByte(l1);
-    out.writeByte(l1);
-    out.writeByte(l2);
-    out.writeByte(l2);
-    out.writeByte(l2);
-    out.writeByte(l2);
-}
+    if (jobs.size() < 2 || outEnd < ParallelDecodeThreshold)
+        return false;
 
-void TextureReader::readPixelI8(Athena::io::MemoryReader& in, Athena::io::MemoryWriter& out)
-{
-    atUint8 l = in.readByte();
-    out.writeByte(l);
-    out.writeByte(l);
-    out.writeByte(l);
-    out.writeByte(l);
-}
-
-void TextureReader::readPixelIA4(Athena::io::MemoryReader& in, Athena::io::MemoryWriter& out)
-{
-    atUint8 b = in.readByte();
-    atUint8 a = extend4To8(b >> 4);
-    atUint8 l = extend4To8(b);
-    out.writeByte(l);
-    out.writeByte(l);
-    out.writeByte(l);
-    out.writeByte(a);
-}
+    // Grown up front, nothing may move the buffer while the jobs write to it
+    out.ensure(outEnd);
+    CWorkerPool::instance().parallelFor(jobs.size(), [&](atUint32 i)
+    {
+        const SJob& job = jobs[i];
+        decodeGXTileRows<BlockWidth, BlockHeight, BitsPerTexel>(job.src, out.data + job.mipOffset, job.width,
+                                                                job.firstRow, job.endRow, decodeTile);
+    });
 
-void TextureReader::readPixelIA8(Athena::io::MemoryReader& in, Athena::io::MemoryWriter& out)
-{
-    atUint8 a = in.readByte();
-    atUint8 l = in.readByte();
-    out.writeByte(l);
-    out.writeByte(l);
-    out.writeByte(l);
-    out.writeByte(a);
+    src = mipSrc;
+    return true;
 }
 
-void TextureReader::readPixelC4(Athena::io::MemoryReader& in, Athena::io::MemoryWriter& out)
+// Decodes every mip level, they follow each other in the source and the output.
+// A mip level takes up width * height * sizeMultiplier * texelScale bytes of output
+template <atUint32 BlockWidth, atUint32 BlockHeight, atUint32 BitsPerTexel, class TileDecoder>
+static bool decodeMipChain(const atUint8*& src, const atUint8* srcEnd, SGXOutput& out, atUint32 width, atUint32 height,
+                           atUint32 mipmaps, float sizeMultiplier, atUint32 texelScale, const TileDecoder& decodeTile,
+                           bool parallel)
 {
-    atUint8 b = in.readByte();
-    atUint8 indices[2];
-    indices[0] = (b >> 4) & 0xF;
-    indices[1] = b & 0xF;
+    if (parallel && decodeMipChainParallel<BlockWidth, BlockHeight, BitsPerTexel>(src, srcEnd, out, width, height, mipmaps,
+                                                                                 sizeMultiplier, texelScale, decodeTile))
+        return true;
 
-    for (atUint32 i = 0; i < 2; i++)
+    atUint32 mipOffset = 0;
+    for (atUint32 m = 0; m < mipmaps; m++)
     {
-        m_paletteStream->seek(indices[i] * 2, Athena::SeekOrigin::Begin);
-
-        if (m_palFormat == GXPaletteFormat::IA8)
-            readPixelIA8(*m_paletteStream, out);
-        else if (m_palFormat == GXPaletteFormat::RGB565)
-            readPixelRGB565(*m_paletteStream, out);
-        else if (m_palFormat == GXPaletteFormat::RGB5A3)
-            readPixelRGB5A3(*m_paletteStream, out);
+        if (!decodeGXTiles<BlockWidth, BlockHeight, BitsPerTexel>(src, srcEnd, out, mipOffset, width, height, decodeTile))
+            return false;
+
+        mipOffset += (atUint32)(width * height * sizeMultiplier) * texelScale;
+        width /= 2;
+        height /= 2;
+        if (width < BlockWidth)
+            width = BlockWidth;
+        if (height < BlockHeight)
+            height = BlockHeight;
     }
-}
 
-void TextureReader::readPixelC8(Athena::io::MemoryReader& in, Athena::io::MemoryWriter& out)
-{
-    atUint8 index = in.readByte();
-    m_paletteStream->seek(index * 2, Athena::SeekOrigin::Begin);
-
-    if (m_palFormat == GXPaletteFormat::IA8)
-        readPixelIA8(*m_paletteStream, out);
-    else if (m_palFormat == GXPaletteFormat::RGB565)
-        readPixelRGB565(*m_paletteStream, out);
-    else if (m_palFormat == GXPaletteFormat::RGB5A3)
-        readPixelRGB5A3(*m_paletteStream, out);
-}
-
-void TextureReader::readPixelRGB565(Athena::io::MemoryReader& in, Athena::io::MemoryWriter& out)
-{
-    out.writeUint16(in.readUint16());
+    return true;
 }
 
-void TextureReader::readPixelRGB5A3(Athena::io::MemoryReader& in, Athena::io::MemoryWriter& out)
+// Runs one of the GXTexelKernels over every tile
+template <atUint32 BlockWidth>
+struct SKernelTile
 {
-    atUint16 px = in.readUint16();
-    atUint8 r, g, b, a;
-    atUint32 rgba;
-    if (px & 0x8000) // RGB5
-    {
-        b = extend5To8(px >> 10);
-        g = extend5To8(px >>  5);
-        r = extend5To8(px >>  0);
-        a = 0xFF;
-    }
-    else // RGB4A3
-    {
-        a = extend3To8(px >> 12);
-        b = extend4To8(px >>  8);
-        g = extend4To8(px >>  4);
-        r = extend4To8(px >>  0);
-    }
+    GXTileKernel kernel;
+    atUint32     stride;
 
-    rgba = (atUint32)((a << 24) | (r << 16) | (g << 8) | b);
-    out.writeUint32(rgba);
-}
+    atUint32 rowExtent() const { return BlockWidth * stride; }
+    void operator()(const atUint8* tile, atUint8* dst, atUint32 pitch) const { kernel(tile, dst, pitch); }
+};
 
-void TextureReader::readPixelRGBA8(Athena::io::MemoryReader& in, Athena::io::MemoryWriter& out)
+template <atUint32 BlockWidth>
+struct SPaletteKernelTile
 {
-    atUint16 ar = in.readUint16();
-    in.seek(0x1E);
-    atUint16 gb = in.readUint16();
-    in.seek(-0x20);
+    GXPaletteTileKernel kernel;
+    const atUint8*      lut;
+    atUint32            stride;
 
-    atUint32 px = (ar << 16) | gb;
-    out.writeUint32(px);
-}
+    atUint32 rowExtent() const { return BlockWidth * stride; }
+    void operator()(const atUint8* tile, atUint8* dst, atUint32 pitch) const { kernel(tile, lut, dst, pitch); }
+};
 
-void TextureReader::readCMPRSubBlock(Athena::io::MemoryReader& in, Athena::io::MemoryWriter& out)
+template <atUint32 BlockWidth, atUint32 BlockHeight, atUint32 BitsPerTexel, class Expander>
+static SGXExpandTile<BlockWidth, BlockHeight, BitsPerTexel, Expander> expandTile(const Expander& expand, atUint32 stride)
 {
-    out.writeUint16(in.readUint16());
-    out.writeUint16(in.readUint16());
-
-    atUint32 b = in.readUint32();
-    Athena::utility::BigUint32(b);
-    b = ((b & 0x03)       << 6) | ((b & 0x0C)       << 2) | ((b & 0x30)       >> 2) | ((b & 0xC0)       >> 6) |
-            ((b & 0x0300)     << 6) | ((b & 0x0C00)     << 2) | ((b & 0x3000)     >> 2) | ((b & 0xC000)     >> 6) |
-            ((b & 0x030000)   << 6) | ((b & 0x0C0000)   << 2) | ((b & 0x300000)   >> 2) | ((b & 0xC00000)   >> 6) |
-            ((b & 0x03000000) << 6) | ((b & 0x0C000000) << 2) | ((b & 0x30000000) >> 2) | ((b & 0xC0000000) >> 6);
-    out.writeUint32(b);
+    return SGXExpandTile<BlockWidth, BlockHeight, BitsPerTexel, Expander>{expand, stride};
 }
 
-atUint8 TextureReader::extend3To8(atUint8 in)
+void TextureReader::decode(SGXOutput& out)
 {
-    in &= 0x7;
-    return (in << 5) | (in << 2) | (in >> 1);
-}
+    const atUint8* src    = base::m_data + base::position();
+    const atUint8* srcEnd = base::m_data + base::length();
+    atUint32 width  = m_width;
+    atUint32 height = m_height;
+    atUint32 stride = pixelStrideLut[(atUint32)m_format];
+    float sizeMultiplier = sizeOutputMultiplierLut[(atUint32)m_format];
+    if (m_hasPalette && (m_palFormat == GXPaletteFormat::RGB5A3))
+        stride = 4;
 
-atUint8 TextureReader::extend4To8(atUint8 in)
-{
-    in &= 0xF;
-    return (in << 4) | in;
-}
+    // Every format gets its own instance of the tile loop, the switch only runs once per texture
+    const SGXTileKernels& kernels = gxTileKernels();
+    const atUint8* lut = m_paletteLUT.get();
+    bool ok = false;
+    switch(m_format)
+    {
+        case GXTextureFormat::I4:
+            ok = decodeMipChain<8, 8, 4>(src, srcEnd, out, width, height, m_mipmaps, sizeMultiplier, 1,
+                                         SKernelTile<8>{kernels.i4, stride}, m_parallelDecode);
+            break;
+        case GXTextureFormat::I8:
+            ok = decodeMipChain<8, 4, 8>(src, srcEnd, out, width, height, m_mipmaps, sizeMultiplier, 1,
+                                         SKernelTile<8>{kernels.i8, stride}, m_parallelDecode);
+            break;
+        case GXTextureFormat::IA4:
+            ok = decodeMipChain<8, 4, 8>(src, srcEnd, out, width, height, m_mipmaps, sizeMultiplier, 1,
+                                         SKernelTile<8>{kernels.ia4, stride}, m_parallelDecode);
+            break;
+        case GXTextureFormat::IA8:
+            ok = decodeMipChain<4, 4, 16>(src, srcEnd, out, width, height, m_mipmaps, sizeMultiplier, 1,
+                                          SKernelTile<4>{kernels.ia8, stride}, m_parallelDecode);
+            break;
+        case GXTextureFormat::C4:
+            // IA8 palettes expand to 4 bytes but only get 2 per texel, every texel overwrites half of the
+            // one before it. Only the lookups one texel at a time keep that the way it always was
+            if (m_palFormat == GXPaletteFormat::IA8)
+                ok = decodeMipChain<8, 8, 4>(src, srcEnd, out, width, height, m_mipmaps, sizeMultiplier, 1,
+                                             expandTile<8, 8, 4>(SGXLookupC4<4>{lut}, stride), m_parallelDecode);
+            else if (m_palFormat == GXPaletteFormat::RGB565)
+                ok = decodeMipChain<8, 8, 4>(src, srcEnd, out, width, height, m_mipmaps, sizeMultiplier, 1,
+                                             SPaletteKernelTile<8>{kernels.c4RGB565, lut, stride}, m_parallelDecode);
+            else if (m_palFormat == GXPaletteFormat::RGB5A3)
+                ok = decodeMipChain<8, 8, 4>(src, srcEnd, out, width, height, m_mipmaps, sizeMultiplier, 1,
+                                             SPaletteKernelTile<8>{kernels.c4RGBA8, lut, stride}, m_parallelDecode);
+            else
+                THROW_INVALID_DATA_EXCEPTION("Unknown palette format %i", (atUint32)m_palFormat);
+            break;
+        case GXTextureFormat::C8:
+            if (m_palFormat == GXPaletteFormat::IA8)
+                ok = decodeMipChain<8, 4, 8>(src, srcEnd, out, width, height, m_mipmaps, sizeMultiplier, 1,
+                                             expandTile<8, 4, 8>(SGXLookupC8<4>{lut}, stride), m_parallelDecode);
+            else if (m_palFormat == GXPaletteFormat::RGB565)
+                ok = decodeMipChain<8, 4, 8>(src, srcEnd, out, width, height, m_mipmaps, sizeMultiplier, 1,
+                                             SPaletteKernelTile<8>{kernels.c8RGB565, lut, stride}, m_parallelDecode);
+            else if (m_palFormat == GXPaletteFormat::RGB5A3)
+                ok = decodeMipChain<8, 4, 8>(src, srcEnd, out, width, height, m_mipmaps, sizeMultiplier, 1,
+                                             SPaletteKernelTile<8>{kernels.c8RGBA8, lut, stride}, m_parallelDecode);
+            else
+                THROW_INVALID_DATA_EXCEPTION("Unknown palette format %i", (atUint32)m_palFormat);
+            break;
+        case GXTextureFormat::RGB565:
+            ok = decodeMipChain<4, 4, 16>(src, srcEnd, out, width, height, m_mipmaps, sizeMultiplier, 1,
+                                          SKernelTile<4>{kernels.rgb565, stride}, m_parallelDecode);
+            break;
+        case GXTextureFormat::RGB5A3:
+            ok = decodeMipChain<4, 4, 16>(src, srcEnd, out, width, height, m_mipmaps, sizeMultiplier, 1,
+                                          SKernelTile<4>{kernels.rgb5a3, stride}, m_parallelDecode);
+            break;
+        case GXTextureFormat::RGBA8:
+            ok = decodeMipChain<4, 4, 32>(src, srcEnd, out, width, height, m_mipmaps, sizeMultiplier, 1,
+                                          SKernelTile<4>{kernels.rgba8, stride}, m_parallelDecode);
+            break;
+        case GXTextureFormat::CMPR:
+            // I stole this little trick from Parax, so I'll let him explain what's going on here:
+            // With CMPR, we're using a little trick.
+            // CMPR stores pixels in 8x8 blocks, with four 4x4 subblocks.
+            // An easy way to convert it is to pretend each block is 2x2 and each subblock is one pixel.
+            // So to do that we need to calculate the "new" dimensions of the image, 1/4 the size of the original.
+            // Each of those pixels is 16 real ones
+            ok = decodeMipChain<2, 2, 64>(src, srcEnd, out, width / 4, height / 4, m_mipmaps, sizeMultiplier, 16,
+                                          SKernelTile<2>{kernels.cmpr, stride}, m_parallelDecode);
+            break;
+        default:
+            THROW_INVALID_DATA_EXCEPTION("Unsupported texture format %i", (atUint32)m_format);
+    }
 
-atUint8 TextureReader::extend5To8(atUint8 in)
-{
-    in &= 0x1F;
-    return (in << 3) | (in >> 2);
-}
+    if (!ok)
+        THROW_INVALID_DATA_EXCEPTION("Texture data ends mid tile");
 
-atUint8 TextureReader::extend6To8(atUint8 in)
-{
-    in &= 0x3F;
-    return (in << 2) | (in >> 4);
+    base::seek(src - base::m_data, Athena::SeekOrigin::Begin);
 }
-
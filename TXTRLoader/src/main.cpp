@@ -1,5 +1,20 @@
 #include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
 #include <TextureReader.hpp>
+#include <CPakFile.hpp>
+#include <CPakFileReader.hpp>
+#include <CWorkerPool.hpp>
+#include <Athena/Utility.hpp>
+#include <Athena/InvalidDataException.hpp>
+#include <memory.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
 
 inline uint16_t RGB565(uint8_t r, uint8_t g, uint8_t b)
 {
@@ -49,43 +64,499 @@ inline uint16_t RGBAToRGB5A3(uint16_t rgba)
     return newPixel;
 }
 
+namespace
+{
+// How much stored texture data a pak hands to the workers at a time
+const atUint64 BatchSize = 32 * 1024 * 1024;
+
+enum class EOutputFormat
+{
+    DDS,
+    PNG
+};
+
+struct SBatchOptions
+{
+    std::string   outDirectory;
+    EOutputFormat format;
+    bool          force;
+};
+
+struct SBatchStats
+{
+    std::atomic<atUint32> converted;
+    std::atomic<atUint32> skipped;
+    std::atomic<atUint32> failed;
+    std::atomic<atUint64> bytesIn;
+    std::atomic<atUint64> bytesOut;
+    std::mutex            logMutex;
+};
+
+// A texture outside any pak, relativeDirectory is where it was below the directory it was found in
+struct SLooseTexture
+{
+    std::string path;
+    std::string relativeDirectory;
+};
+}
+
+static const char* extension(EOutputFormat format)
+{
+    return format == EOutputFormat::PNG ? ".png" : ".dds";
+}
+
+static std::string lowerExtension(const std::string& path)
+{
+    std::string::size_type dot = path.rfind('.');
+    if (dot == std::string::npos || path.find_first_of("/\\", dot) != std::string::npos)
+        return std::string();
+
+    std::string ext = path.substr(dot + 1);
+    Athena::utility::tolower(ext);
+    return ext;
+}
+
+static std::string baseName(const std::string& path)
+{
+    std::string name = path.substr(path.find_last_of("/\\") + 1);
+    return name.substr(0, name.rfind('.'));
+}
+
+// Modification time of path, -1 if it doesn't exist
+static atInt64 modifiedTime(const std::string& path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return -1;
+    return st.st_mtime;
+}
+
+// An output counts as up to date once it's at least as new as what it was converted from
+static bool isUpToDate(const std::string& outPath, atInt64 sourceTime)
+{
+    atInt64 outTime = modifiedTime(outPath);
+    return outTime >= 0 && outTime >= sourceTime;
+}
+
+static bool isDirectory(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static bool makeDirectory(const std::string& path)
+{
+    if (isDirectory(path))
+        return true;
+#ifdef _WIN32
+    return mkdir(path.c_str()) == 0;
+#else
+    return mkdir(path.c_str(), 0755) == 0;
+#endif
+}
+
+// relativeDirectory and every directory leading up to it below base
+static bool makeDirectories(const std::string& base, const std::string& relativeDirectory)
+{
+    std::string::size_type end = 0;
+    while (end != std::string::npos)
+    {
+        end = relativeDirectory.find('/', end + 1);
+        if (!makeDirectory(base + "/" + relativeDirectory.substr(0, end)))
+            return false;
+    }
+
+    return true;
+}
+
+// Every .txtr below path, and every .pak when paks isn't null. relative is where path is below the search root
+static void findTextures(const std::string& path, const std::string& relative, std::vector<SLooseTexture>& textures,
+                         std::vector<std::string>* paks)
+{
+    DIR* dir = opendir(path.c_str());
+    if (!dir)
+        return;
+
+    struct dirent* dp;
+    while ((dp = readdir(dir)) != NULL)
+    {
+        std::string name = dp->d_name;
+        if (name == "." || name == "..")
+            continue;
+
+        std::string filepath = path + "/" + name;
+        struct stat st;
+        if (stat(filepath.c_str(), &st) != 0)
+            continue;
+
+        if (S_ISDIR(st.st_mode))
+            findTextures(filepath, relative.empty() ? name : relative + "/" + name, textures, paks);
+        else if (S_ISREG(st.st_mode))
+        {
+            std::string ext = lowerExtension(name);
+            if (ext == "txtr")
+                textures.push_back(SLooseTexture{filepath, relative});
+            else if (ext == "pak" && paks)
+                paks->push_back(filepath);
+        }
+    }
+    closedir(dir);
+}
+
+static void exportTexture(Texture* tex, const std::string& path, EOutputFormat format)
+{
+    if (format == EOutputFormat::PNG)
+        tex->exportPNG(path);
+    else
+        tex->exportDDS(path);
+}
+
+// Decodes and writes one texture, reader is either over the file or owns a copy of the pak's data
+static void convertTexture(TextureReader& reader, const std::string& name, atUint64 storedSize,
+                           const std::string& outPath, EOutputFormat format, SBatchStats& stats)
+{
+    Texture* tex = nullptr;
+    try
+    {
+        tex = reader.read();
+        exportTexture(tex, outPath, format);
+        stats.converted++;
+        stats.bytesIn  += storedSize;
+        stats.bytesOut += tex->dataSize();
+    }
+    catch(const Athena::error::Exception& e)
+    {
+        std::lock_guard<std::mutex> lock(stats.logMutex);
+        std::cout << "failed to decode " << name << ": " << e.message() << std::endl;
+        stats.failed++;
+    }
+    catch(const std::exception& e)
+    {
+        std::lock_guard<std::mutex> lock(stats.logMutex);
+        std::cout << "failed to export " << name << ": " << e.what() << std::endl;
+        stats.failed++;
+    }
+
+    delete tex;
+}
+
+static void convertFiles(const std::vector<SLooseTexture>& textures, const SBatchOptions& options, SBatchStats& stats)
+{
+    // Textures keep their directory below the output one. Dumps of different paks share IDs, so two
+    // textures could still end up at the same path, and written at once they'd garble each other
+    std::vector<std::string> files;
+    std::vector<std::string> outPaths;
+    std::set<std::string> taken;
+    std::string lastDirectory;
+    for (const SLooseTexture& texture : textures)
+    {
+        std::string outDirectory = options.outDirectory;
+        if (!texture.relativeDirectory.empty())
+            outDirectory += "/" + texture.relativeDirectory;
+
+        if (outDirectory != lastDirectory && !makeDirectories(options.outDirectory, texture.relativeDirectory))
+        {
+            std::cout << "Unable to create " << outDirectory << std::endl;
+            stats.failed++;
+            continue;
+        }
+        lastDirectory = outDirectory;
+
+        std::string outPath = outDirectory + "/" + baseName(texture.path) + extension(options.format);
+        if (!taken.insert(outPath).second)
+        {
+            std::cout << "not converting " << texture.path << ", another texture already goes to " << outPath << std::endl;
+            stats.failed++;
+            continue;
+        }
+
+        files.push_back(texture.path);
+        outPaths.push_back(outPath);
+    }
+
+    // Each job decodes a whole texture, splitting them up as well wouldn't gain anything
+    CWorkerPool::instance().parallelFor(files.size(), [&](atUint32 i)
+    {
+        const std::string& file = files[i];
+        const std::string& outPath = outPaths[i];
+        if (!options.force && isUpToDate(outPath, modifiedTime(file)))
+        {
+            stats.skipped++;
+            return;
+        }
+
+        try
+        {
+            TextureReader reader(file);
+            convertTexture(reader, file, reader.length(), outPath, options.format, stats);
+        }
+        catch(const Athena::error::Exception& e)
+        {
+            std::lock_guard<std::mutex> lock(stats.logMutex);
+            std::cout << "failed to open " << file << ": " << e.message() << std::endl;
+            stats.failed++;
+        }
+    });
+}
+
+static void convertPak(const std::string& pakPath, const SBatchOptions& options, SBatchStats& stats)
+{
+    std::string outDirectory = options.outDirectory + "/" + baseName(pakPath);
+    if (!makeDirectory(outDirectory))
+    {
+        std::cout << "Unable to create " << outDirectory << std::endl;
+        stats.failed++;
+        return;
+    }
+
+    CPakFile* pak = nullptr;
+    try
+    {
+        pak = CPakFileReader::load(pakPath);
+        pak->map();
+        pak->removeDuplicates();
+    }
+    catch(const Athena::error::Exception& e)
+    {
+        std::cout << e.file() << ": " << e.function() << "(" << e.line() << ")" << e.message() << std::endl;
+        delete pak;
+        stats.failed++;
+        return;
+    }
+
+    // Every texture in the pak is as old as the pak itself
+    atInt64 pakTime = modifiedTime(pakPath);
+    std::vector<const SPakResource*> textures;
+    std::vector<std::string> outPaths;
+    for (const SPakResource& resource : pak->resourcesByType(CFourCC("TXTR")))
+    {
+        std::string outPath = outDirectory + "/" + resource.id.toString() + extension(options.format);
+        if (!options.force && isUpToDate(outPath, pakTime))
+        {
+            stats.skipped++;
+            continue;
+        }
+
+        textures.push_back(&resource);
+        outPaths.push_back(outPath);
+    }
+
+    std::cout << "converting " << textures.size() << " textures from " << pakPath << std::endl;
+
+    atUint32 batchStart = 0;
+    while (batchStart < textures.size())
+    {
+        atUint32 batchEnd = batchStart;
+        atUint64 batchSize = 0;
+        std::vector<CUniqueID> batch;
+        while (batchEnd < textures.size() && (batch.empty() || batchSize < BatchSize))
+        {
+            batch.push_back(textures[batchEnd]->id);
+            batchSize += textures[batchEnd]->size;
+            batchEnd++;
+        }
+
+        // Without a mapping the batch is read in one pass, with one the workers read straight out of it
+        std::vector<atUint8*> batchData;
+        if (!pak->isMapped())
+            batchData = pak->loadBatch(batch);
+        else
+            batchData.resize(batch.size(), nullptr);
+
+        CWorkerPool::instance().parallelFor(batch.size(), [&](atUint32 i)
+        {
+            const SPakResource& resource = *textures[batchStart + i];
+            std::string name = pakPath + ":" + resource.id.toString();
+
+            // The reader frees its buffer, so it gets the batch's outright or a copy of the mapping
+            atUint8* data = batchData[i];
+            batchData[i] = nullptr;
+            if (!data)
+            {
+                const atUint8* raw = pak->rawData(resource);
+                if (raw)
+                {
+                    data = new atUint8[resource.size];
+                    memcpy(data, raw, resource.size);
+                }
+            }
+
+            if (!data)
+            {
+                std::lock_guard<std::mutex> lock(stats.logMutex);
+                std::cout << "Unable to read " << name << std::endl;
+                stats.failed++;
+                return;
+            }
+
+            TextureReader reader(data, resource.size);
+            convertTexture(reader, name, resource.size, outPaths[batchStart + i], options.format, stats);
+        });
+
+        // Only what never reached a reader is left
+        for (atUint8* data : batchData)
+            delete[] data;
+
+        batchStart = batchEnd;
+    }
+
+    delete pak;
+}
+
+void usage(const std::string& progName)
+{
+    printf("Usage: %s [options] <in> [out]\n", progName.c_str());
+    printf("       %s [options] -b <pak|dir|txtr> [pak|dir|txtr...]\n", progName.c_str());
+    printf("  -f <dds|png>    output format, defaults to dds\n");
+    printf("  -b              batch mode, converts every texture in the given paks and directories\n");
+    printf("  -o <dir>        where batch mode writes to, defaults to the current directory. Every pak\n");
+    printf("                  gets its own directory in there, textures found in a directory keep the\n");
+    printf("                  directories below it and the ones given directly go straight into it\n");
+    printf("  -F              batch mode converts textures whose output is up to date too\n");
+}
+
 int main(int argc, char* argv[])
 {
     std::string progName = argv[0];
     progName = progName.substr(progName.find_last_of("/\\") + 1);
-    if (argc < 2)
+
+    std::string formatName = "dds";
+    SBatchOptions options;
+    options.outDirectory = ".";
+    options.force = false;
+    bool batch = false;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
     {
-        printf("Usage: %s <in> [out]\n", progName.c_str());
+        std::string arg = argv[i];
+        if ((arg == "-f" || arg == "-o") && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (arg == "-f")
+                formatName = value;
+            else
+                options.outDirectory = value;
+        }
+        else if (arg == "-b")
+            batch = true;
+        else if (arg == "-F")
+            options.force = true;
+        else if (arg[0] == '-')
+        {
+            usage(progName);
+            return 1;
+        }
+        else
+            files.push_back(arg);
+    }
+
+    Athena::utility::tolower(formatName);
+    if (formatName == "dds")
+        options.format = EOutputFormat::DDS;
+    else if (formatName == "png")
+        options.format = EOutputFormat::PNG;
+    else
+    {
+        usage(progName);
         return 1;
     }
 
-    std::string inName = argv[1];
-    std::string outName;
-    if (argc >= 3)
-        outName = argv[2];
+    if (files.empty() || (!batch && files.size() > 2))
+    {
+        usage(progName);
+        return 1;
+    }
 
-    if (outName == std::string())
+    if (!batch)
     {
-        outName = inName.substr(0, inName.rfind('.'));
+        std::string inName = files[0];
+        std::string outName;
+        if (files.size() >= 2)
+            outName = files[1];
+
         if (outName == std::string())
-            outName = inName;
+        {
+            outName = inName.substr(0, inName.rfind('.'));
+            if (outName == std::string())
+                outName = inName;
+        }
+
+        Texture* tex = nullptr;
+        int ret = 0;
+        try
+        {
+            TextureReader reader(inName);
+            // A single texture has the worker pool to itself
+            reader.setParallelDecode(true);
+            tex = reader.read();
+
+            std::cout << "exporting " << outName << std::endl;
+            exportTexture(tex, outName + extension(options.format), options.format);
+        }
+        catch(const Athena::error::Exception& e)
+        {
+            std::cout << "failed to decode " << inName << ": " << e.message() << std::endl;
+            ret = 1;
+        }
+        catch(const std::exception& e)
+        {
+            std::cout << "failed to export " << outName << ": " << e.what() << std::endl;
+            ret = 1;
+        }
+
+        delete tex;
+        return ret;
     }
 
-    Texture* tex = nullptr;
+    if (!makeDirectory(options.outDirectory))
+    {
+        std::cout << "Unable to create " << options.outDirectory << std::endl;
+        return 1;
+    }
 
-    tex = TextureReader::loadTexture(inName);
+    std::vector<std::string> paks;
+    std::vector<SLooseTexture> textures;
+    for (const std::string& file : files)
+    {
+        if (isDirectory(file))
+            findTextures(file, std::string(), textures, &paks);
+        else if (lowerExtension(file) == "pak")
+            paks.push_back(file);
+        else
+            textures.push_back(SLooseTexture{file, std::string()});
+    }
+
+    // readdir gives no particular order
+    std::sort(paks.begin(), paks.end());
+    std::sort(textures.begin(), textures.end(), [](const SLooseTexture& a, const SLooseTexture& b) { return a.path < b.path; });
+
+    SBatchStats stats;
+    stats.converted = 0;
+    stats.skipped   = 0;
+    stats.failed    = 0;
+    stats.bytesIn   = 0;
+    stats.bytesOut  = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string& pak : paks)
+        convertPak(pak, options, stats);
 
-    if (tex)
+    if (!textures.empty())
     {
-        std::cout << "exporting " << outName << std::endl;
-        tex->exportDDS(outName + ".dds");
-        //tex->exportPNG(outName + ".png");
+        std::cout << "converting " << textures.size() << " loose textures" << std::endl;
+        convertFiles(textures, options, stats);
     }
-    else
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double mib = 1024.0 * 1024.0;
+    std::cout << "converted " << stats.converted << " textures, " << stats.skipped << " up to date, "
+              << stats.failed << " failed in " << std::fixed << std::setprecision(2) << seconds << "s" << std::endl;
+    if (seconds > 0.0)
     {
-        std::cout << "failed to decode " << inName << std::endl;
+        std::cout << std::setprecision(1) << stats.converted / seconds << " files/s, "
+                  << (stats.bytesIn / mib) / seconds << " MiB/s read, "
+                  << (stats.bytesOut / mib) / seconds << " MiB/s decoded" << std::endl;
     }
 
-    return 0;
+    return stats.failed ? 1 : 0;
 }
-
@@ -0,0 +1,357 @@
+#include "ReferenceDecoder.hpp"
+#include <Texture.hpp>
+
+namespace
+{
+const float sizeOutputMultiplierLut[] =
+{ // number of pixels * this = number of bytes
+  4.f, 4.f, 4.f, 4.f, 4.f, 4.f, 0.f, 2.f, 4.f, 4.f, 0.5f
+};
+
+const atUint32 bppOutputMultiplierLut[] =
+{ // source BPP * this = output BPP
+  2, 1, 2, 1, 4, 2, 0, 1, 2, 1, 1
+};
+
+const atUint32 pixelStrideLut[] =
+{ // size of one pixel in output data in bytes
+  4, 4, 4, 4, 2, 2, 0, 2, 4, 4, 8
+};
+
+const atUint32 blockWidthLut[] =
+{
+    8, 8, 8, 4, 8, 8, 0, 4, 4, 4, 2
+};
+
+const atUint32 blockHeightLut[] =
+{
+    8, 4, 4, 4, 8, 4, 0, 4, 4, 4, 2
+};
+
+// Thrown by SReader when a read runs past the end
+struct SOutOfData
+{
+};
+
+struct SReader
+{
+    const atUint8* data;
+    atUint64       length;
+    atUint64       position;
+    bool           bigEndian;
+
+    void seek(atInt64 offset)
+    {
+        atInt64 target = (atInt64)position + offset;
+        if (target < 0 || (atUint64)target > length)
+            throw SOutOfData();
+        position = target;
+    }
+
+    const atUint8* take(atUint32 count)
+    {
+        if (position + count > length)
+            throw SOutOfData();
+        position += count;
+        return data + position - count;
+    }
+
+    atUint8 readByte()
+    {
+        return *take(1);
+    }
+
+    atUint16 readUint16()
+    {
+        const atUint8* b = take(2);
+        return bigEndian ? (b[0] << 8) | b[1] : (b[1] << 8) | b[0];
+    }
+
+    atUint32 readUint32()
+    {
+        const atUint8* b = take(4);
+        if (bigEndian)
+            return ((atUint32)b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+        return ((atUint32)b[3] << 24) | (b[2] << 16) | (b[1] << 8) | b[0];
+    }
+};
+
+// Little endian, like the MemoryWriter the old decoder wrote through
+struct SWriter
+{
+    SReferenceTexture& out;
+    atUint64           position;
+
+    void seek(atUint64 target)
+    {
+        if (target > out.data.size())
+            grow(target);
+        position = target;
+    }
+
+    void grow(atUint64 length)
+    {
+        // Whatever the buffer grows by is zero filled, which counts as written
+        atUint64 oldLength = out.data.size();
+        out.data.resize(length, 0);
+        out.written.resize(length, false);
+        for (atUint64 i = oldLength; i < length; i++)
+            out.written[i] = true;
+    }
+
+    void writeByte(atUint8 v)
+    {
+        if (position + 1 > out.data.size())
+            grow(position + 1);
+        out.data[position]    = v;
+        out.written[position] = true;
+        position++;
+    }
+
+    void writeUint16(atUint16 v)
+    {
+        writeByte(v);
+        writeByte(v >> 8);
+    }
+
+    void writeUint32(atUint32 v)
+    {
+        writeUint16(v);
+        writeUint16(v >> 16);
+    }
+};
+
+atUint8 extend3To8(atUint8 in)
+{
+    in &= 0x7;
+    return (in << 5) | (in << 2) | (in >> 1);
+}
+
+atUint8 extend4To8(atUint8 in)
+{
+    in &= 0xF;
+    return (in << 4) | in;
+}
+
+atUint8 extend5To8(atUint8 in)
+{
+    in &= 0x1F;
+    return (in << 3) | (in >> 2);
+}
+
+void readPixelIA8(SReader& in, SWriter& out)
+{
+    atUint8 a = in.readByte();
+    atUint8 l = in.readByte();
+    out.writeByte(l);
+    out.writeByte(l);
+    out.writeByte(l);
+    out.writeByte(a);
+}
+
+void readPixelRGB565(SReader& in, SWriter& out)
+{
+    out.writeUint16(in.readUint16());
+}
+
+void readPixelRGB5A3(SReader& in, SWriter& out)
+{
+    atUint16 px = in.readUint16();
+    atUint8 r, g, b, a;
+    if (px & 0x8000) // RGB5
+    {
+        b = extend5To8(px >> 10);
+        g = extend5To8(px >>  5);
+        r = extend5To8(px >>  0);
+        a = 0xFF;
+    }
+    else // RGB4A3
+    {
+        a = extend3To8(px >> 12);
+        b = extend4To8(px >>  8);
+        g = extend4To8(px >>  4);
+        r = extend4To8(px >>  0);
+    }
+
+    out.writeUint32((atUint32)((a << 24) | (r << 16) | (g << 8) | b));
+}
+
+void readPaletteEntry(SReader& palette, GXPaletteFormat format, atUint8 index, SWriter& out)
+{
+    palette.position = index * 2;
+    if (format == GXPaletteFormat::IA8)
+        readPixelIA8(palette, out);
+    else if (format == GXPaletteFormat::RGB565)
+        readPixelRGB565(palette, out);
+    else if (format == GXPaletteFormat::RGB5A3)
+        readPixelRGB5A3(palette, out);
+}
+
+void readPixel(GXTextureFormat format, SReader& in, SReader& palette, GXPaletteFormat palFormat, SWriter& out)
+{
+    switch(format)
+    {
+        case GXTextureFormat::I4:
+        {
+            atUint8 px = in.readByte();
+            for (atUint32 i = 0; i < 4; i++)
+                out.writeByte(extend4To8(px >> 4));
+            for (atUint32 i = 0; i < 4; i++)
+                out.writeByte(extend4To8(px));
+            break;
+        }
+        case GXTextureFormat::I8:
+        {
+            atUint8 l = in.readByte();
+            for (atUint32 i = 0; i < 4; i++)
+                out.writeByte(l);
+            break;
+        }
+        case GXTextureFormat::IA4:
+        {
+            atUint8 b = in.readByte();
+            out.writeByte(extend4To8(b));
+            out.writeByte(extend4To8(b));
+            out.writeByte(extend4To8(b));
+            out.writeByte(extend4To8(b >> 4));
+            break;
+        }
+        case GXTextureFormat::IA8:
+            readPixelIA8(in, out);
+            break;
+        case GXTextureFormat::C4:
+        {
+            atUint8 b = in.readByte();
+            readPaletteEntry(palette, palFormat, (b >> 4) & 0xF, out);
+            readPaletteEntry(palette, palFormat, b & 0xF, out);
+            break;
+        }
+        case GXTextureFormat::C8:
+            readPaletteEntry(palette, palFormat, in.readByte(), out);
+            break;
+        case GXTextureFormat::RGB565:
+            readPixelRGB565(in, out);
+            break;
+        case GXTextureFormat::RGB5A3:
+            readPixelRGB5A3(in, out);
+            break;
+        case GXTextureFormat::RGBA8:
+        {
+            atUint16 ar = in.readUint16();
+            in.seek(0x1E);
+            atUint16 gb = in.readUint16();
+            in.seek(-0x20);
+            out.writeUint32((ar << 16) | gb);
+            break;
+        }
+        case GXTextureFormat::CMPR:
+        {
+            out.writeUint16(in.readUint16());
+            out.writeUint16(in.readUint16());
+            // The 2 bit indices mirrored within each byte
+            for (atUint32 i = 0; i < 4; i++)
+            {
+                atUint8 b = in.readByte();
+                out.writeByte(((b & 0x03) << 6) | ((b & 0x0C) << 2) | ((b & 0x30) >> 2) | ((b & 0xC0) >> 6));
+            }
+            break;
+        }
+    }
+}
+}
+
+bool referenceDecode(const atUint8* file, atUint32 length, SReferenceTexture& out)
+{
+    out.data.clear();
+    out.written.clear();
+
+    try
+    {
+        SReader in{file, length, 0, true};
+        atUint32 fmt = in.readUint32();
+        if (fmt > (atUint32)GXTextureFormat::CMPR || fmt == 6)
+            return false;
+
+        GXTextureFormat format = (GXTextureFormat)fmt;
+        atUint32 width   = in.readUint16();
+        atUint32 height  = in.readUint16();
+        atUint32 mipmaps = in.readUint32();
+
+        // The palette is read through a little endian stream of its own
+        SReader palette{nullptr, 0, 0, false};
+        GXPaletteFormat palFormat = GXPaletteFormat::IA8;
+        bool hasPalette = format == GXTextureFormat::C4 || format == GXTextureFormat::C8;
+        if (hasPalette)
+        {
+            palFormat = (GXPaletteFormat)in.readUint32();
+            in.seek(4);
+
+            atUint32 entryCount = (format == GXTextureFormat::C4) ? 16 : 256;
+            palette.data   = in.take(entryCount * 2);
+            palette.length = entryCount * 2;
+        }
+
+        atUint32 dataBufferSize = (length - in.position) * bppOutputMultiplierLut[fmt];
+        if (hasPalette && palFormat == GXPaletteFormat::RGB5A3)
+            dataBufferSize *= 2;
+
+        out.data.resize(dataBufferSize, 0);
+        out.written.resize(dataBufferSize, false);
+        SWriter buf{out, 0};
+
+        atUint32 mipWidth = width, mipHeight = height;
+        if (format == GXTextureFormat::CMPR)
+        {
+            mipWidth /= 4;
+            mipHeight /= 4;
+        }
+
+        atUint32 blockWidth  = blockWidthLut[fmt];
+        atUint32 blockHeight = blockHeightLut[fmt];
+        atUint32 pxStride    = pixelStrideLut[fmt];
+        if (hasPalette && palFormat == GXPaletteFormat::RGB5A3)
+            pxStride = 4;
+
+        atUint32 mipOffset = 0;
+        for (atUint32 m = 0; m < mipmaps; m++)
+        {
+            for (atUint32 blockY = 0; blockY < mipHeight; blockY += blockHeight)
+            {
+                for (atUint32 blockX = 0; blockX < mipWidth; blockX += blockWidth)
+                {
+                    for (atUint32 imgY = blockY; imgY < blockY + blockHeight; imgY++)
+                    {
+                        for (atUint32 imgX = blockX; imgX < blockX + blockWidth; imgX++)
+                        {
+                            buf.seek(mipOffset + ((imgY * mipWidth) + imgX) * pxStride);
+                            readPixel(format, in, palette, palFormat, buf);
+
+                            if (format == GXTextureFormat::I4 || format == GXTextureFormat::C4)
+                                imgX++;
+                        }
+                    }
+                    if (format == GXTextureFormat::RGBA8)
+                        in.seek(0x20);
+                }
+            }
+
+            atUint32 mipSize = mipWidth * mipHeight * sizeOutputMultiplierLut[fmt];
+            if (format == GXTextureFormat::CMPR)
+                mipSize *= 16;
+
+            mipOffset += mipSize;
+            mipWidth /= 2;
+            mipHeight /= 2;
+            if (mipWidth < blockWidth)
+                mipWidth = blockWidth;
+            if (mipHeight < blockHeight)
+                mipHeight = blockHeight;
+        }
+    }
+    catch(const SOutOfData&)
+    {
+        return false;
+    }
+
+    return true;
+}
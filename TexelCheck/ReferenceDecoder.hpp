@@ -0,0 +1,21 @@
+#ifndef REFERENCEDECODER_HPP
+#define REFERENCEDECODER_HPP
+
+#include <Athena/Types.hpp>
+#include <vector>
+
+// The texel at a time decoder TextureReader had before it went a tile at a time, kept as the
+// reference the tile decoders have to match byte for byte. It runs on streams that behave the
+// way the Athena ones it was written against did: reads past the end fail, the output grows
+// (zero filled) on seeks and writes past its end and the palette is read little endian.
+
+struct SReferenceTexture
+{
+    std::vector<atUint8> data;    // as long as Texture::dataSize
+    std::vector<bool>    written; // bytes the decoder wrote, the rest were never initialized
+};
+
+// Decodes an uncompressed TXTR, false wherever TextureReader::read throws
+bool referenceDecode(const atUint8* file, atUint32 length, SReferenceTexture& out);
+
+#endif // REFERENCEDECODER_HPP
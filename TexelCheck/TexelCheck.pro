@@ -0,0 +1,19 @@
+TEMPLATE = app
+TARGET = texelcheck
+CONFIG += console std=c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+
+include(../Athena/AthenaCore.pri)
+include(../RetroCommon/RetroCommon.pri)
+include(../TXTRLoader/TXTRLoader.pri)
+
+# Texture.cpp decodes CMPR through squish
+win32:INCLUDEPATH += $$PWD/../TXTRLoader/Externals/squish/include
+win32:LIBS += -L$$PWD/../TXTRLoader/Externals/squish/lib
+LIBS += -lsquish
+
+HEADERS += ReferenceDecoder.hpp
+
+SOURCES += main.cpp \
+    ReferenceDecoder.cpp
@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+#include <TextureReader.hpp>
+#include <GXTexelKernels.hpp>
+#include <Athena/InvalidDataException.hpp>
+#include <memory.h>
+
+#include "ReferenceDecoder.hpp"
+
+namespace
+{
+const GXTextureFormat allFormats[] =
+{
+    GXTextureFormat::I4, GXTextureFormat::I8, GXTextureFormat::IA4, GXTextureFormat::IA8,
+    GXTextureFormat::C4, GXTextureFormat::C8, GXTextureFormat::RGB565, GXTextureFormat::RGB5A3,
+    GXTextureFormat::RGBA8, GXTextureFormat::CMPR
+};
+
+const atUint32 blockWidthLut[]  = {8, 8, 8, 4, 8, 8, 0, 4, 4, 4, 2};
+const atUint32 blockHeightLut[] = {8, 4, 4, 4, 8, 4, 0, 4, 4, 4, 2};
+const atUint32 bitsPerTexelLut[] = {4, 8, 8, 16, 4, 8, 0, 16, 16, 32, 64};
+
+// Multiples of 4 so CMPR gets whole sub blocks, the rest also covers partial tiles
+const atUint32 dimensions[] = {4, 8, 12, 16, 20, 24, 32, 40, 64, 128};
+
+const char* formatName(GXTextureFormat format)
+{
+    switch(format)
+    {
+        case GXTextureFormat::I4:     return "I4";
+        case GXTextureFormat::I8:     return "I8";
+        case GXTextureFormat::IA4:    return "IA4";
+        case GXTextureFormat::IA8:    return "IA8";
+        case GXTextureFormat::C4:     return "C4";
+        case GXTextureFormat::C8:     return "C8";
+        case GXTextureFormat::RGB565: return "RGB565";
+        case GXTextureFormat::RGB5A3: return "RGB5A3";
+        case GXTextureFormat::RGBA8:  return "RGBA8";
+        case GXTextureFormat::CMPR:   return "CMPR";
+    }
+
+    return "";
+}
+
+class CRandom
+{
+public:
+    explicit CRandom(atUint32 seed) : m_state(seed) {}
+    atUint32 next()
+    {
+        m_state = m_state * 1103515245 + 12345;
+        return m_state >> 8;
+    }
+private:
+    atUint32 m_state;
+};
+
+void writeBig32(std::vector<atUint8>& out, atUint32 v)
+{
+    for (int i = 3; i >= 0; i--)
+        out.push_back(v >> (i * 8));
+}
+
+struct STileKernelInfo
+{
+    const char*                 name;
+    GXTileKernel SGXTileKernels::*kernel;
+    atUint32                    tileSize;
+    atUint32                    rows;
+    atUint32                    rowSize;
+};
+
+const STileKernelInfo tileKernels[] =
+{
+    {"i4",     &SGXTileKernels::i4,     32, 8, 32},
+    {"i8",     &SGXTileKernels::i8,     32, 4, 32},
+    {"ia4",    &SGXTileKernels::ia4,    32, 4, 32},
+    {"ia8",    &SGXTileKernels::ia8,    32, 4, 16},
+    {"rgb565", &SGXTileKernels::rgb565, 32, 4,  8},
+    {"rgb5a3", &SGXTileKernels::rgb5a3, 32, 4, 16},
+    {"rgba8",  &SGXTileKernels::rgba8,  64, 4, 16},
+    {"cmpr",   &SGXTileKernels::cmpr,   32, 2, 16}
+};
+
+struct SPaletteKernelInfo
+{
+    const char*                        name;
+    GXPaletteTileKernel SGXTileKernels::*kernel;
+    atUint32                           entryCount;
+    atUint32                           rows;
+    atUint32                           rowSize;
+};
+
+const SPaletteKernelInfo paletteKernels[] =
+{
+    {"c4RGBA8",  &SGXTileKernels::c4RGBA8,   16, 8, 32},
+    {"c8RGBA8",  &SGXTileKernels::c8RGBA8,  256, 4, 32},
+    {"c4RGB565", &SGXTileKernels::c4RGB565,  16, 8, 16},
+    {"c8RGB565", &SGXTileKernels::c8RGB565, 256, 4, 16}
+};
+
+// Narrow pitches overlap the rows, the way texels past the right edge of a small mip do
+atUint32 randomPitch(atUint32 rowSize, CRandom& random)
+{
+    if (random.next() % 3 == 0)
+        return rowSize / 2 + (random.next() % 4) * 4;
+    return rowSize * (1 + random.next() % 3);
+}
+
+// Runs both kernels over the same random tiles, the number of tiles they decoded differently
+template <typename RunKernel>
+atUint32 compareKernels(atUint32 tileCount, atUint32 tileSize, atUint32 rowSize, CRandom& random, RunKernel run)
+{
+    atUint32 mismatches = 0;
+    for (atUint32 i = 0; i < tileCount; i++)
+    {
+        atUint8 tile[64];
+        for (atUint32 j = 0; j < tileSize; j++)
+            tile[j] = random.next();
+
+        atUint8 expected[2048];
+        atUint8 actual[2048];
+        memset(expected, 0xCD, sizeof(expected));
+        memset(actual, 0xCD, sizeof(actual));
+        run(tile, randomPitch(rowSize, random), expected, actual);
+        if (memcmp(expected, actual, sizeof(expected)))
+            mismatches++;
+    }
+
+    return mismatches;
+}
+
+// Checks every kernel of set against the scalar one, true if they all agree
+bool checkKernelSet(const SGXTileKernels& set, atUint32 tileCount, atUint32 seed)
+{
+    const SGXTileKernels& scalar = *gxTileKernelSets()[0];
+    bool ret = true;
+    for (const STileKernelInfo& info : tileKernels)
+    {
+        CRandom random(seed);
+        atUint32 mismatches = compareKernels(tileCount, info.tileSize, info.rowSize, random,
+            [&](const atUint8* tile, atUint32 pitch, atUint8* expected, atUint8* actual)
+        {
+            (scalar.*info.kernel)(tile, expected, pitch);
+            (set.*info.kernel)(tile, actual, pitch);
+        });
+
+        printf("%-8s %-10s %10u %10u", set.name, info.name, tileCount, mismatches);
+        if (mismatches)
+        {
+            printf("  MISMATCHED");
+            ret = false;
+        }
+        printf("\n");
+    }
+
+    for (const SPaletteKernelInfo& info : paletteKernels)
+    {
+        CRandom random(seed);
+        // Wide enough for either entry size, plus the padding the 2 byte lookups read
+        std::vector<atUint8> lut(info.entryCount * 4 + 2);
+        for (atUint8& b : lut)
+            b = random.next();
+
+        atUint32 mismatches = compareKernels(tileCount, 32, info.rowSize, random,
+            [&](const atUint8* tile, atUint32 pitch, atUint8* expected, atUint8* actual)
+        {
+            (scalar.*info.kernel)(tile, lut.data(), expected, pitch);
+            (set.*info.kernel)(tile, lut.data(), actual, pitch);
+        });
+
+        printf("%-8s %-10s %10u %10u", set.name, info.name, tileCount, mismatches);
+        if (mismatches)
+        {
+            printf("  MISMATCHED");
+            ret = false;
+        }
+        printf("\n");
+    }
+
+    return ret;
+}
+
+// A TXTR with random texels, some cut short and some with data trailing the last mip level
+std::vector<atUint8> makeTexture(GXTextureFormat format, CRandom& random)
+{
+    atUint32 fmt = (atUint32)format;
+    atUint32 width   = dimensions[random.next() % (sizeof(dimensions) / sizeof(*dimensions))];
+    atUint32 height  = dimensions[random.next() % (sizeof(dimensions) / sizeof(*dimensions))];
+    atUint32 mipmaps = 1 + random.next() % 5;
+
+    atUint32 mipWidth  = format == GXTextureFormat::CMPR ? width / 4 : width;
+    atUint32 mipHeight = format == GXTextureFormat::CMPR ? height / 4 : height;
+    atUint32 imageSize = 0;
+    for (atUint32 m = 0; m < mipmaps; m++)
+    {
+        atUint32 tilesX = (mipWidth + blockWidthLut[fmt] - 1) / blockWidthLut[fmt];
+        atUint32 tilesY = (mipHeight + blockHeightLut[fmt] - 1) / blockHeightLut[fmt];
+        imageSize += tilesX * tilesY * blockWidthLut[fmt] * blockHeightLut[fmt] * bitsPerTexelLut[fmt] / 8;
+        mipWidth  = std::max(mipWidth / 2, blockWidthLut[fmt]);
+        mipHeight = std::max(mipHeight / 2, blockHeightLut[fmt]);
+    }
+
+    atUint32 mode = random.next() % 10;
+    if (mode == 0 && imageSize > 0)
+        imageSize -= 1 + random.next() % imageSize;
+    else if (mode == 1)
+        imageSize += random.next() % 64;
+
+    std::vector<atUint8> file;
+    writeBig32(file, fmt);
+    file.push_back(width >> 8);
+    file.push_back(width);
+    file.push_back(height >> 8);
+    file.push_back(height);
+    writeBig32(file, mipmaps);
+    if (format == GXTextureFormat::C4 || format == GXTextureFormat::C8)
+    {
+        writeBig32(file, random.next() % 3);
+        writeBig32(file, 0);
+        for (atUint32 i = 0; i < (format == GXTextureFormat::C4 ? 32u : 512u); i++)
+            file.push_back(random.next());
+    }
+
+    for (atUint32 i = 0; i < imageSize; i++)
+        file.push_back(random.next());
+
+    return file;
+}
+
+// Whether TextureReader gives what the reference decoder gives, bytes the reference never wrote aside
+bool matchesReference(const std::vector<atUint8>& file)
+{
+    SReferenceTexture expected;
+    bool expectedValid = referenceDecode(file.data(), file.size(), expected);
+
+    // The reader takes the buffer over
+    atUint8* data = new atUint8[file.size()];
+    memcpy(data, file.data(), file.size());
+    TextureReader reader(data, file.size());
+
+    std::unique_ptr<Texture> texture;
+    try
+    {
+        texture.reset(reader.read());
+    }
+    catch(const Athena::error::Exception&)
+    {
+        return !expectedValid;
+    }
+
+    if (!expectedValid || texture->dataSize() != expected.data.size())
+        return false;
+
+    for (atUint32 i = 0; i < expected.data.size(); i++)
+    {
+        if (expected.written[i] && texture->bits()[i] != expected.data[i])
+            return false;
+    }
+
+    return true;
+}
+}
+
+void usage(const std::string& progName)
+{
+    printf("Usage: %s [options]\n", progName.c_str());
+    printf("  -c <count>      textures per format and set, 64 times as many tiles per kernel, defaults to 600\n");
+    printf("  -s <seed>       seed for the generated textures, defaults to 1\n");
+}
+
+int main(int argc, char* argv[])
+{
+    std::string progName = argv[0];
+    progName = progName.substr(progName.find_last_of("/\\") + 1);
+
+    atUint32 count = 600;
+    atUint32 seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if ((arg == "-c" || arg == "-s") && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (arg == "-c")
+                count = std::max(1, atoi(value.c_str()));
+            else
+                seed = strtoul(value.c_str(), nullptr, 0);
+        }
+        else
+        {
+            usage(progName);
+            return 1;
+        }
+    }
+
+    int ret = 0;
+    const std::vector<const SGXTileKernels*>& sets = gxTileKernelSets();
+
+    // Every set against the scalar kernels, tile by tile
+    printf("%-8s %-10s %10s %10s\n", "set", "kernel", "tiles", "mismatched");
+    for (atUint32 i = 1; i < sets.size(); i++)
+    {
+        if (!checkKernelSet(*sets[i], count * 64, seed))
+            ret = 1;
+    }
+
+    // And whole textures through every set against the old decoder
+    printf("\n%-8s %-10s %10s %10s\n", "set", "format", "textures", "mismatched");
+    for (const SGXTileKernels* set : sets)
+    {
+        selectGXTileKernels(set->name);
+        for (GXTextureFormat format : allFormats)
+        {
+            // Every set gets the same textures
+            CRandom random(seed + (atUint32)format);
+            atUint32 mismatches = 0;
+            for (atUint32 i = 0; i < count; i++)
+            {
+                if (!matchesReference(makeTexture(format, random)))
+                    mismatches++;
+            }
+
+            printf("%-8s %-10s %10u %10u", set->name, formatName(format), count, mismatches);
+            if (mismatches)
+            {
+                printf("  MISMATCHED");
+                ret = 1;
+            }
+            printf("\n");
+        }
+    }
+
+    return ret;
+}